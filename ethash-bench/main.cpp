@@ -0,0 +1,217 @@
+/// Microbenchmarks of the ethash primitives, guarded by fixed test vectors.
+///
+/// @file
+/// @copyright GNU General Public License
+
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <libdevcore/CommonData.h>
+#include <libdevcore/SHA3.h>
+#include <libethcore/EthashAux.h>
+#include <libethash/internal.h>
+#include <libethash/sha3.h>
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+namespace
+{
+
+/// Small parameters for the test vectors: a 1 KiB cache from the epoch 0 seed and a 32 KiB data set.
+uint64_t const c_testCacheSize = 1024;
+uint64_t const c_testFullSize = 32 * 1024;
+uint64_t const c_testNonce = 0x7c7c597c;
+
+/// Keeps results alive so the compiler can not drop the benchmarked calls.
+volatile uint8_t g_sink;
+
+void sink(void const* _p, size_t _n)
+{
+	for (size_t i = 0; i < _n; ++i)
+		g_sink ^= ((uint8_t const*)_p)[i];
+}
+
+ethash_h256_t testHeader()
+{
+	ethash_h256_t ret;
+	for (unsigned i = 0; i < 32; ++i)
+		ret.b[i] = (uint8_t)i;
+	return ret;
+}
+
+struct LightDeleter
+{
+	void operator()(ethash_light* _l) const { ethash_light_delete(_l); }
+};
+using LightPtr = std::unique_ptr<ethash_light, LightDeleter>;
+
+/// Builds the full data set of @a _fullSize bytes from @a _light.
+vector<node> fullDataSet(ethash_light_t _light, uint64_t _fullSize)
+{
+	vector<node> ret(_fullSize / sizeof(node));
+	for (uint32_t i = 0; i < ret.size(); ++i)
+		ethash_calculate_dag_item(&ret[i], i, _light);
+	return ret;
+}
+
+bool expect(string const& _what, string const& _got, string const& _expected)
+{
+	if (_got == _expected)
+		return true;
+	cerr << "FAILED " << _what << ": got " << _got << ", expected " << _expected << endl;
+	return false;
+}
+
+/// Checks the primitives against known answers. The ethash vectors were computed with an independent
+/// implementation of the specification.
+bool checkVectors()
+{
+	bool ok = true;
+
+	uint8_t out[64];
+	sha3_256(out, 32, nullptr, 0);
+	ok &= expect("keccak256(\"\")", toHex(bytesConstRef(out, 32)), "c5d2460186f7233c927e7db2dcc703c0e500b653ca82273b7bfad8045d85a470");
+	sha3_512(out, 64, nullptr, 0);
+	ok &= expect("keccak512(\"\")", toHex(bytesConstRef(out, 64)), "0eab42de4c3ceb9235fc91acffe746b29c29a8c366b7c60e4e67c466f36a4304c00fa9caf9d87976ba469bcbe06713b435f091ef2769fb160cdab33d3670680e");
+
+	ok &= expect("seedHash(30000)", EthashAux::seedHash(30000).hex(), "290decd9548b62a8d60345a988386fc84ba6bc95484008f6362f93160ef3e563");
+	ok &= expect("number(seedHash(300000))", toString(EthashAux::number(EthashAux::seedHash(300000))), "300000");
+
+	ethash_h256_t seed;
+	memset(&seed, 0, sizeof(seed));
+	LightPtr light(ethash_light_new_internal(c_testCacheSize, &seed));
+	ok &= expect("cache nodes", sha3(bytesConstRef((byte const*)light->cache, c_testCacheSize)).hex(), "92591c70a0fb6058340313346356b789f333ae1e1eb20ae12e005ad5e922a2ac");
+
+	ethash_return_value_t r = ethash_light_compute_internal(light.get(), c_testFullSize, testHeader(), c_testNonce);
+	ok &= expect("light mix", toHex(bytesConstRef(r.mix_hash.b, 32)), "33ef7722c25a1d8149034b08c6304949c254a94517987de20d692ca2619841da");
+	ok &= expect("light result", toHex(bytesConstRef(r.result.b, 32)), "6762acb95fda11c747cd6e4eca75e56ce93001a75af080ab3db45f4345b2dbf7");
+
+	vector<node> full = fullDataSet(light.get(), c_testFullSize);
+	r = ethash_full_compute_internal(full.data(), c_testFullSize, testHeader(), c_testNonce);
+	ok &= expect("full mix", toHex(bytesConstRef(r.mix_hash.b, 32)), "33ef7722c25a1d8149034b08c6304949c254a94517987de20d692ca2619841da");
+	ok &= expect("full result", toHex(bytesConstRef(r.result.b, 32)), "6762acb95fda11c747cd6e4eca75e56ce93001a75af080ab3db45f4345b2dbf7");
+
+	h256 boundary("00000000ffff0000000000000000000000000000000000000000000000000000");
+	ok &= expect("boundary compare", toString(h256("00000000fffe0000000000000000000000000000000000000000000000000000") < boundary), "1");
+	ok &= expect("boundary target", toString((uint64_t)(u64)((u256)boundary >> 192)), "4294901760");
+
+	return ok;
+}
+
+/**
+ * @brief Runs @a _body in growing batches until at least @a _minSeconds elapsed, then prints the time per call.
+ */
+void run(string const& _name, double _minSeconds, function<void()> const& _body)
+{
+	uint64_t iterations = 0;
+	double elapsed = 0;
+	for (uint64_t batch = 1; elapsed < _minSeconds; batch *= 2)
+	{
+		auto start = chrono::steady_clock::now();
+		for (uint64_t i = 0; i < batch; ++i)
+			_body();
+		elapsed += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		iterations += batch;
+	}
+	double ns = elapsed * 1e9 / iterations;
+	cout << left << setw(32) << _name << right << setw(12) << iterations << setw(16) << fixed << setprecision(1) << ns << " ns" << setw(16) << setprecision(0) << 1e9 / ns << " /s" << endl;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	string filter;
+	double minSeconds = 1;
+	uint64_t fullMB = 64;
+	bool checkOnly = false;
+	for (int i = 1; i < argc; ++i)
+	{
+		string arg = argv[i];
+		if (arg == "--min-time" && i + 1 < argc)
+			minSeconds = stod(argv[++i]);
+		else if (arg == "--full-mb" && i + 1 < argc)
+			fullMB = stoul(argv[++i]);
+		else if (arg == "--check")
+			checkOnly = true;
+		else if (arg == "-h" || arg == "--help")
+		{
+			cout << "Usage: ethash-bench [--check] [--min-time <seconds>] [--full-mb <n>] [filter]" << endl
+				 << "    --check  Only verify the test vectors." << endl
+				 << "    --min-time <seconds>  Minimum run time of each benchmark (default: 1)." << endl
+				 << "    --full-mb <n>  Size of the data set used by full/hash (default: 64)." << endl
+				 << "    filter  Only run benchmarks whose name contains filter." << endl;
+			return 0;
+		}
+		else
+			filter = arg;
+	}
+
+	if (!checkVectors())
+		return 1;
+	cout << "Test vectors OK" << endl;
+	if (checkOnly)
+		return 0;
+
+	auto selected = [&](string const& _name) { return _name.find(filter) != string::npos; };
+
+	uint8_t in[128] = {};
+	uint8_t out[64];
+	if (selected("keccak256/32"))
+		run("keccak256/32", minSeconds, [&]() { sha3_256(out, 32, in, 32); sink(out, 1); });
+	if (selected("keccak512/64"))
+		run("keccak512/64", minSeconds, [&]() { sha3_512(out, 64, in, 64); sink(out, 1); });
+
+	// Epoch 0 sized cache, as used for verification and DAG generation.
+	uint64_t const cacheSize = ethash_get_cachesize(0);
+	ethash_h256_t seed = ethash_get_seedhash(0);
+	if (selected("cache_nodes/epoch0"))
+	{
+		vector<node> nodes(cacheSize / sizeof(node));
+		run("cache_nodes/epoch0", minSeconds, [&]() { ethash_compute_cache_nodes(nodes.data(), cacheSize, &seed); sink(nodes.data(), 1); });
+	}
+
+	LightPtr light(ethash_light_new(0));
+	if (selected("dag_item"))
+	{
+		uint32_t index = 0;
+		node item;
+		run("dag_item", minSeconds, [&]() { ethash_calculate_dag_item(&item, index++, light.get()); sink(&item, 1); });
+	}
+
+	ethash_h256_t header = testHeader();
+	uint64_t nonce = 0;
+	if (selected("light/hash"))
+		run("light/hash", minSeconds, [&]() { ethash_return_value_t r = ethash_light_compute(light.get(), header, nonce++); sink(&r.result, 1); });
+
+	if (selected("full/hash"))
+	{
+		uint64_t fullSize = fullMB * 1024 * 1024;
+		cout << "Building " << fullMB << " MB data set..." << endl;
+		vector<node> full = fullDataSet(light.get(), fullSize);
+		run("full/hash/" + toString(fullMB) + "MB", minSeconds, [&]() { ethash_return_value_t r = ethash_full_compute_internal(full.data(), fullSize, header, nonce++); sink(&r.result, 1); });
+	}
+
+	unsigned block = 0;
+	if (selected("seedHash"))
+		run("seedHash", minSeconds, [&]() { h256 s = EthashAux::seedHash(block); block = (block + ETHASH_EPOCH_LENGTH) % (ETHASH_EPOCH_LENGTH * 256); sink(s.data(), 1); });
+	h256 seedHash = EthashAux::seedHash(ETHASH_EPOCH_LENGTH * 200);
+	if (selected("number"))
+		run("number", minSeconds, [&]() { uint64_t n = EthashAux::number(seedHash); sink(&n, 1); });
+
+	h256 boundary("00000000ffff0000000000000000000000000000000000000000000000000000");
+	h256 value = h256::random();
+	if (selected("boundary/compare"))
+		run("boundary/compare", minSeconds, [&]() { bool b = value < boundary; value[31]++; sink(&b, 1); });
+	if (selected("boundary/target"))
+		run("boundary/target", minSeconds, [&]() { uint64_t t = (uint64_t)(u64)((u256)boundary >> 192); boundary[31]++; sink(&t, 1); });
+
+	return 0;
+}
@@ -0,0 +1,188 @@
+/// Benchmark results as JSON and comparison against a stored baseline.
+///
+/// @file
+/// @copyright GNU General Public License
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <json/json.h>
+#include <libethash/ethash.h>
+
+/// Results of one device.
+struct DeviceBenchmark
+{
+	std::string name;			///< Unique miner name, e.g. cl-0.
+	std::string model;			///< Device name as reported by the driver.
+	std::vector<double> warmup;	///< Hashrate over each second of the warm-up, including DAG generation.
+	std::vector<double> trials;	///< Sustained hashrate of each trial.
+	double dagSeconds = 0;		///< Duration of the DAG generation.
+	double switchSeconds = 0;	///< Mean latency from a new job to the device searching it.
+	uint64_t switches = 0;
+};
+
+/// Summary statistics of a series of samples.
+inline Json::Value benchmarkStats(std::vector<double> const& _samples)
+{
+	Json::Value ret;
+	double mean = 0;
+	double variance = 0;
+	for (double s: _samples)
+		mean += s;
+	if (!_samples.empty())
+		mean /= _samples.size();
+	for (double s: _samples)
+		variance += (s - mean) * (s - mean);
+	if (_samples.size() > 1)
+		variance /= _samples.size() - 1;
+
+	ret["mean"] = mean;
+	ret["stddev"] = std::sqrt(variance);
+	ret["min"] = _samples.empty() ? 0 : *std::min_element(_samples.begin(), _samples.end());
+	ret["max"] = _samples.empty() ? 0 : *std::max_element(_samples.begin(), _samples.end());
+	ret["samples"] = Json::Value(Json::arrayValue);
+	for (double s: _samples)
+		ret["samples"].append(s);
+	return ret;
+}
+
+inline Json::Value benchmarkJson(unsigned _block, unsigned _warmup, unsigned _trial, std::vector<double> const& _total, std::vector<DeviceBenchmark> const& _devices)
+{
+	Json::Value ret;
+	ret["block"] = _block;
+	ret["warmup_seconds"] = _warmup;
+	ret["trial_seconds"] = _trial;
+	ret["trials"] = (unsigned)_total.size();
+	ret["hashrate"] = benchmarkStats(_total);
+	ret["devices"] = Json::Value(Json::arrayValue);
+	for (auto const& d: _devices)
+	{
+		Json::Value device;
+		device["name"] = d.name;
+		device["model"] = d.model;
+		device["hashrate"] = benchmarkStats(d.trials);
+		device["warmup"] = Json::Value(Json::arrayValue);
+		for (double w: d.warmup)
+			device["warmup"].append(w);
+		device["dag_seconds"] = d.dagSeconds;
+		device["job_switch_seconds"] = d.switchSeconds;
+		device["job_switches"] = Json::UInt64(d.switches);
+		ret["devices"].append(device);
+	}
+	return ret;
+}
+
+/// @returns true and reports when @a _current is worse than @a _baseline by more than @a _threshold percent.
+/// Hashrates regress downwards, durations upwards. Missing or zero baselines never regress.
+inline bool benchmarkRegressed(std::string const& _what, double _current, double _baseline, bool _higherIsBetter, double _threshold, std::ostream& _out)
+{
+	if (_baseline <= 0)
+		return false;
+	double change = (_current - _baseline) / _baseline * 100;
+	bool regressed = _higherIsBetter ? change < -_threshold : change > _threshold;
+	_out << (regressed ? "REGRESSION " : "ok         ") << _what << ": " << _current << " vs baseline " << _baseline
+		 << " (" << (change >= 0 ? "+" : "") << change << "%)" << std::endl;
+	return regressed;
+}
+
+/**
+ * @brief Compares a benchmark against a baseline produced by the same command.
+ * Devices are matched by name; devices missing from either side are ignored.
+ * @returns the number of metrics that regressed by more than @a _threshold percent.
+ */
+inline unsigned compareBenchmarks(Json::Value const& _current, Json::Value const& _baseline, double _threshold, std::ostream& _out)
+{
+	unsigned regressions = 0;
+	regressions += benchmarkRegressed("hashrate", _current["hashrate"]["mean"].asDouble(), _baseline["hashrate"]["mean"].asDouble(), true, _threshold, _out);
+
+	for (auto const& device: _current["devices"])
+	{
+		std::string name = device["name"].asString();
+		for (auto const& base: _baseline["devices"])
+		{
+			if (base["name"].asString() != name)
+				continue;
+			regressions += benchmarkRegressed(name + " hashrate", device["hashrate"]["mean"].asDouble(), base["hashrate"]["mean"].asDouble(), true, _threshold, _out);
+			regressions += benchmarkRegressed(name + " dag_seconds", device["dag_seconds"].asDouble(), base["dag_seconds"].asDouble(), false, _threshold, _out);
+			regressions += benchmarkRegressed(name + " job_switch_seconds", device["job_switch_seconds"].asDouble(), base["job_switch_seconds"].asDouble(), false, _threshold, _out);
+		}
+	}
+	return regressions;
+}
+
+/// Results of one epoch of a sweep.
+struct EpochBenchmark
+{
+	unsigned epoch = 0;
+	uint64_t dagBytes = 0;
+	std::vector<double> total;
+	std::vector<DeviceBenchmark> devices;
+};
+
+/**
+ * @brief Parses a list of epochs such as "100,150" or ranges "100-200:10" (every 10th epoch).
+ * @throws std::invalid_argument on malformed input.
+ */
+inline std::vector<unsigned> parseEpochs(std::string const& _spec)
+{
+	std::vector<unsigned> ret;
+	std::string::size_type pos = 0;
+	while (pos <= _spec.size())
+	{
+		std::string::size_type end = _spec.find(',', pos);
+		std::string item = _spec.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+		std::string::size_type dash = item.find('-');
+		if (dash == std::string::npos)
+			ret.push_back(std::stoul(item));
+		else
+		{
+			std::string::size_type colon = item.find(':', dash);
+			unsigned first = std::stoul(item.substr(0, dash));
+			unsigned last = std::stoul(item.substr(dash + 1, colon == std::string::npos ? std::string::npos : colon - dash - 1));
+			unsigned step = colon == std::string::npos ? 1 : std::stoul(item.substr(colon + 1));
+			if (!step || last < first)
+				throw std::invalid_argument(item);
+			for (unsigned e = first; e <= last; e += step)
+				ret.push_back(e);
+		}
+		if (end == std::string::npos)
+			break;
+		pos = end + 1;
+	}
+	return ret;
+}
+
+inline Json::Value benchmarkSweepJson(unsigned _warmup, unsigned _trial, std::vector<EpochBenchmark> const& _epochs)
+{
+	Json::Value ret;
+	ret["sweep"] = Json::Value(Json::arrayValue);
+	for (auto const& e: _epochs)
+	{
+		Json::Value epoch = benchmarkJson(e.epoch * ETHASH_EPOCH_LENGTH, _warmup, _trial, e.total, e.devices);
+		epoch["epoch"] = e.epoch;
+		epoch["dag_bytes"] = Json::UInt64(e.dagBytes);
+		ret["sweep"].append(epoch);
+	}
+	return ret;
+}
+
+/// Writes one row per epoch and device.
+inline void benchmarkSweepCsv(std::ostream& _out, std::vector<EpochBenchmark> const& _epochs)
+{
+	_out << "epoch,dag_bytes,device,model,hashrate,hashrate_stddev,dag_seconds,job_switch_seconds\n";
+	for (auto const& e: _epochs)
+		for (auto const& d: e.devices)
+		{
+			Json::Value stats = benchmarkStats(d.trials);
+			std::string model = d.model;
+			std::replace(model.begin(), model.end(), ',', ' ');
+			_out << e.epoch << "," << e.dagBytes << "," << d.name << "," << model << ","
+				 << stats["mean"].asDouble() << "," << stats["stddev"].asDouble() << ","
+				 << d.dagSeconds << "," << d.switchSeconds << "\n";
+		}
+}
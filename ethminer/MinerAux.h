@@ -38,9 +38,11 @@
 #include <boost/optional.hpp>
 
 #include <libethcore/Exceptions.h>
+#include <libethcore/BandwidthProbe.h>
 #include <libdevcore/SHA3.h>
 #include <libethcore/EthashAux.h>
 #include <libethcore/Farm.h>
+#include <libethcore/SimMiner.h>
 
 
 
@@ -54,6 +56,8 @@
 #include <libethash-cuda/CUDAMiner.h>
 #endif
 #include <jsonrpccpp/client/connectors/httpclient.h>
+#include "BenchmarkReport.h"
+#include "StaleSimulation.h"
 #include "FarmClient.h"
 #include <libstratum/EthStratumClient.h>
 #include <libstratum/EthStratumClientV2.h>
@@ -62,6 +66,8 @@
 #endif
 #if API_CORE
 #include <libapicore/Api.h>
+#include <libapicore/MetricsServer.h>
+#include <libapicore/EventServer.h>
 #endif
 
 using namespace std;
@@ -148,6 +154,15 @@ public:
 				cerr << "Bad " << arg << " option: " << argv[i] << endl;
 				BOOST_THROW_EXCEPTION(BadArgument());
 			}
+		else if (arg == "--io-threads" && i + 1 < argc)
+			try {
+				m_ioThreads = stol(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
 		else if (arg == "--farm-retries" && i + 1 < argc)
 			try {
 				m_maxFarmRetries = stol(argv[++i]);
@@ -260,12 +275,44 @@ public:
 		{
 			m_show_hwmonitors = true;
 		}
+		else if (arg == "--hwmon-interval" && i + 1 < argc)
+			try {
+				m_hwmonInterval = stol(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		else if (arg == "--thermal-target" && i + 1 < argc)
+			try {
+				m_thermalTarget = stol(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		else if (arg == "--thermal-sim")
+			m_thermalSimulation = true;
+		else if (arg == "--trace" && i + 1 < argc)
+		{
+			m_traceFile = argv[++i];
+		}
 
 #if API_CORE
 		else if ((arg == "--api-port") && i + 1 < argc)
 		{
 			m_api_port = atoi(argv[++i]);
 		}
+		else if ((arg == "--metrics-port") && i + 1 < argc)
+		{
+			m_metrics_port = atoi(argv[++i]);
+		}
+		else if ((arg == "--events-port") && i + 1 < argc)
+		{
+			m_events_port = atoi(argv[++i]);
+		}
 #endif
 #if ETH_ETHASHCL
 		else if (arg == "--opencl-platform" && i + 1 < argc)
@@ -329,6 +376,12 @@ public:
 				BOOST_THROW_EXCEPTION(BadArgument());
 			}
 		}
+		else if (arg == "--cl-profiling")
+			m_openclProfiling = true;
+#if defined(__linux)
+		else if (arg == "--sysfs-root" && i + 1 < argc)
+			m_sysfsRoot = argv[++i];
+#endif
 		else if ( arg == "--cl-local-work" && i + 1 < argc)
 			try
 			{
@@ -428,6 +481,69 @@ public:
 				BOOST_THROW_EXCEPTION(BadArgument());
 			}
 		}
+		else if (arg == "--dag-concurrency" && i + 1 < argc)
+			try {
+				m_dagConcurrency = stol(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		else if (arg == "--dag-pregen" && i + 1 < argc)
+			try {
+				m_dagPregenBlocks = stol(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		else if (arg == "--dag-check" && i + 1 < argc)
+			try {
+				m_dagCheckInterval = stol(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		else if (arg == "--health-throttle" && i + 1 < argc)
+			try {
+				m_healthPolicy.throttle = stol(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		else if (arg == "--health-regenerate" && i + 1 < argc)
+			try {
+				m_healthPolicy.regenerate = stol(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		else if (arg == "--health-quarantine" && i + 1 < argc)
+			try {
+				m_healthPolicy.quarantine = stol(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		else if (arg == "--health-stall" && i + 1 < argc)
+			try {
+				m_healthStall = stol(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
 		else if (arg == "--benchmark-warmup" && i + 1 < argc)
 			try {
 				m_benchmarkWarmup = stol(argv[++i]);
@@ -446,6 +562,33 @@ public:
 				cerr << "Bad " << arg << " option: " << argv[i] << endl;
 				BOOST_THROW_EXCEPTION(BadArgument());
 			}
+		else if (arg == "--benchmark-json" && i + 1 < argc)
+			m_benchmarkJson = argv[++i];
+		else if (arg == "--benchmark-csv" && i + 1 < argc)
+			m_benchmarkCsv = argv[++i];
+		else if (arg == "--benchmark-sweep" && i + 1 < argc)
+			try
+			{
+				m_benchmarkSweep = parseEpochs(argv[++i]);
+				mode = OperationMode::Benchmark;
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		else if (arg == "--benchmark-baseline" && i + 1 < argc)
+			m_benchmarkBaseline = argv[++i];
+		else if (arg == "--benchmark-threshold" && i + 1 < argc)
+			try
+			{
+				m_benchmarkThreshold = stod(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
 		else if (arg == "--benchmark-trials" && i + 1 < argc)
 			try
 			{
@@ -466,6 +609,97 @@ public:
 		{
 			m_minerType = MinerType::Mixed;
 		}
+		else if (arg == "--sim" && i + 1 < argc)
+			try {
+				m_simDevices = stol(argv[++i]);
+				m_minerType = MinerType::Sim;
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		else if (arg == "--sim-hashrate" && i + 1 < argc)
+			try {
+				m_simSettings.hashrate = stod(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		else if (arg == "--sim-kernel-ms" && i + 1 < argc)
+			try {
+				m_simSettings.kernelMs = stol(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		else if (arg == "--sim-jitter" && i + 1 < argc)
+			try {
+				m_simSettings.jitter = stod(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		else if (arg == "--sim-dag-ms" && i + 1 < argc)
+			try {
+				m_simSettings.dagMs = stol(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		else if (arg == "--sim-failure-rate" && i + 1 < argc)
+			try {
+				m_simSettings.failureRate = stod(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		else if (arg == "--sim-hang-ms" && i + 1 < argc)
+			try {
+				m_simSettings.hangMs = stol(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		else if (arg == "--sim-solution-rate" && i + 1 < argc)
+			try {
+				m_simSettings.solutionRate = stod(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		else if (arg == "--sim-bad-solution-rate" && i + 1 < argc)
+			try {
+				m_simSettings.badSolutionRate = stod(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		else if (arg == "--sim-difficulty" && i + 1 < argc)
+			try {
+				m_simSettings.difficultyBits = stol(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
 
 #if ETH_ETHASHOCL
 		else if (arg == "--fpga" || arg == "--opencl")
@@ -516,6 +750,49 @@ public:
 				}
 			}
 		}
+		else if (arg == "--stale-sim" && i + 1 < argc)
+			try
+			{
+				m_staleIntervals = parseIntervals(argv[++i]);
+				mode = OperationMode::Simulation;
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		else if (arg == "--stale-sim-duration" && i + 1 < argc)
+			try
+			{
+				m_staleDuration = stol(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		else if (arg == "--stale-sim-difficulty" && i + 1 < argc)
+			try
+			{
+				m_staleDifficulty = stol(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		else if (arg == "--stale-sim-seed" && i + 1 < argc)
+			try
+			{
+				m_staleSeed = stoull(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		else if (arg == "--stale-sim-csv" && i + 1 < argc)
+			m_staleCsv = argv[++i];
 		else if ((arg == "-t" || arg == "--mining-threads") && i + 1 < argc)
 		{
 			try
@@ -535,8 +812,17 @@ public:
 
 	void execute()
 	{
+		EventLoop::setThreads(m_ioThreads);
+		if (!m_dagConcurrency && m_dagLoadMode == DAG_LOAD_MODE_SEQUENTIAL)
+			m_dagConcurrency = 1;
+		DagCoordinator::get().setConcurrency(m_dagConcurrency);
+		Miner::setDagCheckInterval(m_dagCheckInterval);
+		m_healthPolicy.stall = chrono::seconds(m_healthStall);
+		Miner::setHealthPolicy(m_healthPolicy);
+
 		if (m_shouldListDevices)
 		{
+			cout << "\nHost memory: " << formatBandwidth(probeHostBandwidth()) << "\n";
 #if ETH_ETHASHCL
 			if (m_minerType == MinerType::CL || m_minerType == MinerType::Mixed)
 				CLMiner::listDevices();
@@ -566,6 +852,11 @@ public:
 
 			CLMiner::setCLKernel(m_openclSelectedKernel);
 			CLMiner::setThreadsPerHash(m_openclThreadsPerHash);
+			CLMiner::setProfiling(m_openclProfiling);
+#if defined(__linux)
+			if (!m_sysfsRoot.empty())
+				CLMiner::setSysfsRoot(m_sysfsRoot);
+#endif
 
 			if (!CLMiner::configureGPU(
 					m_localWorkSize,
@@ -638,10 +929,26 @@ public:
 #endif
 		}
 
+		if (m_minerType == MinerType::Sim)
+		{
+			SimMiner::setNumInstances(m_simDevices);
+			SimMiner::settings() = m_simSettings;
+		}
+
+		if (!m_traceFile.empty())
+			Tracer::enable(m_traceFile);
+
+		Miner::setThermalTarget(m_thermalTarget);
+		Miner::setThermalSimulation(m_thermalSimulation);
+		if ((m_thermalTarget || m_thermalSimulation) && !m_hwmonInterval)
+			cwarn << "--thermal-target and --thermal-sim need --hwmon-interval > 0";
+
 		if (mode == OperationMode::Benchmark)
 			doBenchmark(m_minerType, m_benchmarkWarmup, m_benchmarkTrial, m_benchmarkTrials);
 		else if (mode == OperationMode::Farm)
 			doFarm(m_minerType, m_activeFarmURL, m_farmRecheckPeriod);
+		else if (mode == OperationMode::Simulation && !m_staleIntervals.empty())
+			doStaleSimulation(m_minerType);
 		else if (mode == OperationMode::Simulation)
 			doSimulation(m_minerType);
 		else if (mode == OperationMode::Stratum)
@@ -666,17 +973,35 @@ public:
 			<< "        1: eth-proxy compatible: dwarfpool, f2pool, nanopool (required for hashrate reporting to work with nanopool)" << endl
 			<< "        2: EthereumStratum/1.0.0: nicehash" << endl
 			<< "    -RH, --report-hashrate Report current hashrate to pool (please only enable on pools supporting this)" << endl
-			<< "    -HWMON Displays gpu temp and fan percent." << endl
+			<< "    -HWMON Displays gpu temp, fan percent, power draw and efficiency (Mh/J) where the device reports it." << endl
+			<< "    --hwmon-interval <n> Sample gpu sensors every n ms in the background. Use 0 to disable. Default=1000" << endl
+			<< "    --thermal-target <n> Hold each gpu at n degrees Celsius by idling it part of the time. Default=0 (off)" << endl
+			<< "    --thermal-sim Replace the gpu temperature sensors by a simulated thermal model, to try out --thermal-target" << endl
 			<< "    -SE, --stratum-email <s> Email address used in eth-proxy (optional)" << endl
 			<< "    --farm-recheck <n>  Leave n ms between checks for changed work (default: 500). When using stratum, use a high value (i.e. 2000) to get more stable hashrate output" << endl
+			<< "    --io-threads <n> Threads running the farm timers, pool connection and API servers (default: 1)." << endl
+			<< "    --trace <file> Record job, kernel and share events. The Chrome trace JSON is written to file on exit and on SIGUSR1." << endl
 			<< endl
 			<< "Benchmarking mode:" << endl
 			<< "    -M [<n>],--benchmark [<n>] Benchmark for mining and exit; Optionally specify block number to benchmark against specific DAG." << endl
 			<< "    --benchmark-warmup <seconds>  Set the duration of warmup for the benchmark tests (default: 3)." << endl
 			<< "    --benchmark-trial <seconds>  Set the duration for each trial for the benchmark tests (default: 3)." << endl
 			<< "    --benchmark-trials <n>  Set the number of benchmark trials to run (default: 5)." << endl
+			<< "    --benchmark-json <file>  Write the results as JSON to file, use - for stdout, progress then goes to stderr." << endl
+			<< "    --benchmark-sweep <epochs>  Benchmark each epoch of a list or range, e.g. 100,150 or 100-200:10 (every 10th), regenerating the DAG for each." << endl
+			<< "    --benchmark-csv <file>  Write the sweep results as CSV to file, use - for stdout. --benchmark-json writes them as JSON." << endl
+			<< "    --benchmark-baseline <file>  Compare against a JSON report from an earlier run and exit with 1 on regressions." << endl
+			<< "    --benchmark-threshold <percent>  Change tolerated by the baseline comparison (default: 5)." << endl
 			<< "Simulation mode:" << endl
 			<< "    -Z [<n>],--simulation [<n>] Mining test mode. Used to validate kernel optimizations. Optionally specify block number." << endl
+			<< "    --stale-sim <seconds>  Feed jobs at random (Poisson) intervals with the given means, e.g. 1,5,15, and report" << endl
+			<< "        the stale share ratio, hashes wasted on replaced jobs, the lag of stale shares and the find-to-submit" << endl
+			<< "        latency, from a device reporting a share to the farm receiving it. Compare batch sizes" << endl
+			<< "        (--cl-global-work, --cuda-grid-size, --sim-kernel-ms) by running it once for each." << endl
+			<< "    --stale-sim-duration <seconds>  Duration of each job interval (default: 60)." << endl
+			<< "    --stale-sim-difficulty <bits>  Share difficulty as a power of two (default: 26)." << endl
+			<< "    --stale-sim-seed <n>  Seed of the job stream, equal seeds give equal streams (default: 1)." << endl
+			<< "    --stale-sim-csv <file>  Also write the results as CSV to file, use - for stdout." << endl
 			<< "Mining configuration:" << endl
 			<< "    -G,--opencl  When mining use the GPU via OpenCL." << endl
 #if ETH_ETHASHOCL
@@ -684,24 +1009,49 @@ public:
 #endif
 			<< "    -U,--cuda  When mining use the GPU via CUDA." << endl
 			<< "    -X,--cuda-opencl Use OpenCL + CUDA in a system with mixed AMD/Nvidia cards. May require setting --opencl-platform 1" << endl
+			<< "    --sim <n>  Mine on n simulated devices instead of hardware, to test farm and pool behaviour at scale." << endl
+			<< " Simulated device configuration:" << endl
+			<< "    --sim-hashrate <n>  Hashes per second of each device (default: 30000000)." << endl
+			<< "    --sim-kernel-ms <n>  Duration of one search batch (default: 50)." << endl
+			<< "    --sim-jitter <f>  Random variation of the batch duration as a fraction (default: 0.1)." << endl
+			<< "    --sim-dag-ms <n>  Duration of the DAG generation on each new epoch (default: 0)." << endl
+			<< "    --sim-failure-rate <f>  Probability per batch that a device hangs (default: 0)." << endl
+			<< "    --sim-hang-ms <n>  Duration of a simulated hang (default: 10000)." << endl
+			<< "    --sim-solution-rate <f>  Probability per batch of finding a solution (default: 0.01)." << endl
+			<< "    --sim-bad-solution-rate <f>  Fraction of solutions submitted with a wrong nonce (default: 0)." << endl
+			<< "    --sim-difficulty <bits>  Solutions are valid for a boundary of 2^(256-bits), or the work's boundary if easier (default: 4)." << endl
 			<< "    --opencl-platform <n>  When mining using -G/--opencl use OpenCL platform n (default: 0)." << endl
 			<< "    --opencl-device <n>  When mining using -G/--opencl use OpenCL device n (default: 0)." << endl
 			<< "    --opencl-devices <0 1 ..n> Select which OpenCL devices to mine on. Default is to use all" << endl
 			<< "    -t, --mining-threads <n> Limit number of CPU/GPU miners to n (default: use everything available on selected platform)" << endl
-			<< "    --list-devices List the detected OpenCL/CUDA devices and exit. Should be combined with -G or -U flag" << endl
+			<< "    --list-devices List the detected OpenCL/CUDA devices with their measured random-read bandwidth and ethash ceiling, and exit. Should be combined with -G or -U flag" << endl
 			<< "    -L, --dag-load-mode <mode> DAG generation mode." << endl
 			<< "        parallel    - load DAG on all GPUs at the same time (default)" << endl
 			<< "        sequential  - load DAG on GPUs one after another. Use this when the miner crashes during DAG generation" << endl
 			<< "        single <n>  - generate DAG on device n, then copy to other devices" << endl
+			<< "    --dag-pregen <n> Build the next epoch's DAG in spare device memory within n blocks of the epoch boundary, so" << endl
+			<< "        the switch is immediate. Needs a pool that sends the block number (default: 0, off)" << endl
+			<< "    --dag-concurrency <n> Build the DAG on at most n devices at a time, fastest devices first (default: 0, no limit; 1 with sequential)" << endl
+			<< "    --dag-check <n> Every n seconds, read random DAG items back from each device and compare them with the CPU." << endl
+			<< "        A corrupted DAG, e.g. from memory overclocking, is regenerated (default: 0, off)" << endl
+			<< " Device health (faults are incorrect results, device errors, stalls and corrupted DAGs):" << endl
+			<< "    --health-throttle <n> Lower a device's intensity by another 25% after n faults within an hour, raise it back a step after each hour with fewer (default: 0, off)" << endl
+			<< "    --health-regenerate <n> Regenerate a device's DAG after n faults within an hour (default: 0, off)" << endl
+			<< "    --health-quarantine <n> Stop a device until the miner restarts after n faults within an hour (default: 0, off)" << endl
+			<< "    --health-stall <n> Count n seconds without hashes while there is work as a stall (default: 60, 0 disables)" << endl
 #if ETH_ETHASHCL
 			<< " OpenCL configuration:" << endl
 			<< "    --cl-kernel <n>  Use a different OpenCL kernel (default: use stable kernel)" << endl
 			<< "        0: stable kernel" << endl
 			<< "        1: unstable kernel" << endl
-//			<< "        2: experimental kernel" << endl
+			<< "        2: custom kernel read from <device name>.cl or kernel.cl, reloaded while mining when the file changes" << endl
 			<< "    --cl-local-work Set the OpenCL local work size. Default is " << CLMiner::c_defaultLocalWorkSize << endl
 			<< "    --cl-global-work Set the OpenCL global work size as a multiple of the local work size. Default is " << CLMiner::c_defaultGlobalWorkSizeMultiplier << " * " << CLMiner::c_defaultLocalWorkSize << endl
 			<< "    --cl-parallel-hash <1 2 ..8> Define how many threads to associate per hash. Default=8" << endl
+			<< "    --cl-profiling Record OpenCL profiling events of kernels and transfers into the metrics (adds some overhead)." << endl
+#if defined(__linux)
+			<< "    --sysfs-root <path> Read the AMD gpu sensors (temperature, fan, power, clocks) from path/class/drm instead of /sys/class/drm" << endl
+#endif
 #endif
 #if ETH_ETHASHCUDA
 			<< " CUDA configuration:" << endl
@@ -719,12 +1069,154 @@ public:
 #if API_CORE
 			<< " API core configuration:" << endl
 			<< "    --api-port Set the api port, the miner should listen to. Use 0 to disable. Default=0, use negative numbers to run in readonly mode. for example -3333." << endl
+			<< "    --metrics-port Set the port to serve Prometheus metrics on at /metrics. Use 0 to disable. Default=0" << endl
+			<< "    --events-port Set the port to stream events on as JSON lines (new jobs, shares, device errors, DAG progress, hashrate). Use 0 to disable. Default=0" << endl
 #endif
 			;
 	}
 
 private:
 
+	/**
+	 * @brief Mines @a _header on the running farm: a warm-up, which includes any DAG generation, then @a _trials trials.
+	 * Fills the total hashrate of each trial and the per device results.
+	 */
+	void runBenchmark(Farm& _f, BlockHeader const& _header, unsigned _warmupDuration, unsigned _trialDuration, unsigned _trials, vector<double>& o_total, vector<DeviceBenchmark>& o_devices)
+	{
+		auto miners = _f.miners();
+		o_devices.assign(miners.size(), DeviceBenchmark());
+		for (size_t d = 0; d < miners.size(); ++d)
+		{
+			o_devices[d].name = miners[d]->name();
+			o_devices[d].model = miners[d]->Name();
+		}
+
+		// Per device hashrate since the previous call, from the monotonic hash counters.
+		vector<uint64_t> lastHashes(miners.size(), 0);
+		auto lastSample = chrono::steady_clock::now();
+		auto sampleRates = [&]()
+		{
+			auto now = chrono::steady_clock::now();
+			double seconds = chrono::duration<double>(now - lastSample).count();
+			lastSample = now;
+			vector<double> rates(miners.size(), 0);
+			for (size_t d = 0; d < miners.size(); ++d)
+			{
+				uint64_t hashes = miners[d]->metrics().hashes.value();
+				rates[d] = seconds > 0 ? (hashes - lastHashes[d]) / seconds : 0;
+				lastHashes[d] = hashes;
+			}
+			return rates;
+		};
+		sampleRates();
+		vector<uint64_t> startHashes = lastHashes;
+
+		_f.setWork(WorkPackage{_header});
+
+		benchmarkLog() << "Warming up..." << endl;
+		for (unsigned s = 0; s < _warmupDuration; ++s)
+		{
+			this_thread::sleep_for(chrono::seconds(1));
+			auto rates = sampleRates();
+			for (size_t d = 0; d < miners.size(); ++d)
+				o_devices[d].warmup.push_back(rates[d]);
+		}
+
+		// The DAG generation may outlast the warm-up, wait for every device to hash before timing trials.
+		for (unsigned waited = 0; waited < 600 * 10; ++waited)
+		{
+			bool ready = true;
+			for (size_t d = 0; d < miners.size(); ++d)
+				ready = ready && miners[d]->metrics().hashes.value() != startHashes[d];
+			if (ready)
+				break;
+			this_thread::sleep_for(chrono::milliseconds(100));
+		}
+
+		vector<uint64_t> switchCounts(miners.size());
+		vector<double> switchSums(miners.size());
+		for (size_t d = 0; d < miners.size(); ++d)
+		{
+			o_devices[d].dagSeconds = miners[d]->metrics().dagTime.value();
+			switchCounts[d] = miners[d]->metrics().workSwitch.count();
+			switchSums[d] = miners[d]->metrics().workSwitch.sum();
+		}
+
+		o_total.clear();
+		for (unsigned i = 1; i <= _trials; ++i)
+		{
+			// Every trial starts with a fresh job on the same epoch to measure the job switch latency.
+			WorkPackage wp{_header};
+			wp.header = h256::random();
+			_f.setWork(wp);
+			sampleRates();
+
+			benchmarkLog() << "Trial " << i << "... " << flush;
+			this_thread::sleep_for(chrono::seconds(_trialDuration));
+
+			auto rates = sampleRates();
+			double rate = 0;
+			for (size_t d = 0; d < miners.size(); ++d)
+			{
+				o_devices[d].trials.push_back(rates[d]);
+				rate += rates[d];
+			}
+			benchmarkLog() << (uint64_t)rate << endl;
+			o_total.push_back(rate);
+		}
+
+		for (size_t d = 0; d < miners.size(); ++d)
+		{
+			auto& ws = miners[d]->metrics().workSwitch;
+			o_devices[d].switches = ws.count() - switchCounts[d];
+			o_devices[d].switchSeconds = o_devices[d].switches ? (ws.sum() - switchSums[d]) / o_devices[d].switches : 0;
+		}
+	}
+
+	/// Measures the CPU path: light cache generation and single threaded light evaluation, as used to verify solutions.
+	/// Builds its own light, bypassing the cache, and expects the miners to be stopped so they do not share the CPU.
+	static DeviceBenchmark benchmarkLightEvaluation(WorkPackage const& _wp, unsigned _trialDuration)
+	{
+		DeviceBenchmark ret;
+		ret.name = "cpu";
+		ret.model = "light evaluation";
+
+		auto start = chrono::steady_clock::now();
+		EthashAux::LightType light = make_shared<EthashAux::LightAllocation>(_wp.seed);
+		ret.dagSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+		uint64_t nonce = 0;
+		start = chrono::steady_clock::now();
+		auto end = start + chrono::seconds(max(1u, _trialDuration));
+		while (chrono::steady_clock::now() < end)
+			light->compute(_wp.header, nonce++);
+		ret.trials.push_back(nonce / chrono::duration<double>(chrono::steady_clock::now() - start).count());
+		return ret;
+	}
+
+	/// @returns the stream for benchmark progress: stderr when the results go to stdout, so they stay parseable.
+	ostream& benchmarkLog() const
+	{
+		return m_benchmarkJson == "-" || m_benchmarkCsv == "-" ? cerr : cout;
+	}
+
+	/// Writes benchmark output to @a _file, or stdout for "-". Exits on failure.
+	static void writeBenchmarkOutput(string const& _file, std::function<void(ostream&)> const& _write)
+	{
+		if (_file == "-")
+		{
+			_write(cout);
+			return;
+		}
+		ofstream out(_file);
+		_write(out);
+		if (!out)
+		{
+			cerr << "Could not write benchmark output to " << _file << endl;
+			exit(1);
+		}
+	}
+
 	void doBenchmark(MinerType _m, unsigned _warmupDuration = 15, unsigned _trialDuration = 3, unsigned _trials = 5)
 	{
 		BlockHeader genesis;
@@ -734,20 +1226,25 @@ private:
 
 		Farm f;
 		f.set_pool_addresses(m_farmURL, m_port, m_farmFailOverURL, m_fport);
+		f.setHwmonInterval(m_hwmonInterval);
 		map<string, Farm::SealerDescriptor> sealers;
 #if ETH_ETHASHCL
 		sealers["opencl"] = Farm::SealerDescriptor{&CLMiner::instances, [](FarmFace& _farm, unsigned _index){ return new CLMiner(_farm, _index); }};
 #endif
+#if ETH_ETHASHOCL
+		sealers["fpga"] = Farm::SealerDescriptor{ &OCLMiner::instances, [](FarmFace& _farm, unsigned _index) { return new OCLMiner(_farm, _index); } };
+#endif
 #if ETH_ETHASHCUDA
 		sealers["cuda"] = Farm::SealerDescriptor{ &CUDAMiner::instances, [](FarmFace& _farm, unsigned _index){ return new CUDAMiner(_farm, _index); } };
 #endif
+		sealers["sim"] = Farm::SealerDescriptor{ &SimMiner::instances, [](FarmFace& _farm, unsigned _index){ return new SimMiner(_farm, _index); } };
 		f.setSealers(sealers);
 		f.onSolutionFound([&](Solution) { return false; });
 
-		string platformInfo = _m == MinerType::CL ? "CL" : "CUDA";
-		cout << "Benchmarking on platform: " << platformInfo << endl;
+		string platformInfo = _m == MinerType::CL ? "CL" : _m == MinerType::CUDA ? "CUDA" : _m == MinerType::Fpga ? "FPGA" : _m == MinerType::Sim ? "simulated" : "CUDA+CL";
+		benchmarkLog() << "Benchmarking on platform: " << platformInfo << endl;
 
-		cout << "Preparing DAG for block #" << m_benchmarkBlock << endl;
+		benchmarkLog() << "Preparing DAG for block #" << m_benchmarkBlock << endl;
 		//genesis.prep();
 
 		genesis.setDifficulty(u256(1) << 63);
@@ -755,36 +1252,93 @@ private:
 			f.start("opencl", false);
 		else if (_m == MinerType::CUDA)
 			f.start("cuda", false);
-		f.setWork(WorkPackage{genesis});
+		else if (_m == MinerType::Fpga)
+			f.start("fpga", false);
+		else if (_m == MinerType::Sim)
+			f.start("sim", false);
+		else if (_m == MinerType::Mixed) {
+			f.start("cuda", false);
+			f.start("opencl", true);
+		}
 
-		map<uint64_t, WorkingProgress> results;
-		uint64_t mean = 0;
-		uint64_t innerMean = 0;
-		for (unsigned i = 0; i <= _trials; ++i)
+		if (!m_benchmarkSweep.empty())
 		{
-			if (!i)
-				cout << "Warming up..." << endl;
-			else
-				cout << "Trial " << i << "... " << flush;
-			this_thread::sleep_for(chrono::seconds(i ? _trialDuration : _warmupDuration));
+			vector<EpochBenchmark> sweep;
+			for (unsigned epoch: m_benchmarkSweep)
+			{
+				EpochBenchmark e;
+				e.epoch = epoch;
+				e.dagBytes = EthashAux::dataSize(epoch * ETHASH_EPOCH_LENGTH);
+				benchmarkLog() << "Epoch " << epoch << ", DAG " << e.dagBytes / (1024 * 1024) << " MB" << endl;
+
+				genesis.setNumber(epoch * ETHASH_EPOCH_LENGTH);
+				runBenchmark(f, genesis, _warmupDuration, _trialDuration, _trials, e.total, e.devices);
+				// Keep at most one epoch's light cache around, a sweep can visit hundreds.
+				EthashAux::releaseLight(WorkPackage{genesis}.seed);
+				sweep.push_back(e);
+			}
+			f.stop();
 
-			auto mp = f.miningProgress();
-			if (!i)
-				continue;
-			auto rate = mp.rate();
+			// With the miners stopped, so the CPU path is measured alone.
+			for (EpochBenchmark& e: sweep)
+			{
+				genesis.setNumber(e.epoch * ETHASH_EPOCH_LENGTH);
+				e.devices.push_back(benchmarkLightEvaluation(WorkPackage{genesis}, _trialDuration));
+				benchmarkLog() << "Epoch " << e.epoch << " CPU light evaluation: " << (uint64_t)e.devices.back().trials.front() << " H/s" << endl;
+			}
 
-			cout << rate << endl;
-			results[rate] = mp;
-			mean += rate;
+			if (!m_benchmarkJson.empty())
+				writeBenchmarkOutput(m_benchmarkJson, [&](ostream& _out) { _out << Json::StyledWriter().write(benchmarkSweepJson(_warmupDuration, _trialDuration, sweep)); });
+			if (!m_benchmarkCsv.empty())
+				writeBenchmarkOutput(m_benchmarkCsv, [&](ostream& _out) { benchmarkSweepCsv(_out, sweep); });
+			exit(0);
 		}
+
+		vector<double> total;
+		vector<DeviceBenchmark> devices;
+		runBenchmark(f, genesis, _warmupDuration, _trialDuration, _trials, total, devices);
 		f.stop();
-		int j = -1;
-		for (auto const& r: results)
-			if (++j > 0 && j < (int)_trials - 1)
-				innerMean += r.second.rate();
-		innerMean /= (_trials - 2);
-		cout << "min/mean/max: " << results.begin()->second.rate() << "/" << (mean / _trials) << "/" << results.rbegin()->second.rate() << " H/s" << endl;
-		cout << "inner mean: " << innerMean << " H/s" << endl;
+
+		if (!total.empty())
+		{
+			vector<double> sorted = total;
+			sort(sorted.begin(), sorted.end());
+			double mean = 0;
+			for (double r: sorted)
+				mean += r;
+			mean /= sorted.size();
+			benchmarkLog() << "min/mean/max: " << (uint64_t)sorted.front() << "/" << (uint64_t)mean << "/" << (uint64_t)sorted.back() << " H/s" << endl;
+			if (sorted.size() > 2)
+			{
+				double innerMean = 0;
+				for (size_t j = 1; j + 1 < sorted.size(); ++j)
+					innerMean += sorted[j];
+				innerMean /= sorted.size() - 2;
+				benchmarkLog() << "inner mean: " << (uint64_t)innerMean << " H/s" << endl;
+			}
+		}
+
+		Json::Value report = benchmarkJson(m_benchmarkBlock, _warmupDuration, _trialDuration, total, devices);
+		if (!m_benchmarkJson.empty())
+			writeBenchmarkOutput(m_benchmarkJson, [&](ostream& _out) { _out << Json::StyledWriter().write(report); });
+
+		if (!m_benchmarkBaseline.empty())
+		{
+			ifstream in(m_benchmarkBaseline);
+			Json::Value baseline;
+			Json::Reader reader;
+			if (!in || !reader.parse(in, baseline))
+			{
+				cerr << "Could not read benchmark baseline " << m_benchmarkBaseline << endl;
+				exit(1);
+			}
+			unsigned regressions = compareBenchmarks(report, baseline, m_benchmarkThreshold, benchmarkLog());
+			if (regressions)
+			{
+				benchmarkLog() << regressions << " regression(s) beyond " << m_benchmarkThreshold << "%" << endl;
+				exit(1);
+			}
+		}
 
 		exit(0);
 	}
@@ -798,6 +1352,7 @@ private:
 
 		Farm f;
 		f.set_pool_addresses(m_farmURL, m_port, m_farmFailOverURL, m_fport);
+		f.setHwmonInterval(m_hwmonInterval);
 		map<string, Farm::SealerDescriptor> sealers;
 #if ETH_ETHASHCL
 		sealers["opencl"] = Farm::SealerDescriptor{ &CLMiner::instances, [](FarmFace& _farm, unsigned _index){ return new CLMiner(_farm, _index); } };
@@ -805,9 +1360,10 @@ private:
 #if ETH_ETHASHCUDA
 		sealers["cuda"] = Farm::SealerDescriptor{ &CUDAMiner::instances, [](FarmFace& _farm, unsigned _index){ return new CUDAMiner(_farm, _index); } };
 #endif
+		sealers["sim"] = Farm::SealerDescriptor{ &SimMiner::instances, [](FarmFace& _farm, unsigned _index){ return new SimMiner(_farm, _index); } };
 		f.setSealers(sealers);
 
-		string platformInfo = _m == MinerType::CL ? "CL" : "CUDA";
+		string platformInfo = _m == MinerType::CL ? "CL" : _m == MinerType::Sim ? "simulated" : "CUDA";
 		cout << "Running mining simulation on platform: " << platformInfo << endl;
 
 		cout << "Preparing DAG for block #" << m_benchmarkBlock << endl;
@@ -819,6 +1375,8 @@ private:
 			f.start("opencl", false);
 		else if (_m == MinerType::CUDA)
 			f.start("cuda", false);
+		else if (_m == MinerType::Sim)
+			f.start("sim", false);
 
 		int time = 0;
 
@@ -867,6 +1425,145 @@ private:
 		}
 	}
 
+	/**
+	 * @brief Mines a deterministic stream of jobs arriving at random intervals and measures what
+	 * job switches cost: stale shares, hashes done on replaced jobs and how late stale shares arrive.
+	 */
+	void doStaleSimulation(MinerType _m)
+	{
+		BlockHeader genesis;
+		genesis.setNumber(m_benchmarkBlock);
+		genesis.setDifficulty(u256(1) << m_staleDifficulty);
+
+		Farm f;
+		f.set_pool_addresses(m_farmURL, m_port, m_farmFailOverURL, m_fport);
+		f.setHwmonInterval(m_hwmonInterval);
+		map<string, Farm::SealerDescriptor> sealers;
+#if ETH_ETHASHCL
+		sealers["opencl"] = Farm::SealerDescriptor{ &CLMiner::instances, [](FarmFace& _farm, unsigned _index){ return new CLMiner(_farm, _index); } };
+#endif
+#if ETH_ETHASHCUDA
+		sealers["cuda"] = Farm::SealerDescriptor{ &CUDAMiner::instances, [](FarmFace& _farm, unsigned _index){ return new CUDAMiner(_farm, _index); } };
+#endif
+		sealers["sim"] = Farm::SealerDescriptor{ &SimMiner::instances, [](FarmFace& _farm, unsigned _index){ return new SimMiner(_farm, _index); } };
+		f.setSealers(sealers);
+
+		uint64_t batch = 0;
+		if (_m == MinerType::Sim)
+		{
+			// Simulated devices find shares at the rate the job's difficulty implies, valid at --sim-difficulty.
+			SimMiner::settings().poolDifficulty = true;
+			batch = (uint64_t)(m_simSettings.hashrate * m_simSettings.kernelMs / 1000);
+		}
+#if ETH_ETHASHCL
+		else if (_m == MinerType::CL)
+			batch = (uint64_t)m_globalWorkSizeMultiplier * m_localWorkSize;
+#endif
+#if ETH_ETHASHCUDA
+		else if (_m == MinerType::CUDA)
+			batch = (uint64_t)m_cudaGridSize * m_cudaBlockSize;
+#endif
+
+		StaleRun run;
+		h256 currentHeader;
+		map<h256, chrono::steady_clock::time_point> replaced;
+		std::mutex x_run;
+		f.onSolutionFound([&](Solution const& _s)
+		{
+			auto now = chrono::steady_clock::now();
+			bool valid = _m == MinerType::Sim || EthashAux::eval(_s.work.seed, _s.work.header, _s.nonce).value < _s.work.boundary;
+			Guard l(x_run);
+			++run.shares;
+			if (!valid)
+				++run.invalid;
+			if (_s.found != chrono::steady_clock::time_point())
+				run.submit.push_back(chrono::duration<double>(now - _s.found).count());
+			if (_s.work.header != currentHeader && replaced.count(_s.work.header))
+			{
+				++run.stale;
+				run.lag.push_back(chrono::duration<double>(now - replaced[_s.work.header]).count());
+			}
+		});
+
+		if (_m == MinerType::CL)
+			f.start("opencl", false);
+		else if (_m == MinerType::CUDA)
+			f.start("cuda", false);
+		else if (_m == MinerType::Sim)
+			f.start("sim", false);
+		auto miners = f.miners();
+
+		cout << "Preparing DAG for block #" << m_benchmarkBlock << endl;
+		vector<uint64_t> lastHashes(miners.size());
+		for (size_t d = 0; d < miners.size(); ++d)
+			lastHashes[d] = miners[d]->metrics().hashes.value();
+		f.setWork(WorkPackage{genesis});
+		for (unsigned waited = 0; waited < 600 * 10; ++waited)
+		{
+			bool ready = true;
+			for (size_t d = 0; d < miners.size(); ++d)
+				ready = ready && miners[d]->metrics().hashes.value() != lastHashes[d];
+			if (ready)
+				break;
+			this_thread::sleep_for(chrono::milliseconds(100));
+		}
+
+		vector<StaleRun> runs;
+		for (double interval: m_staleIntervals)
+		{
+			cout << "Mean job interval " << interval << "s for " << m_staleDuration << "s..." << endl;
+			JobStream jobs(m_staleSeed, interval);
+			{
+				Guard l(x_run);
+				run = StaleRun();
+				run.batch = batch;
+				run.interval = interval;
+				replaced.clear();
+			}
+
+			vector<double> switchSums(miners.size());
+			for (size_t d = 0; d < miners.size(); ++d)
+			{
+				lastHashes[d] = miners[d]->metrics().hashes.value();
+				switchSums[d] = miners[d]->metrics().workSwitch.sum();
+			}
+
+			auto start = chrono::steady_clock::now();
+			auto end = start + chrono::seconds(m_staleDuration);
+			for (auto now = start; now < end; now = chrono::steady_clock::now())
+			{
+				WorkPackage wp{genesis};
+				wp.header = jobs.nextHeader();
+				{
+					Guard l(x_run);
+					if (currentHeader)
+						replaced[currentHeader] = now;
+					currentHeader = wp.header;
+					++run.jobs;
+				}
+				f.setWork(wp);
+				auto next = now + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(jobs.nextInterval()));
+				this_thread::sleep_until(min(next, end));
+			}
+
+			Guard l(x_run);
+			run.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+			for (size_t d = 0; d < miners.size(); ++d)
+			{
+				// Until a device switches it keeps hashing the replaced job at its average rate.
+				double hashes = miners[d]->metrics().hashes.value() - lastHashes[d];
+				run.hashes += hashes;
+				run.wastedHashes += hashes / run.seconds * (miners[d]->metrics().workSwitch.sum() - switchSums[d]);
+			}
+			runs.push_back(run);
+		}
+
+		staleSimulationTable(cout, runs);
+		if (!m_staleCsv.empty())
+			writeBenchmarkOutput(m_staleCsv, [&](ostream& _out) { staleSimulationCsv(_out, runs); });
+		exit(0);
+	}
+
 	void doFarm(MinerType _m, string & _remote, unsigned _recheckPeriod)
 	{
 		map<string, Farm::SealerDescriptor> sealers;
@@ -880,6 +1577,7 @@ private:
 #if ETH_ETHASHCUDA
 		sealers["cuda"] = Farm::SealerDescriptor{ &CUDAMiner::instances, [](FarmFace& _farm, unsigned _index) { return new CUDAMiner(_farm, _index); } };
 #endif
+		sealers["sim"] = Farm::SealerDescriptor{ &SimMiner::instances, [](FarmFace& _farm, unsigned _index){ return new SimMiner(_farm, _index); } };
 		(void)_m;
 		(void)_remote;
 		(void)_recheckPeriod;
@@ -893,9 +1591,17 @@ private:
 		h256 id = h256::random();
 		Farm f;
 		f.set_pool_addresses(m_farmURL, m_port, m_farmFailOverURL, m_fport);
+		f.setHwmonInterval(m_hwmonInterval);
+		f.setDagPregeneration(m_dagPregenBlocks);
 
 #if API_CORE
 		Api api(this->m_api_port, f);
+		std::unique_ptr<MetricsServer> metrics;
+		if (m_metrics_port > 0)
+			metrics.reset(new MetricsServer(m_metrics_port));
+		std::unique_ptr<EventServer> events;
+		if (m_events_port > 0)
+			events.reset(new EventServer(m_events_port));
 #endif
 
 		f.setSealers(sealers);
@@ -906,6 +1612,8 @@ private:
 			f.start("cuda", false);
 		} else if (_m == MinerType::Fpga) {
 			f.start("fpga", false);
+		} else if (_m == MinerType::Sim) {
+			f.start("sim", false);
 		} else if (_m == MinerType::Mixed) {
 			f.start("cuda", false);
 			f.start("opencl", true);
@@ -959,6 +1667,8 @@ private:
 						current.header = hh;
 						current.seed = newSeedHash;
 						current.boundary = h256(fromHex(v[2].asString()), h256::AlignRight);
+						// Newer nodes add the block number as a fourth element.
+						current.height = v[3].isString() ? strtoull(v[3].asString().c_str(), nullptr, 16) : 0;
 						minelog << "Got work package: #" + current.header.hex().substr(0,8);
 						f.setWork(current);
 						x_current.unlock();
@@ -972,7 +1682,7 @@ private:
 					cnote << "  headerHash:" << solution.work.header.hex();
 					cnote << "  mixHash:" << solution.mixHash.hex();
 					cnote << EthLime << " Accepted." << EthReset;
-					f.acceptedSolution(solution.stale);
+					f.acceptedSolution(solution, _remote);
 				}
 				else {
 					cwarn << "Solution found; Submitted to" << _remote;
@@ -980,7 +1690,7 @@ private:
 					cwarn << "  headerHash:" << solution.work.header.hex();
 					cwarn << "  mixHash:" << solution.mixHash.hex();
 					cwarn << EthYellow << " Rejected." << EthReset;
-					f.rejectedSolution(solution.stale);
+					f.rejectedSolution(solution, _remote);
 				}
 			}
 			catch (jsonrpc::JsonRpcException&)
@@ -1032,14 +1742,23 @@ private:
 #if ETH_ETHASHCUDA
 		sealers["cuda"] = Farm::SealerDescriptor{ &CUDAMiner::instances, [](FarmFace& _farm, unsigned _index){ return new CUDAMiner(_farm, _index); } };
 #endif
+		sealers["sim"] = Farm::SealerDescriptor{ &SimMiner::instances, [](FarmFace& _farm, unsigned _index){ return new SimMiner(_farm, _index); } };
 		if (!m_farmRecheckSet)
 			m_farmRecheckPeriod = m_defaultStratumFarmRecheckPeriod;
 
 		Farm f;
 		f.set_pool_addresses(m_farmURL, m_port, m_farmFailOverURL, m_fport);
+		f.setHwmonInterval(m_hwmonInterval);
+		f.setDagPregeneration(m_dagPregenBlocks);
 
 #if API_CORE
 		Api api(this->m_api_port, f);
+		std::unique_ptr<MetricsServer> metrics;
+		if (m_metrics_port > 0)
+			metrics.reset(new MetricsServer(m_metrics_port));
+		std::unique_ptr<EventServer> events;
+		if (m_events_port > 0)
+			events.reset(new EventServer(m_events_port));
 #endif
 		// this is very ugly, but if Stratum Client V2 tunrs out to be a success, V1 will be completely removed anyway
 		if (m_stratumClientVersion == 1) {
@@ -1171,6 +1890,10 @@ private:
 	unsigned m_openclDeviceCount = 0;
 	unsigned m_openclDevices[16];
 	unsigned m_openclThreadsPerHash = 8;
+	bool m_openclProfiling = false;
+#if defined(__linux)
+	std::string m_sysfsRoot;
+#endif
 	unsigned m_globalWorkSizeMultiplier = CLMiner::c_defaultGlobalWorkSizeMultiplier;
 	unsigned m_localWorkSize = CLMiner::c_defaultLocalWorkSize;
 #endif
@@ -1184,22 +1907,46 @@ private:
 #endif
 	unsigned m_dagLoadMode = 0; // parallel
 	unsigned m_dagCreateDevice = 0;
+	unsigned m_dagConcurrency = 0;
+	unsigned m_dagPregenBlocks = 0;
+	unsigned m_dagCheckInterval = 0;
+	HealthPolicy m_healthPolicy;
+	unsigned m_healthStall = 60;
 	/// Benchmarking params
 	unsigned m_benchmarkWarmup = 15;
 	unsigned m_parallelHash    = 4;
 	unsigned m_benchmarkTrial = 3;
 	unsigned m_benchmarkTrials = 5;
 	unsigned m_benchmarkBlock = 0;
+	string m_benchmarkJson;
+	string m_benchmarkCsv;
+	vector<unsigned> m_benchmarkSweep;
+	string m_benchmarkBaseline;
+	double m_benchmarkThreshold = 5;
 	/// Farm params
 	unsigned m_farmRetries = 0;
 	unsigned m_maxFarmRetries = 3;
 	unsigned m_farmRecheckPeriod = 2000;
+	unsigned m_ioThreads = 1;
 	unsigned m_defaultStratumFarmRecheckPeriod = 2000;
 	bool m_farmRecheckSet = false;
 	int m_worktimeout = 180;
 	bool m_show_hwmonitors = false;
+	unsigned m_hwmonInterval = 1000;
+	unsigned m_thermalTarget = 0;
+	bool m_thermalSimulation = false;
+	vector<double> m_staleIntervals;
+	unsigned m_staleDuration = 60;
+	unsigned m_staleDifficulty = 26;
+	uint64_t m_staleSeed = 1;
+	string m_staleCsv;
+	unsigned m_simDevices = 1;
+	SimSettings m_simSettings;
+	string m_traceFile;
 #if API_CORE
 	int m_api_port = 0;
+	int m_metrics_port = 0;
+	int m_events_port = 0;
 #endif
 	bool m_report_stratum_hashrate = false;
 	int m_stratumClientVersion = 1;
@@ -0,0 +1,113 @@
+/// Stale share simulation against a synthetic job stream.
+///
+/// @file
+/// @copyright GNU General Public License
+
+#pragma once
+
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <libdevcore/FixedHash.h>
+
+/**
+ * @brief Jobs arriving as a Poisson process: exponentially distributed intervals and random headers.
+ * The same seed always produces the same stream, so runs with different batch sizes see identical jobs.
+ */
+class JobStream
+{
+public:
+	JobStream(uint64_t _seed, double _meanInterval): m_rng(_seed), m_interval(1 / _meanInterval) {}
+
+	/// @returns the seconds until the next job.
+	double nextInterval() { return m_interval(m_rng); }
+
+	dev::h256 nextHeader()
+	{
+		dev::h256 ret;
+		for (unsigned i = 0; i < dev::h256::size; ++i)
+			ret[i] = (uint8_t)m_rng();
+		return ret;
+	}
+
+private:
+	std::mt19937_64 m_rng;
+	std::exponential_distribution<double> m_interval;
+};
+
+/// Results of one job interval.
+struct StaleRun
+{
+	uint64_t batch = 0;			///< Hashes per kernel launch of one device.
+	double interval = 0;		///< Mean seconds between jobs.
+	double seconds = 0;
+	unsigned jobs = 0;
+	unsigned shares = 0;
+	unsigned stale = 0;			///< Shares for a job that was already replaced when they arrived.
+	unsigned invalid = 0;
+	double hashes = 0;
+	double wastedHashes = 0;	///< Hashes done on a replaced job before the devices switched.
+	std::vector<double> lag;	///< Seconds from a job being replaced to each of its stale shares arriving.
+	std::vector<double> submit;	///< Seconds from a device reporting each share to it reaching the farm.
+};
+
+/// Parses a comma separated list of positive job intervals in seconds, e.g. "0.5,2,10".
+/// @throws std::invalid_argument on malformed input.
+inline std::vector<double> parseIntervals(std::string const& _spec)
+{
+	std::vector<double> ret;
+	std::string::size_type pos = 0;
+	while (pos <= _spec.size())
+	{
+		std::string::size_type end = _spec.find(',', pos);
+		double interval = std::stod(_spec.substr(pos, end == std::string::npos ? std::string::npos : end - pos));
+		if (interval <= 0)
+			throw std::invalid_argument(_spec);
+		ret.push_back(interval);
+		if (end == std::string::npos)
+			break;
+		pos = end + 1;
+	}
+	return ret;
+}
+
+inline double stalePercentile(std::vector<double> _samples, double _p)
+{
+	if (_samples.empty())
+		return 0;
+	std::sort(_samples.begin(), _samples.end());
+	return _samples[std::min(_samples.size() - 1, (size_t)(_p / 100 * _samples.size()))];
+}
+
+inline void staleSimulationTable(std::ostream& _out, std::vector<StaleRun> const& _runs)
+{
+	std::ios::fmtflags flags = _out.flags();
+	std::streamsize precision = _out.precision();
+	_out << std::left << std::setw(12) << "batch" << std::right << std::setw(10) << "interval" << std::setw(8) << "jobs"
+		 << std::setw(8) << "shares" << std::setw(8) << "stale" << std::setw(9) << "stale %" << std::setw(10) << "wasted %"
+		 << std::setw(12) << "lag p50 ms" << std::setw(12) << "lag p99 ms" << std::setw(15) << "submit p99 ms" << std::endl;
+	for (auto const& r: _runs)
+		_out << std::left << std::setw(12) << r.batch << std::right << std::fixed << std::setprecision(2) << std::setw(10) << r.interval
+			 << std::setw(8) << r.jobs << std::setw(8) << r.shares << std::setw(8) << r.stale
+			 << std::setw(9) << (r.shares ? 100.0 * r.stale / r.shares : 0)
+			 << std::setw(10) << (r.hashes > 0 ? 100 * r.wastedHashes / r.hashes : 0)
+			 << std::setprecision(1) << std::setw(12) << stalePercentile(r.lag, 50) * 1000 << std::setw(12) << stalePercentile(r.lag, 99) * 1000
+			 << std::setw(15) << stalePercentile(r.submit, 99) * 1000 << std::endl;
+	_out.flags(flags);
+	_out.precision(precision);
+}
+
+/// Writes one row per job interval, for joining runs with different batch sizes.
+inline void staleSimulationCsv(std::ostream& _out, std::vector<StaleRun> const& _runs)
+{
+	_out << "batch,interval,seconds,jobs,shares,stale,invalid,stale_ratio,hashes,wasted_hashes,lag_p50,lag_p99,submit_p50,submit_p99\n";
+	for (auto const& r: _runs)
+		_out << r.batch << "," << r.interval << "," << r.seconds << "," << r.jobs << "," << r.shares << "," << r.stale << "," << r.invalid << ","
+			 << (r.shares ? (double)r.stale / r.shares : 0) << "," << r.hashes << "," << r.wastedHashes << ","
+			 << stalePercentile(r.lag, 50) << "," << stalePercentile(r.lag, 99) << ","
+			 << stalePercentile(r.submit, 50) << "," << stalePercentile(r.submit, 99) << "\n";
+}
@@ -0,0 +1,172 @@
+/// Benchmarks of the Farm control plane with many simulated miners.
+///
+/// @file
+/// @copyright GNU General Public License
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <libethcore/Farm.h>
+#include <libethcore/SimMiner.h>
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+namespace
+{
+
+/// One control-plane operation driven by its own thread.
+struct Operation
+{
+	string name;
+	double rate;				///< Calls per second, 0 for as fast as possible.
+	function<void()> body;
+	vector<double> latencies;	///< Seconds per call.
+};
+
+/**
+ * @brief Calls @a _op.body at its rate until @a _stop is set, recording the latency of every call.
+ * Rate limited operations are scheduled on a fixed grid, so a slow call is not hidden by sleeping less afterwards.
+ */
+void drive(Operation& _op, atomic<bool> const& _stop)
+{
+	auto next = chrono::steady_clock::now();
+	auto interval = chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(_op.rate > 0 ? 1 / _op.rate : 0));
+	while (!_stop)
+	{
+		if (_op.rate > 0)
+		{
+			this_thread::sleep_until(next);
+			next += interval;
+		}
+		auto start = chrono::steady_clock::now();
+		_op.body();
+		_op.latencies.push_back(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+	}
+}
+
+double percentile(vector<double> const& _sorted, double _p)
+{
+	if (_sorted.empty())
+		return 0;
+	size_t i = min(_sorted.size() - 1, (size_t)(_p / 100 * _sorted.size()));
+	return _sorted[i];
+}
+
+void report(Operation& _op, double _seconds)
+{
+	sort(_op.latencies.begin(), _op.latencies.end());
+	auto us = [&](double _p) { return percentile(_op.latencies, _p) * 1e6; };
+	cout << left << setw(20) << _op.name << right << setw(10) << _op.latencies.size()
+		 << setw(12) << fixed << setprecision(0) << _op.latencies.size() / _seconds
+		 << setprecision(1) << setw(10) << us(50) << setw(10) << us(90) << setw(10) << us(99) << setw(10) << us(99.9)
+		 << setw(12) << (_op.latencies.empty() ? 0 : _op.latencies.back() * 1e6) << endl;
+}
+
+WorkPackage job(unsigned _i)
+{
+	WorkPackage ret;
+	ret.header = h256::random();
+	ret.seed = EthashAux::seedHash(0);
+	ret.boundary = h256(u256(1) << 224);
+	ret.startNonce = _i;
+	return ret;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	unsigned miners = 64;
+	double seconds = 10;
+	double jobRate = 10;
+	double collectRate = 0;
+	double progressRate = 0;
+	double submitRate = 0;
+	unsigned progressThreads = 2;
+	for (int i = 1; i < argc; ++i)
+	{
+		string arg = argv[i];
+		if (arg == "--miners" && i + 1 < argc)
+			miners = stoul(argv[++i]);
+		else if (arg == "--duration" && i + 1 < argc)
+			seconds = stod(argv[++i]);
+		else if (arg == "--jobs-per-sec" && i + 1 < argc)
+			jobRate = stod(argv[++i]);
+		else if (arg == "--collect-rate" && i + 1 < argc)
+			collectRate = stod(argv[++i]);
+		else if (arg == "--progress-rate" && i + 1 < argc)
+			progressRate = stod(argv[++i]);
+		else if (arg == "--progress-threads" && i + 1 < argc)
+			progressThreads = stoul(argv[++i]);
+		else if (arg == "--submit-rate" && i + 1 < argc)
+			submitRate = stod(argv[++i]);
+		else if (arg == "--kernel-ms" && i + 1 < argc)
+			SimMiner::settings().kernelMs = stoul(argv[++i]);
+		else
+		{
+			cout << "Usage: farm-bench [options]" << endl
+				 << "Drives Farm::setWork, collectHashRate, miningProgress(true) and submitProof concurrently" << endl
+				 << "with simulated miners and reports the throughput and latency of each. Rates of 0 call as fast as possible." << endl
+				 << "    --miners <n>  Number of simulated miners (default: 64)." << endl
+				 << "    --duration <seconds>  Length of the run (default: 10)." << endl
+				 << "    --jobs-per-sec <n>  Rate of setWork calls (default: 10)." << endl
+				 << "    --collect-rate <n>  Rate of collectHashRate calls (default: 0)." << endl
+				 << "    --progress-rate <n>  Rate of miningProgress(true) calls of each thread (default: 0)." << endl
+				 << "    --progress-threads <n>  Threads polling miningProgress, like API clients (default: 2)." << endl
+				 << "    --submit-rate <n>  Rate of submitProof calls (default: 0)." << endl
+				 << "    --kernel-ms <n>  Batch duration of the simulated miners (default: 50)." << endl;
+			return arg == "-h" || arg == "--help" ? 0 : 1;
+		}
+	}
+
+	// Solutions are submitted by the benchmark itself, the simulated miners only hash.
+	SimMiner::setNumInstances(miners);
+	SimMiner::settings().solutionRate = 0;
+
+	Farm f;
+	f.setHwmonInterval(0);
+	f.setSealers({{"sim", Farm::SealerDescriptor{ &SimMiner::instances, [](FarmFace& _farm, unsigned _index){ return new SimMiner(_farm, _index); } }}});
+	atomic<uint64_t> solutions = {0};
+	f.onSolutionFound([&](Solution const&) { ++solutions; });
+	f.start("sim", false);
+	f.setWork(job(0));
+
+	unsigned jobs = 0;
+	vector<Operation> ops;
+	ops.push_back(Operation{"setWork", jobRate, [&]() { f.setWork(job(++jobs)); }, {}});
+	ops.push_back(Operation{"collectHashRate", collectRate, [&]() { f.collectHashRate(); }, {}});
+	for (unsigned i = 0; i < progressThreads; ++i)
+		ops.push_back(Operation{"miningProgress/" + toString(i), progressRate, [&]() { WorkingProgress p = f.miningProgress(true); (void)p; }, {}});
+	FarmFace& face = f;
+	Solution solution{0, h256(), job(0), false, 0, std::chrono::steady_clock::time_point()};
+	ops.push_back(Operation{"submitProof", submitRate, [&]() { face.submitProof(solution); }, {}});
+	for (auto& op: ops)
+		op.latencies.reserve(1 << 20);
+
+	cout << "Running " << ops.size() << " operations against " << miners << " simulated miners for " << seconds << "s" << endl;
+	atomic<bool> stop = {false};
+	vector<thread> threads;
+	auto start = chrono::steady_clock::now();
+	for (auto& op: ops)
+		threads.push_back(thread([&op, &stop]() { drive(op, stop); }));
+	this_thread::sleep_for(chrono::duration<double>(seconds));
+	stop = true;
+	for (auto& t: threads)
+		t.join();
+	double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	cout << left << setw(20) << "operation" << right << setw(10) << "calls" << setw(12) << "calls/s"
+		 << setw(10) << "p50 us" << setw(10) << "p90 us" << setw(10) << "p99 us" << setw(10) << "p99.9 us" << setw(12) << "max us" << endl;
+	for (auto& op: ops)
+		report(op, elapsed);
+	cout << solutions << " solutions handled" << endl;
+	return 0;
+}
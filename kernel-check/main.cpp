@@ -0,0 +1,427 @@
+/// Regression harness of the OpenCL kernels against golden vectors on a small test epoch.
+///
+/// @file
+/// @copyright GNU General Public License
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <libdevcore/CommonData.h>
+#include <libdevcore/SHA3.h>
+#include <libethash/internal.h>
+#include <libethash-cl/CLMiner.h>
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+namespace
+{
+
+/// The test epoch: a 64 KiB cache from the epoch 0 seed and a 4 MiB DAG.
+uint64_t const c_testCacheSize = 64 * 1024;
+uint64_t const c_testFullSize = 4 * 1024 * 1024;
+char const* const c_testDagHash = "98703ddd4c4473cf0a47de68da7085a8f9cc437534f74dd30c6c1bae00230484";
+
+/// Nonces searched per vector, one per work item.
+unsigned const c_batch = 65536;
+unsigned const c_maxOutputs = 63;
+
+/// A search of c_batch nonces from startNonce and the offsets of all nonces meeting the target.
+struct Vector
+{
+	char const* header;
+	uint64_t startNonce;
+	uint64_t target;			///< Upper 64 bits of the boundary, as passed to the search kernel.
+	vector<uint32_t> found;
+};
+
+/// Computed with the host implementation over the full test DAG.
+vector<Vector> const c_vectors = {
+	{"2ff7235bdcd7cf25b370b5c62563458c68ec43e52a3f560665dbc8f05089279c", 0, 0x000fffffffffffffULL,
+		{20027, 20223, 23260, 28038, 28761, 29520, 45587, 49366, 52172, 53602, 64858}},
+	{"e0f405ed13b3be9a8b5549d594f85a81bafd20b47a8d1a0d385273e77d996570", 0x123456789abcdef0ULL, 0x0007ffffffffffffULL,
+		{62301, 62586, 62900}},
+	{"958da310619c0c59755156627cb76a7ae8f8a80ff43250b6d021e5e208477a96", 0xfffffffffffe8000ULL, 0x001fffffffffffffULL,
+		{1326, 10053, 17586, 17689, 25486, 26049, 26616, 26878, 29935, 31664, 31828, 36872, 37850, 38267, 41991, 45109,
+		 47278, 48483, 51839, 52189, 55270, 56407, 56825, 57811, 61778, 62604}},
+};
+
+struct LightDeleter
+{
+	void operator()(ethash_light* _l) const { ethash_light_delete(_l); }
+};
+using LightPtr = std::unique_ptr<ethash_light, LightDeleter>;
+
+uint64_t upper64(ethash_h256_t const& _h)
+{
+	uint64_t ret = 0;
+	for (unsigned i = 0; i < 8; ++i)
+		ret = ret << 8 | _h.b[i];
+	return ret;
+}
+
+/**
+ * @brief Recomputes the golden vectors with the host implementation, so a vector can not rot unnoticed:
+ * builds the test DAG, checks its hash, and searches every nonce of each vector for a complete list.
+ */
+bool checkVectors(ethash_light_t _light)
+{
+	vector<node> dag(c_testFullSize / sizeof(node));
+	for (uint32_t i = 0; i < dag.size(); ++i)
+		ethash_calculate_dag_item(&dag[i], i, _light);
+	if (sha3(bytesConstRef((byte const*)dag.data(), c_testFullSize)).hex() != c_testDagHash)
+	{
+		cerr << "FAILED host DAG: its hash is not " << c_testDagHash << endl;
+		return false;
+	}
+
+	bool ok = true;
+	for (auto const& v: c_vectors)
+	{
+		ethash_h256_t header;
+		memcpy(header.b, h256(v.header).data(), 32);
+		vector<uint32_t> found;
+		for (uint32_t offset = 0; offset < c_batch; ++offset)
+			if (upper64(ethash_full_compute_internal(dag.data(), c_testFullSize, header, v.startNonce + offset).result) < v.target)
+				found.push_back(offset);
+		if (found != v.found)
+		{
+			cerr << "FAILED host vector " << v.header << ": the host finds " << found.size() << " nonces, the vector lists " << v.found.size() << endl;
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+struct Variant
+{
+	string name;
+	string source;
+	unsigned threadsPerHash;	///< Non-zero if the kernel ignores THREADS_PER_HASH and always uses this value.
+};
+
+/// One kernel build and its results.
+struct Run
+{
+	string error;				///< Empty if all vectors passed.
+	double hashrate = 0;		///< On the test epoch, whose DAG fits in the caches.
+};
+
+string errorText(cl::Error const& _e)
+{
+	return string(_e.what()) + " (" + toString(_e.err()) + ")";
+}
+
+int platformId(string const& _name)
+{
+	if (_name == "NVIDIA CUDA")
+		return OPENCL_PLATFORM_NVIDIA;
+	if (_name == "AMD Accelerated Parallel Processing")
+		return OPENCL_PLATFORM_AMD;
+	if (_name == "Clover")
+		return OPENCL_PLATFORM_CLOVER;
+	return OPENCL_PLATFORM_UNKNOWN;
+}
+
+/**
+ * @brief Builds @a _variant with @a _groupSize and @a _threadsPerHash, generates the test DAG with
+ * it and runs every vector; then measures the hashrate for @a _minSeconds.
+ */
+Run check(cl::Context const& _context, cl::Device const& _device, cl::CommandQueue& _queue, cl::Buffer const& _light, Variant const& _variant, int _platform, unsigned _groupSize, unsigned _threadsPerHash, double _minSeconds)
+{
+	Run ret;
+	string code = _variant.source;
+	CLMiner::addDefinition(code, "GROUP_SIZE", _groupSize);
+	CLMiner::addDefinition(code, "DAG_SIZE", (unsigned)(c_testFullSize / ETHASH_MIX_BYTES));
+	CLMiner::addDefinition(code, "LIGHT_SIZE", (unsigned)(c_testCacheSize / sizeof(node)));
+	CLMiner::addDefinition(code, "ACCESSES", ETHASH_ACCESSES);
+	CLMiner::addDefinition(code, "MAX_OUTPUTS", c_maxOutputs);
+	CLMiner::addDefinition(code, "PLATFORM", _platform);
+	CLMiner::addDefinition(code, "COMPUTE", 0);
+	CLMiner::addDefinition(code, "THREADS_PER_HASH", _threadsPerHash);
+
+	cl::Program::Sources sources{{code.data(), code.size()}};
+	cl::Program program(_context, sources);
+	try
+	{
+		program.build({_device});
+	}
+	catch (cl::Error const& _e)
+	{
+		string log = program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(_device);
+		ret.error = "build failed: " + errorText(_e) + "\n" + log;
+		return ret;
+	}
+
+	try
+	{
+		// The DAG is generated by the variant's own kernel, in one pass of exactly its nodes.
+		cl::Buffer dag(_context, CL_MEM_READ_WRITE, c_testFullSize);
+		cl::Kernel dagKernel(program, "ethash_calculate_dag_item");
+		dagKernel.setArg(0, 0u);
+		dagKernel.setArg(1, _light);
+		dagKernel.setArg(2, dag);
+		dagKernel.setArg(3, ~0u);
+		_queue.enqueueNDRangeKernel(dagKernel, cl::NullRange, c_testFullSize / sizeof(node), _groupSize);
+		bytes dagData(c_testFullSize);
+		_queue.enqueueReadBuffer(dag, CL_TRUE, 0, dagData.size(), dagData.data());
+		if (sha3(dagData).hex() != c_testDagHash)
+		{
+			ret.error = "DAG mismatch";
+			return ret;
+		}
+
+		cl::Buffer header(_context, CL_MEM_READ_ONLY, 32);
+		cl::Buffer output(_context, CL_MEM_WRITE_ONLY, (c_maxOutputs + 1) * sizeof(uint32_t));
+		cl::Kernel search(program, "ethash_search");
+		search.setArg(0, output);
+		search.setArg(1, header);
+		search.setArg(2, dag);
+		search.setArg(5, ~0u);
+
+		uint32_t const zero = 0;
+		for (auto const& v: c_vectors)
+		{
+			_queue.enqueueWriteBuffer(header, CL_TRUE, 0, 32, h256(v.header).data());
+			_queue.enqueueWriteBuffer(output, CL_FALSE, 0, sizeof(zero), &zero);
+			search.setArg(3, v.startNonce);
+			search.setArg(4, v.target);
+			_queue.enqueueNDRangeKernel(search, cl::NullRange, c_batch, _groupSize);
+			uint32_t results[c_maxOutputs + 1];
+			_queue.enqueueReadBuffer(output, CL_TRUE, 0, sizeof(results), results);
+
+			vector<uint32_t> found(results + 1, results + 1 + min(results[0], c_maxOutputs));
+			sort(found.begin(), found.end());
+			if (results[0] != v.found.size() || found != v.found)
+			{
+				ostringstream out;
+				out << "vector " << string(v.header).substr(0, 8) << ": found " << results[0] << " nonces, expected " << v.found.size();
+				for (uint32_t offset: v.found)
+					if (!binary_search(found.begin(), found.end(), offset))
+						out << ", missed " << v.startNonce + offset;
+				for (uint32_t offset: found)
+					if (!binary_search(v.found.begin(), v.found.end(), offset))
+						out << ", wrong " << v.startNonce + offset;
+				ret.error = out.str();
+				return ret;
+			}
+		}
+
+		// A target of 0 finds nothing, the output is left alone.
+		search.setArg(4, (uint64_t)0);
+		_queue.enqueueNDRangeKernel(search, cl::NullRange, c_batch, _groupSize);
+		_queue.finish();
+		uint64_t hashes = 0;
+		auto start = chrono::steady_clock::now();
+		double seconds = 0;
+		while (seconds < _minSeconds)
+		{
+			search.setArg(3, hashes);
+			_queue.enqueueNDRangeKernel(search, cl::NullRange, c_batch, _groupSize);
+			_queue.finish();
+			hashes += c_batch;
+			seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		}
+		ret.hashrate = hashes / seconds;
+	}
+	catch (cl::Error const& _e)
+	{
+		ret.error = errorText(_e);
+	}
+	return ret;
+}
+
+vector<unsigned> parseList(string const& _list)
+{
+	vector<unsigned> ret;
+	istringstream in(_list);
+	string item;
+	while (getline(in, item, ','))
+		ret.push_back(stoul(item));
+	return ret;
+}
+
+bool readFile(string const& _file, string& o_contents)
+{
+	ifstream in(_file);
+	if (!in.good())
+		return false;
+	o_contents.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+	return true;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	int platformFilter = -1;
+	int deviceFilter = -1;
+	vector<string> kernelFiles;
+	vector<unsigned> groupSizes = {64, 128, 256};
+	vector<unsigned> threadsPerHash = {1, 2, 4, 8};
+	double minSeconds = 0.5;
+	bool checkOnly = false;
+	try
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			string arg = argv[i];
+			if (arg == "--platform" && i + 1 < argc)
+				platformFilter = stoi(argv[++i]);
+			else if (arg == "--device" && i + 1 < argc)
+				deviceFilter = stoi(argv[++i]);
+			else if (arg == "--kernel" && i + 1 < argc)
+				kernelFiles.push_back(argv[++i]);
+			else if (arg == "--group-sizes" && i + 1 < argc)
+				groupSizes = parseList(argv[++i]);
+			else if (arg == "--threads-per-hash" && i + 1 < argc)
+				threadsPerHash = parseList(argv[++i]);
+			else if (arg == "--min-time" && i + 1 < argc)
+				minSeconds = stod(argv[++i]);
+			else if (arg == "--check")
+				checkOnly = true;
+			else if (arg == "-h" || arg == "--help")
+			{
+				cout << "Usage: kernel-check [options]" << endl
+					 << "Runs the stable, unstable and custom OpenCL kernels against golden vectors on a small test epoch." << endl
+					 << "    --platform <n>  Only check the devices of platform n (default: all)." << endl
+					 << "    --device <n>  Only check device n of each platform (default: all)." << endl
+					 << "    --kernel <file>  Check this custom kernel; may be repeated (default: <device>.cl or kernel.cl, as the miner)." << endl
+					 << "    --group-sizes <list>  GROUP_SIZE values to build with (default: 64,128,256)." << endl
+					 << "    --threads-per-hash <list>  THREADS_PER_HASH values to build with (default: 1,2,4,8). The stable kernel always uses 8." << endl
+					 << "    --min-time <seconds>  Duration of each hashrate measurement (default: 0.5)." << endl
+					 << "    --check  Only verify the vectors on the host, searching all their nonces over the full test DAG." << endl;
+				return 0;
+			}
+			else
+			{
+				cerr << "Invalid argument: " << arg << endl;
+				return 2;
+			}
+		}
+	}
+	catch (...)
+	{
+		cerr << "Bad option value" << endl;
+		return 2;
+	}
+
+	ethash_h256_t seed;
+	memset(&seed, 0, sizeof(seed));
+	LightPtr light(ethash_light_new_internal(c_testCacheSize, &seed));
+	if (!checkVectors(light.get()))
+		return 1;
+	cout << "Host vectors OK" << endl;
+	if (checkOnly)
+		return 0;
+
+	vector<cl::Platform> platforms;
+	try
+	{
+		cl::Platform::get(&platforms);
+	}
+	catch (cl::Error const& _e)
+	{
+		cerr << "No OpenCL platforms: " << errorText(_e) << endl;
+		return 1;
+	}
+
+	unsigned runs = 0;
+	unsigned passed = 0;
+	bool failed = false;
+	for (unsigned p = 0; p < platforms.size(); ++p)
+	{
+		if (platformFilter >= 0 && (unsigned)platformFilter != p)
+			continue;
+		string platformName = platforms[p].getInfo<CL_PLATFORM_NAME>();
+		vector<cl::Device> devices;
+		try
+		{
+			platforms[p].getDevices(CL_DEVICE_TYPE_ALL, &devices);
+		}
+		catch (cl::Error const&)
+		{
+			continue;
+		}
+		for (unsigned d = 0; d < devices.size(); ++d)
+		{
+			if (deviceFilter >= 0 && (unsigned)deviceFilter != d)
+				continue;
+			cl::Device& device = devices[d];
+			string deviceName = device.getInfo<CL_DEVICE_NAME>();
+			cout << endl << "[" << p << ":" << d << "] " << platformName << " / " << deviceName << endl;
+
+			vector<Variant> variants = {
+				{"stable", CLMiner::kernelSource(CLKernelName::Stable, deviceName), 8},
+				{"unstable", CLMiner::kernelSource(CLKernelName::Unstable, deviceName), 0},
+			};
+			vector<string> files = kernelFiles;
+			if (files.empty() && !CLMiner::customKernelFile(deviceName).empty())
+				files.push_back(CLMiner::customKernelFile(deviceName));
+			for (string const& file: files)
+			{
+				Variant v{file, string(), 0};
+				if (!readFile(file, v.source))
+				{
+					cerr << "Can not read " << file << endl;
+					return 1;
+				}
+				variants.push_back(v);
+			}
+
+			try
+			{
+				cl::Context context(vector<cl::Device>(&device, &device + 1));
+				cl::CommandQueue queue(context, device);
+				cl::Buffer lightBuffer(context, CL_MEM_READ_ONLY, c_testCacheSize);
+				queue.enqueueWriteBuffer(lightBuffer, CL_TRUE, 0, c_testCacheSize, light->cache);
+				size_t maxGroupSize = device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>();
+
+				cout << left << setw(24) << "kernel" << right << setw(8) << "group" << setw(8) << "tph" << setw(14) << "MH/s" << "  result" << endl;
+				for (auto const& v: variants)
+					for (unsigned g: groupSizes)
+					{
+						if (g > maxGroupSize)
+						{
+							cout << left << setw(24) << v.name << right << setw(8) << g << setw(8) << "-" << setw(14) << "-" << "  skipped, above the device's " << maxGroupSize << endl;
+							continue;
+						}
+						// Built once with the value the kernel forces, rather than once per ignored value.
+						for (unsigned t: v.threadsPerHash ? vector<unsigned>{v.threadsPerHash} : threadsPerHash)
+						{
+							Run r = check(context, device, queue, lightBuffer, v, platformId(platformName), g, t, minSeconds);
+							++runs;
+							if (r.error.empty())
+								++passed;
+							else
+								failed = true;
+							cout << left << setw(24) << v.name << right << setw(8) << g << setw(8) << t << setw(14) << fixed << setprecision(3) << r.hashrate / 1e6
+								 << "  " << (r.error.empty() ? "ok" : "FAILED " + r.error) << endl;
+						}
+					}
+			}
+			catch (cl::Error const& _e)
+			{
+				cerr << "FAILED to set up the device: " << errorText(_e) << endl;
+				failed = true;
+			}
+		}
+	}
+
+	if (!runs && !failed)
+	{
+		cerr << "No OpenCL devices checked" << endl;
+		return 1;
+	}
+	cout << endl << passed << " of " << runs << " kernel builds passed" << endl;
+	cout << "Hashrates are measured on the test epoch, whose DAG fits in the caches: compare them between variants only." << endl;
+	return failed ? 1 : 0;
+}
@@ -1,9 +1,26 @@
 #include "ApiServer.h"
 #include "BuildInfo.h"
 
+namespace
+{
+
+Json::Value toJson(ShareTally const& _t)
+{
+	Json::Value ret;
+	ret["accepted"] = _t.accepted;
+	ret["rejected"] = _t.rejected;
+	ret["accepted_stale"] = _t.acceptedStale;
+	ret["rejected_stale"] = _t.rejectedStale;
+	return ret;
+}
+
+}
+
 ApiServer::ApiServer(AbstractServerConnector *conn, serverVersion_t type, Farm &farm, bool &readonly) : AbstractServer(*conn, type), m_farm(farm)
 {
 	this->bindAndAddMethod(Procedure("miner_getstat1", PARAMS_BY_NAME, JSON_OBJECT, NULL), &ApiServer::getMinerStat1);
+	this->bindAndAddMethod(Procedure("miner_getdevices", PARAMS_BY_NAME, JSON_ARRAY, NULL), &ApiServer::getMinerDevices);
+	this->bindAndAddMethod(Procedure("miner_getpools", PARAMS_BY_NAME, JSON_ARRAY, NULL), &ApiServer::getMinerPools);
 	if (!readonly) {
 		this->bindAndAddMethod(Procedure("miner_restart", PARAMS_BY_NAME, JSON_OBJECT, NULL), &ApiServer::doMinerRestart);
 		this->bindAndAddMethod(Procedure("miner_reboot", PARAMS_BY_NAME, JSON_OBJECT, NULL), &ApiServer::doMinerReboot);
@@ -61,6 +78,71 @@ void ApiServer::getMinerStat1(const Json::Value& request, Json::Value& response)
 	response[8] = invalidStats.str();            // number of ETH invalid shares, number of ETH pool switches, number of DCR invalid shares, number of DCR pool switches.
 }
 
+void ApiServer::getMinerDevices(const Json::Value& request, Json::Value& response)
+{
+	(void) request; // unused
+
+	WorkingProgress p = m_farm.miningProgress(true);
+	auto miners = m_farm.miners();
+
+	response = Json::Value(Json::arrayValue);
+	for (size_t i = 0; i < p.minersHashes.size(); ++i)
+	{
+		uint64_t rate = p.minerRate(p.minersHashes[i]);
+		Json::Value device;
+		device["name"] = p.minersNames[i];
+		device["hashrate"] = Json::UInt64(rate);              // hashes per second
+		if (i < p.minersCeilings.size() && p.minersCeilings[i] > 0)
+		{
+			device["ceiling"] = p.minersCeilings[i];            // hashes per second the memory bandwidth allows
+			device["ceiling_fraction"] = rate / p.minersCeilings[i];
+		}
+		if (i < p.minerMonitors.size())
+		{
+			HwMonitor const& hw = p.minerMonitors[i];
+			device["temperature"] = hw.tempC;                 // Celsius
+			device["fan"] = hw.fanP;                          // percent
+			device["power"] = hw.powerW;                      // watts, 0 if not reported
+			device["core_clock"] = hw.coreMHz;                // MHz, 0 if not reported
+			device["memory_clock"] = hw.memMHz;               // MHz, 0 if not reported
+			device["efficiency"] = hashesPerJoule(rate, hw);  // hashes per joule, 0 if the power is unknown
+		}
+		if (i < miners.size())
+		{
+			DeviceHealth h = miners[i]->health();
+			Json::Value health;
+			health["state"] = toString(h.state());           // healthy, throttled or quarantined
+			health["intensity"] = h.intensity();              // fraction of full intensity allowed
+			health["recent_faults"] = h.recent();             // faults within the policy window
+			for (unsigned f = 0; f < DeviceHealth::FaultKinds; ++f)
+				health[toString((DeviceHealth::Fault)f)] = h.count((DeviceHealth::Fault)f);
+			device["health"] = health;
+
+			ShareTally t = m_farm.shareStats().device(miners[i]->Index());
+			device["shares"] = toJson(t);
+			EffectiveHashrate e = m_farm.shareStats().effective(miners[i]->Index());
+			device["effective_hashrate"] = e.effective;           // hashes per second, from accepted share difficulty
+			device["effective_hashrate_low"] = e.low;             // 99% confidence interval
+			device["effective_hashrate_high"] = e.high;
+			device["diverging"] = e.diverging;                    // mean reported rate outside the interval
+		}
+		response.append(device);
+	}
+}
+
+void ApiServer::getMinerPools(const Json::Value& request, Json::Value& response)
+{
+	(void) request; // unused
+
+	response = Json::Value(Json::arrayValue);
+	for (auto const& i: m_farm.shareStats().pools())
+	{
+		Json::Value pool = toJson(i.second);
+		pool["pool"] = i.first;
+		response.append(pool);
+	}
+}
+
 void ApiServer::doMinerRestart(const Json::Value& request, Json::Value& response)
 {
 	(void) request; // unused
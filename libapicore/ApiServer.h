@@ -17,6 +17,8 @@ public:
 private:
 	Farm &m_farm;
 	void getMinerStat1(const Json::Value& request, Json::Value& response);
+	void getMinerDevices(const Json::Value& request, Json::Value& response);
+	void getMinerPools(const Json::Value& request, Json::Value& response);
 	void doMinerRestart(const Json::Value& request, Json::Value& response);
 	void doMinerReboot(const Json::Value& request, Json::Value& response);
 };
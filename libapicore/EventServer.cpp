@@ -0,0 +1,120 @@
+#include "EventServer.h"
+#include <boost/bind.hpp>
+#include <libdevcore/Log.h>
+
+using boost::asio::ip::tcp;
+
+struct EventServer::Session
+{
+	Session(boost::asio::io_service& io_service): socket(io_service) {}
+
+	tcp::socket socket;
+	std::deque<std::string> queue;
+	char discard[256];
+	bool closed = false;
+};
+
+EventServer::EventServer(int port):
+	m_acceptor(m_io_service, tcp::endpoint(tcp::v4(), port))
+{
+	m_strand.post([this]() { accept(); });
+	cnote << "Streaming events on port" << port;
+}
+
+EventServer::~EventServer()
+{
+	EventLoop::get().run(m_strand, [this]() {
+		boost::system::error_code ignored;
+		m_acceptor.close(ignored);
+		auto sessions = m_sessions;
+		for (auto const& session : sessions)
+			close(session);
+	});
+	EventLoop::get().drain(m_strand);
+}
+
+void EventServer::accept()
+{
+	auto session = std::make_shared<Session>(m_io_service);
+	m_acceptor.async_accept(session->socket,
+		m_strand.wrap(boost::bind(&EventServer::handleAccept, this, session, boost::asio::placeholders::error)));
+}
+
+void EventServer::handleAccept(std::shared_ptr<Session> session, const boost::system::error_code& ec)
+{
+	if (ec == boost::asio::error::operation_aborted)
+		return;
+	if (!ec)
+	{
+		m_sessions.insert(session);
+		if (!m_subscription)
+			m_subscription = EventHub::get().subscribe([this](std::string const& line) {
+				m_strand.post(boost::bind(&EventServer::broadcast, this, line));
+			});
+		readClient(session);
+	}
+	accept();
+}
+
+void EventServer::readClient(std::shared_ptr<Session> session)
+{
+	// Clients are not expected to send anything, reading only detects disconnects.
+	session->socket.async_read_some(boost::asio::buffer(session->discard),
+		m_strand.wrap([this, session](const boost::system::error_code& ec, std::size_t) {
+			if (ec)
+				close(session);
+			else
+				readClient(session);
+		}));
+}
+
+void EventServer::broadcast(std::string const& line)
+{
+	std::vector<std::shared_ptr<Session>> slow;
+	for (auto const& session : m_sessions)
+	{
+		if (session->queue.size() >= c_maxQueuedLines)
+		{
+			slow.push_back(session);
+			continue;
+		}
+		session->queue.push_back(line);
+		if (session->queue.size() == 1)
+			write(session);
+	}
+	for (auto const& session : slow)
+	{
+		cnote << "Dropping slow event client";
+		close(session);
+	}
+}
+
+void EventServer::write(std::shared_ptr<Session> session)
+{
+	boost::asio::async_write(session->socket, boost::asio::buffer(session->queue.front()),
+		m_strand.wrap([this, session](const boost::system::error_code& ec, std::size_t) {
+			if (ec || session->closed)
+			{
+				close(session);
+				return;
+			}
+			session->queue.pop_front();
+			if (!session->queue.empty())
+				write(session);
+		}));
+}
+
+void EventServer::close(std::shared_ptr<Session> session)
+{
+	if (session->closed)
+		return;
+	session->closed = true;
+	boost::system::error_code ignored;
+	session->socket.close(ignored);
+	m_sessions.erase(session);
+	if (m_sessions.empty() && m_subscription)
+	{
+		EventHub::get().unsubscribe(m_subscription);
+		m_subscription = 0;
+	}
+}
@@ -0,0 +1,46 @@
+#ifndef _EVENTSERVER_H_
+#define _EVENTSERVER_H_
+
+#include <deque>
+#include <memory>
+#include <set>
+#include <boost/asio.hpp>
+#include <libdevcore/EventLoop.h>
+#include <libethcore/EventHub.h>
+
+using namespace dev;
+using namespace dev::eth;
+
+/**
+ * @brief Streams EventHub events to TCP clients, one JSON object per line.
+ * The server only subscribes to the hub while at least one client is connected, and clients
+ * that fall too far behind are disconnected instead of buffering without bound.
+ */
+class EventServer
+{
+public:
+	EventServer(int port);
+	~EventServer();
+private:
+	struct Session;
+
+	/// Lines queued for a client before it is considered too slow and dropped.
+	static const size_t c_maxQueuedLines = 1024;
+
+	void accept();
+	void handleAccept(std::shared_ptr<Session> session, const boost::system::error_code& ec);
+	void readClient(std::shared_ptr<Session> session);
+	void broadcast(std::string const& line);
+	void write(std::shared_ptr<Session> session);
+	void close(std::shared_ptr<Session> session);
+
+	boost::asio::io_service& m_io_service = EventLoop::get().service();
+	boost::asio::io_service::strand m_strand{m_io_service};
+	boost::asio::ip::tcp::acceptor m_acceptor;
+
+	// Only accessed on the strand.
+	std::set<std::shared_ptr<Session>> m_sessions;
+	unsigned m_subscription = 0;
+};
+
+#endif //_EVENTSERVER_H_
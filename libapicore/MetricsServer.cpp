@@ -0,0 +1,133 @@
+#include "MetricsServer.h"
+#include <boost/bind.hpp>
+
+using boost::asio::ip::tcp;
+
+namespace
+{
+
+// Largest request header accepted. A scrape sends a few hundred bytes.
+size_t const c_maxRequest = 8 * 1024;
+
+// Time a connection gets to send its request and read the reply.
+boost::posix_time::seconds const c_sessionTimeout(10);
+
+}
+
+struct MetricsServer::Session
+{
+	Session(boost::asio::io_service& io_service): socket(io_service), request(c_maxRequest), timer(io_service) {}
+
+	tcp::socket socket;
+	boost::asio::streambuf request;
+	std::string reply;
+	boost::asio::deadline_timer timer;
+};
+
+MetricsServer::MetricsServer(int port):
+	m_acceptor(m_io_service, tcp::endpoint(tcp::v4(), port))
+{
+	m_strand.post([this]() { accept(); });
+	cnote << "Serving metrics on http://0.0.0.0:" << port << "/metrics";
+}
+
+MetricsServer::~MetricsServer()
+{
+	EventLoop::get().run(m_strand, [this]() {
+		boost::system::error_code ignored;
+		m_acceptor.close(ignored);
+		for (auto const& session : m_sessions)
+		{
+			session->timer.cancel(ignored);
+			session->socket.close(ignored);
+		}
+	});
+	EventLoop::get().drain(m_strand);
+}
+
+void MetricsServer::accept()
+{
+	auto session = std::make_shared<Session>(m_io_service);
+	m_acceptor.async_accept(session->socket,
+		m_strand.wrap(boost::bind(&MetricsServer::handleAccept, this, session, boost::asio::placeholders::error)));
+}
+
+void MetricsServer::handleAccept(std::shared_ptr<Session> session, const boost::system::error_code& ec)
+{
+	if (ec == boost::asio::error::operation_aborted)
+		return;
+	if (!ec)
+	{
+		m_sessions.insert(session);
+		// Closing the socket aborts the pending read or write, whose handler ends the session.
+		session->timer.expires_from_now(c_sessionTimeout);
+		session->timer.async_wait(m_strand.wrap([session](const boost::system::error_code& ec) {
+			if (ec == boost::asio::error::operation_aborted)
+				return;
+			boost::system::error_code ignored;
+			session->socket.close(ignored);
+		}));
+		boost::asio::async_read_until(session->socket, session->request, "\r\n\r\n",
+			m_strand.wrap(boost::bind(&MetricsServer::handleRequest, this, session, boost::asio::placeholders::error)));
+	}
+	accept();
+}
+
+void MetricsServer::handleRequest(std::shared_ptr<Session> session, const boost::system::error_code& ec)
+{
+	if (ec)
+	{
+		// Also reached once the request outgrows c_maxRequest, with error::not_found.
+		boost::system::error_code ignored;
+		session->timer.cancel(ignored);
+		session->socket.close(ignored);
+		m_sessions.erase(session);
+		return;
+	}
+
+	std::istream is(&session->request);
+	std::string requestLine;
+	std::getline(is, requestLine);
+	session->reply = response(requestLine);
+
+	boost::asio::async_write(session->socket, boost::asio::buffer(session->reply),
+		m_strand.wrap([this, session](const boost::system::error_code&, std::size_t) {
+			boost::system::error_code ignored;
+			session->timer.cancel(ignored);
+			session->socket.shutdown(tcp::socket::shutdown_both, ignored);
+			m_sessions.erase(session);
+		}));
+}
+
+std::string MetricsServer::response(std::string const& requestLine)
+{
+	std::istringstream ss(requestLine);
+	std::string method, target;
+	ss >> method >> target;
+
+	std::string status = "200 OK";
+	std::string contentType = "text/plain; version=0.0.4; charset=utf-8";
+	std::string body;
+	if (method != "GET")
+	{
+		status = "405 Method Not Allowed";
+		contentType = "text/plain";
+	}
+	else if (target != "/metrics")
+	{
+		status = "404 Not Found";
+		contentType = "text/plain";
+	}
+	else
+	{
+		body = MetricsRegistry::get().exposition();
+	}
+
+	std::ostringstream os;
+	os << "HTTP/1.0 " << status << "\r\n"
+	   << "Content-Type: " << contentType << "\r\n"
+	   << "Content-Length: " << body.size() << "\r\n"
+	   << "Connection: close\r\n\r\n"
+	   << body;
+	return os.str();
+}
@@ -0,0 +1,39 @@
+#ifndef _METRICSSERVER_H_
+#define _METRICSSERVER_H_
+
+#include <memory>
+#include <set>
+#include <boost/asio.hpp>
+#include <libdevcore/EventLoop.h>
+#include <libdevcore/Log.h>
+#include <libdevcore/Metrics.h>
+
+using namespace dev;
+
+/**
+ * @brief Minimal HTTP server answering GET /metrics with the Prometheus text exposition
+ * of MetricsRegistry. Each connection serves a single request and is then closed, as is a
+ * connection that has not been answered within a few seconds.
+ */
+class MetricsServer
+{
+public:
+	explicit MetricsServer(int port);
+	~MetricsServer();
+private:
+	struct Session;
+
+	void accept();
+	void handleAccept(std::shared_ptr<Session> session, const boost::system::error_code& ec);
+	void handleRequest(std::shared_ptr<Session> session, const boost::system::error_code& ec);
+	std::string response(std::string const& requestLine);
+
+	boost::asio::io_service& m_io_service = EventLoop::get().service();
+	boost::asio::io_service::strand m_strand{m_io_service};
+	boost::asio::ip::tcp::acceptor m_acceptor;
+
+	// Only accessed on the strand.
+	std::set<std::shared_ptr<Session>> m_sessions;
+};
+
+#endif //_METRICSSERVER_H_
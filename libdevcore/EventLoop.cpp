@@ -0,0 +1,96 @@
+/// Process wide asio event loop for timers and network I/O.
+///
+/// @file
+/// @copyright GNU General Public License
+
+#include "EventLoop.h"
+
+#include <algorithm>
+#include <cassert>
+#include <future>
+#include "Log.h"
+
+using namespace std;
+using namespace dev;
+
+namespace
+{
+
+thread_local bool t_loopThread = false;
+
+}
+
+unsigned EventLoop::s_threads = 1;
+
+EventLoop& EventLoop::get()
+{
+	static EventLoop* s_loop = new EventLoop(s_threads);
+	return *s_loop;
+}
+
+EventLoop::EventLoop(unsigned _threads):
+	m_work(m_service)
+{
+	_threads = max(1u, _threads);
+	for (unsigned i = 0; i < _threads; ++i)
+		m_threads.emplace_back([this, i]()
+		{
+			t_loopThread = true;
+			setThreadName(("io" + to_string(i)).c_str());
+			while (true)
+			{
+				try
+				{
+					m_service.run();
+					return;
+				}
+				catch (std::exception const& _e)
+				{
+					clog(WarnChannel) << "Exception thrown in event loop:" << _e.what();
+				}
+			}
+		});
+}
+
+bool EventLoop::isLoopThread() const
+{
+	return t_loopThread;
+}
+
+void EventLoop::run(boost::asio::io_service::strand& _strand, function<void()> const& _f)
+{
+	// Already serialised with the strand: inline, as waiting for the strand would wait for itself.
+	// A single loop thread can not wait for the loop either, and runs one handler at a time anyway.
+	if (_strand.running_in_this_thread() || (isLoopThread() && threads() == 1))
+	{
+		_f();
+		return;
+	}
+	promise<void> done;
+	// Posting to the service, not the strand, queues behind completions that are already pending,
+	// such as those of timers cancelled just before.
+	m_service.post(_strand.wrap([&]()
+	{
+		try
+		{
+			_f();
+			done.set_value();
+		}
+		catch (...)
+		{
+			done.set_exception(current_exception());
+		}
+	}));
+	done.get_future().get();
+}
+
+void EventLoop::drain(boost::asio::io_service::strand& _strand)
+{
+	assert(!isLoopThread());
+	if (isLoopThread())
+	{
+		clog(WarnChannel) << "Component destroyed on an event loop thread, its pending handlers may outlive it";
+		return;
+	}
+	run(_strand, []() {});
+}
@@ -0,0 +1,69 @@
+/// Process wide asio event loop for timers and network I/O.
+///
+/// @file
+/// @copyright GNU General Public License
+
+#pragma once
+
+#include <functional>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+
+namespace dev
+{
+
+/**
+ * @brief One io_service shared by every component that is not a miner: farm timers, the stratum
+ * client and the metrics and event servers.
+ * Each component serialises its handlers on its own strand, so with more than one loop thread
+ * components run in parallel while each still sees its handlers in order. With the default single
+ * thread all handlers run in the order they became ready.
+ * Handlers must never block; use a timer instead of sleeping.
+ */
+class EventLoop
+{
+public:
+	/// The loop, started on first use. It is never destroyed, so handlers can still be queued at exit.
+	static EventLoop& get();
+
+	/// Sets the number of threads running the loop. Only effective before the first get().
+	static void setThreads(unsigned _threads) { s_threads = _threads; }
+
+	boost::asio::io_service& service() { return m_service; }
+
+	unsigned threads() const { return (unsigned)m_threads.size(); }
+
+	/// @returns true if called from one of the loop threads.
+	bool isLoopThread() const;
+
+	/**
+	 * @brief Runs @a _f on @a _strand after the handlers already queued and waits for it.
+	 * Use it to touch a component's handler state from outside the loop, e.g. to cancel its timers
+	 * before destroying it. Called from a handler of @a _strand, or from the only loop thread, @a _f
+	 * runs immediately instead. From another loop thread it is posted to the strand and waited for,
+	 * which needs a second loop thread free to run it. Waits between strands must not form a cycle:
+	 * the stratum client waits for the farm's strand, so the farm's handlers never wait, they
+	 * dispatch to the stratum client.
+	 */
+	void run(boost::asio::io_service::strand& _strand, std::function<void()> const& _f);
+
+	/**
+	 * @brief Waits until the handlers already queued on @a _strand ran. A destructor that cancelled
+	 * its timers and closed its sockets calls it last, so the aborted handlers run while the
+	 * component still exists. Components are therefore never destroyed on a loop thread, which
+	 * could not wait for them.
+	 */
+	void drain(boost::asio::io_service::strand& _strand);
+
+private:
+	explicit EventLoop(unsigned _threads);
+
+	static unsigned s_threads;
+
+	boost::asio::io_service m_service;
+	boost::asio::io_service::work m_work;
+	std::vector<std::thread> m_threads;
+};
+
+}
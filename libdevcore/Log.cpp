@@ -21,6 +21,8 @@
 
 #include "Log.h"
 
+#include <atomic>
+#include <condition_variable>
 #include <thread>
 #ifdef __APPLE__
 #include <pthread.h>
@@ -33,12 +35,6 @@ using namespace dev;
 
 // Logging
 int dev::g_logVerbosity = 5;
-mutex x_logOverride;
-
-/// Map of Log Channel types to bool, false forces the channel to be disabled, true forces it to be enabled.
-/// If a channel has no entry, then it will output as long as its verbosity (LogChannel::verbosity) is less than
-/// or equal to the currently output verbosity (g_logVerbosity).
-static map<type_info const*, bool> s_logOverride;
 
 #ifdef _WIN32
 const char* LogChannel::name() { return EthGray "..."; }
@@ -56,23 +52,33 @@ const char* NoteChannel::name() { return EthBlue "  ℹ"; }
 const char* DebugChannel::name() { return EthWhite "  ◇"; }
 #endif
 
-LogOutputStreamBase::LogOutputStreamBase(char const* _id, std::type_info const* _info, unsigned _v, bool _autospacing):
+LogOutputStreamBase::LogOutputStreamBase(char const* _id, unsigned _v, bool _autospacing):
 	m_autospacing(_autospacing),
 	m_verbosity(_v)
 {
-	Guard l(x_logOverride);
-	auto it = s_logOverride.find(_info);
-	if ((it != s_logOverride.end() && it->second) || (it == s_logOverride.end() && (int)_v <= g_logVerbosity))
+	if ((int)_v <= g_logVerbosity)
 	{
+		// The formatted time only changes once a second, cache it per thread.
+		thread_local time_t t_lastTime = 0;
+		thread_local char t_timeBuf[24] = {0};
 		time_t rawTime = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-		char buf[24];
-		if (strftime(buf, 24, "%X", localtime(&rawTime)) == 0)
-			buf[0] = '\0'; // empty if case strftime fails
+		if (rawTime != t_lastTime)
+		{
+			t_lastTime = rawTime;
+			struct tm local;
+#ifdef _WIN32
+			localtime_s(&local, &rawTime);
+#else
+			localtime_r(&rawTime, &local);
+#endif
+			if (strftime(t_timeBuf, 24, "%X", &local) == 0)
+				t_timeBuf[0] = '\0'; // empty if case strftime fails
+		}
 		static char const* c_begin = "  " EthViolet;
 		static char const* c_sep1 = EthReset EthBlack "|" EthNavy;
 		static char const* c_sep2 = EthReset EthBlack "|" EthTeal;
 		static char const* c_end = EthReset "  ";
-		m_sstr << _id << c_begin << buf << c_sep1 << std::left << std::setw(8) << getThreadName() << ThreadContext::join(c_sep2) << c_end;
+		m_sstr << _id << c_begin << t_timeBuf << c_sep1 << std::left << std::setw(8) << getThreadName() << ThreadContext::join(c_sep2) << c_end;
 	}
 }
 
@@ -130,16 +136,22 @@ string dev::ThreadContext::join(string const& _prior)
 	return g_logThreadContext.join(_prior);
 }
 
+/// Thread name as last set or queried, so that logging does not query the OS per line.
+thread_local static std::string t_threadName;
+
 string dev::getThreadName()
 {
+	if (!t_threadName.empty())
+		return t_threadName;
 #if defined(__linux__) || defined(__APPLE__)
 	char buffer[128];
 	pthread_getname_np(pthread_self(), buffer, 127);
 	buffer[127] = 0;
-	return buffer;
+	t_threadName = buffer;
 #else
-	return ThreadLocalLogName::name ? ThreadLocalLogName::name : "<unknown>";
+	t_threadName = ThreadLocalLogName::name ? ThreadLocalLogName::name : "<unknown>";
 #endif
+	return t_threadName;
 }
 
 void dev::setThreadName(char const* _n)
@@ -151,9 +163,130 @@ void dev::setThreadName(char const* _n)
 #else
 	ThreadLocalLogName::name = _n;
 #endif
+	t_threadName = _n;
+}
+
+namespace
+{
+
+/**
+ * @brief Writes log lines to stderr from a background thread.
+ * Logging threads only move the line into the pending queue; the writer swaps the queue out
+ * and writes it in one go. Pending lines are flushed when the writer is destroyed at exit.
+ */
+class LogWriter
+{
+public:
+	/// Lines kept in memory while stderr is slow, further lines are dropped and counted.
+	static const size_t c_maxPending = 10000;
+
+	LogWriter()
+	{
+		m_thread = thread([this]() { run(); });
+	}
+
+	~LogWriter()
+	{
+		{
+			Guard l(x_pending);
+			m_stop = true;
+		}
+		m_signal.notify_one();
+		m_thread.join();
+		s_destroyed = true;
+	}
+
+	void post(string&& _line)
+	{
+		{
+			Guard l(x_pending);
+			if (m_pending.size() >= c_maxPending)
+			{
+				++m_dropped;
+				return;
+			}
+			m_pending.push_back(move(_line));
+		}
+		m_signal.notify_one();
+	}
+
+	/// Set once the writer has been destroyed at exit; later lines are written synchronously.
+	static atomic<bool> s_destroyed;
+
+private:
+	void run()
+	{
+		setThreadName("log");
+		vector<string> lines;
+		string out;
+		while (true)
+		{
+			unsigned dropped = 0;
+			bool stop;
+			{
+				unique_lock<mutex> l(x_pending);
+				m_signal.wait(l, [&]() { return m_stop || !m_pending.empty(); });
+				lines.swap(m_pending);
+				swap(dropped, m_dropped);
+				stop = m_stop;
+			}
+			out.clear();
+			for (auto const& line: lines)
+				out += line;
+			if (dropped)
+				out += "  " + toString(dropped) + " log lines dropped\n";
+			lines.clear();
+			cerr << out << flush;
+			if (stop)
+				break;
+		}
+	}
+
+	mutex x_pending;
+	condition_variable m_signal;
+	vector<string> m_pending;
+	unsigned m_dropped = 0;
+	bool m_stop = false;
+	thread m_thread;
+};
+
+atomic<bool> LogWriter::s_destroyed = {false};
+
+LogWriter& logWriter()
+{
+	static LogWriter s_writer;
+	return s_writer;
+}
+
 }
 
 void dev::simpleDebugOut(std::string const& _s)
 {
-        std::cerr << _s + '\n';
+	if (LogWriter::s_destroyed)
+		std::cerr << _s + '\n';
+	else
+		logWriter().post(_s + '\n');
+}
+
+LogRateLimiter::LogRateLimiter(unsigned _burst, unsigned _periodMs):
+	m_burst(_burst),
+	m_periodMs(_periodMs)
+{}
+
+bool LogRateLimiter::allow()
+{
+	uint64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	uint64_t start = m_windowStart.load(std::memory_order_relaxed);
+	if (now - start >= m_periodMs && m_windowStart.compare_exchange_strong(start, now))
+		m_count = 0;
+	if (m_count.fetch_add(1, std::memory_order_relaxed) < m_burst)
+		return true;
+	m_suppressed.fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
+
+string LogRateLimiter::suppressed()
+{
+	unsigned n = m_suppressed.exchange(0, std::memory_order_relaxed);
+	return n ? "(" + toString(n) + " similar suppressed)" : string();
 }
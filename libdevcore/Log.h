@@ -23,6 +23,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <ctime>
 #include <chrono>
 #include "vector_ref.h"
@@ -49,6 +50,29 @@ void simpleDebugOut(std::string const&);
 /// The logging system's current verbosity.
 extern int g_logVerbosity;
 
+/**
+ * @brief Limits a log site to @a _burst lines per @a _periodMs, counting what it suppresses.
+ * Use through clog_limited() rather than directly.
+ */
+class LogRateLimiter
+{
+public:
+	LogRateLimiter(unsigned _burst, unsigned _periodMs);
+
+	/// @returns true if a line may be logged now.
+	bool allow();
+
+	/// @returns a note about the lines suppressed since the last call, or an empty string.
+	std::string suppressed();
+
+private:
+	unsigned const m_burst;
+	uint64_t const m_periodMs;
+	std::atomic<uint64_t> m_windowStart = {0};
+	std::atomic<unsigned> m_count = {0};
+	std::atomic<unsigned> m_suppressed = {0};
+};
+
 class ThreadContext
 {
 public:
@@ -86,7 +110,7 @@ enum class LogTag
 class LogOutputStreamBase
 {
 public:
-	LogOutputStreamBase(char const* _id, std::type_info const* _info, unsigned _v, bool _autospacing);
+	LogOutputStreamBase(char const* _id, unsigned _v, bool _autospacing);
 
 	void comment(std::string const& _t)
 	{
@@ -202,7 +226,7 @@ class LogOutputStream: LogOutputStreamBase
 public:
 	/// Construct a new object.
 	/// If _term is true the the prefix info is terminated with a ']' character; if not it ends only with a '|' character.
-	LogOutputStream(): LogOutputStreamBase(Id::name(), &typeid(Id), Id::verbosity, _AutoSpacing) {}
+	LogOutputStream(): LogOutputStreamBase(Id::name(), Id::verbosity, _AutoSpacing) {}
 
 	/// Destructor. Posts the accrued log entry to the g_logPost function.
 	~LogOutputStream() { if (Id::verbosity <= g_logVerbosity) simpleDebugOut(m_sstr.str()); }
@@ -229,6 +253,13 @@ public:
 #endif
 #endif
 
+/// Like clog(X), but logs at most BURST lines per PERIOD_MS from this call site. The first line
+/// after a suppressed period is prefixed with the number of lines that were dropped.
+#define clog_limited(X, BURST, PERIOD_MS) \
+	for (dev::LogRateLimiter* _limiter = []() { static dev::LogRateLimiter s_limiter(BURST, PERIOD_MS); return &s_limiter; }(); \
+		_limiter && _limiter->allow(); _limiter = nullptr) \
+		clog(X) << _limiter->suppressed()
+
 // Simple cout-like stream objects for accessing common log channels.
 // Dirties the global namespace, but oh so convenient...
 #define cdebug clog(dev::DebugChannel)
@@ -0,0 +1,198 @@
+/// Lock-free metrics registry (counters, gauges, histograms).
+///
+/// @file
+/// @copyright GNU General Public License
+
+#include "Metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include "Exceptions.h"
+
+using namespace std;
+using namespace dev;
+
+void MetricGauge::add(double _v)
+{
+	double old = m_value.load(std::memory_order_relaxed);
+	while (!m_value.compare_exchange_weak(old, old + _v, std::memory_order_relaxed)) {}
+}
+
+MetricHistogram::MetricHistogram(vector<double> const& _bounds):
+	m_bounds(_bounds),
+	m_buckets(new atomic<uint64_t>[_bounds.size() + 1])
+{
+	sort(m_bounds.begin(), m_bounds.end());
+	for (size_t i = 0; i <= m_bounds.size(); ++i)
+		m_buckets[i].store(0, std::memory_order_relaxed);
+}
+
+void MetricHistogram::observe(double _v)
+{
+	size_t i = lower_bound(m_bounds.begin(), m_bounds.end(), _v) - m_bounds.begin();
+	m_buckets[i].fetch_add(1, std::memory_order_relaxed);
+	m_count.fetch_add(1, std::memory_order_relaxed);
+	m_sum.add(_v);
+}
+
+vector<uint64_t> MetricHistogram::counts() const
+{
+	vector<uint64_t> ret(m_bounds.size() + 1);
+	for (size_t i = 0; i < ret.size(); ++i)
+		ret[i] = m_buckets[i].load(std::memory_order_relaxed);
+	return ret;
+}
+
+vector<double> dev::exponentialBuckets(double _start, double _factor, unsigned _count)
+{
+	vector<double> ret;
+	for (unsigned i = 0; i < _count; ++i, _start *= _factor)
+		ret.push_back(_start);
+	return ret;
+}
+
+string dev::metricLabel(string const& _name, string const& _value)
+{
+	string escaped;
+	for (char c: _value)
+	{
+		if (c == '\\' || c == '"')
+			escaped += '\\';
+		if (c == '\n')
+		{
+			escaped += "\\n";
+			continue;
+		}
+		escaped += c;
+	}
+	return _name + "=\"" + escaped + "\"";
+}
+
+MetricsRegistry& MetricsRegistry::get()
+{
+	static MetricsRegistry instance;
+	return instance;
+}
+
+MetricsRegistry::Family& MetricsRegistry::family(string const& _name, string const& _help, Type _type)
+{
+	auto it = m_families.find(_name);
+	if (it == m_families.end())
+	{
+		Family& f = m_families[_name];
+		f.type = _type;
+		f.help = _help;
+		return f;
+	}
+	if (it->second.type != _type)
+		BOOST_THROW_EXCEPTION(Exception() << errinfo_comment("metric " + _name + " registered with a different type"));
+	return it->second;
+}
+
+MetricCounter& MetricsRegistry::counter(string const& _name, string const& _help, string const& _labels)
+{
+	Guard l(x_families);
+	auto& m = family(_name, _help, Type::Counter).counters[_labels];
+	if (!m)
+		m.reset(new MetricCounter);
+	return *m;
+}
+
+MetricGauge& MetricsRegistry::gauge(string const& _name, string const& _help, string const& _labels)
+{
+	Guard l(x_families);
+	auto& m = family(_name, _help, Type::Gauge).gauges[_labels];
+	if (!m)
+		m.reset(new MetricGauge);
+	return *m;
+}
+
+MetricHistogram& MetricsRegistry::histogram(string const& _name, string const& _help, vector<double> const& _bounds, string const& _labels)
+{
+	Guard l(x_families);
+	auto& m = family(_name, _help, Type::Histogram).histograms[_labels];
+	if (!m)
+		m.reset(new MetricHistogram(_bounds));
+	return *m;
+}
+
+namespace
+{
+
+string braced(string const& _labels)
+{
+	return _labels.empty() ? string() : "{" + _labels + "}";
+}
+
+string withLabel(string const& _labels, string const& _extra)
+{
+	return "{" + (_labels.empty() ? _extra : _labels + "," + _extra) + "}";
+}
+
+void writeValue(ostream& _out, double _v)
+{
+	if (std::isinf(_v))
+		_out << (_v > 0 ? "+Inf" : "-Inf");
+	else if (std::isnan(_v))
+		_out << "NaN";
+	else
+		_out << _v;
+}
+
+}
+
+string MetricsRegistry::exposition() const
+{
+	ostringstream out;
+	out.precision(15);
+
+	Guard l(x_families);
+	for (auto const& f: m_families)
+	{
+		string const& name = f.first;
+		Family const& family = f.second;
+		out << "# HELP " << name << " " << family.help << "\n";
+		switch (family.type)
+		{
+		case Type::Counter:
+			out << "# TYPE " << name << " counter\n";
+			for (auto const& c: family.counters)
+				out << name << braced(c.first) << " " << c.second->value() << "\n";
+			break;
+		case Type::Gauge:
+			out << "# TYPE " << name << " gauge\n";
+			for (auto const& g: family.gauges)
+			{
+				out << name << braced(g.first) << " ";
+				writeValue(out, g.second->value());
+				out << "\n";
+			}
+			break;
+		case Type::Histogram:
+			out << "# TYPE " << name << " histogram\n";
+			for (auto const& h: family.histograms)
+			{
+				vector<uint64_t> counts = h.second->counts();
+				vector<double> const& bounds = h.second->bounds();
+				uint64_t cumulative = 0;
+				for (size_t i = 0; i < bounds.size(); ++i)
+				{
+					cumulative += counts[i];
+					ostringstream le;
+					le.precision(15);
+					le << "le=\"" << bounds[i] << "\"";
+					out << name << "_bucket" << withLabel(h.first, le.str()) << " " << cumulative << "\n";
+				}
+				cumulative += counts.back();
+				out << name << "_bucket" << withLabel(h.first, "le=\"+Inf\"") << " " << cumulative << "\n";
+				out << name << "_sum" << braced(h.first) << " ";
+				writeValue(out, h.second->sum());
+				out << "\n";
+				out << name << "_count" << braced(h.first) << " " << cumulative << "\n";
+			}
+			break;
+		}
+	}
+	return out.str();
+}
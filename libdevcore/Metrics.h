@@ -0,0 +1,109 @@
+/// Lock-free metrics registry (counters, gauges, histograms).
+///
+/// @file
+/// @copyright GNU General Public License
+
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Guards.h"
+
+namespace dev
+{
+
+/// Monotonically increasing counter.
+class MetricCounter
+{
+public:
+	void inc(uint64_t _n = 1) { m_value.fetch_add(_n, std::memory_order_relaxed); }
+	uint64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<uint64_t> m_value = {0};
+};
+
+/// Value that can go up and down.
+class MetricGauge
+{
+public:
+	void set(double _v) { m_value.store(_v, std::memory_order_relaxed); }
+	void add(double _v);
+	double value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<double> m_value = {0};
+};
+
+/// Fixed-bucket histogram. Observing is wait-free; buckets are cumulative only on exposition.
+class MetricHistogram
+{
+public:
+	explicit MetricHistogram(std::vector<double> const& _bounds);
+
+	void observe(double _v);
+
+	std::vector<double> const& bounds() const { return m_bounds; }
+	/// Per-bucket (non cumulative) counts, the last entry is the +Inf bucket.
+	std::vector<uint64_t> counts() const;
+	uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+	double sum() const { return m_sum.value(); }
+
+private:
+	std::vector<double> m_bounds;
+	std::unique_ptr<std::atomic<uint64_t>[]> m_buckets;
+	std::atomic<uint64_t> m_count = {0};
+	MetricGauge m_sum;
+};
+
+/// @returns @a _count bucket bounds starting at @a _start, each @a _factor times the previous.
+std::vector<double> exponentialBuckets(double _start, double _factor, unsigned _count);
+
+/// Formats a single label pair, e.g. metricLabel("device", "cl-0") -> device="cl-0".
+std::string metricLabel(std::string const& _name, std::string const& _value);
+
+/**
+ * @brief Process wide registry of named metrics.
+ * Looking a metric up takes a lock, so callers on hot paths should look it up once and keep
+ * the returned reference; metrics are never destroyed. Updating a metric is lock-free.
+ */
+class MetricsRegistry
+{
+public:
+	static MetricsRegistry& get();
+
+	MetricCounter& counter(std::string const& _name, std::string const& _help, std::string const& _labels = "");
+	MetricGauge& gauge(std::string const& _name, std::string const& _help, std::string const& _labels = "");
+	MetricHistogram& histogram(std::string const& _name, std::string const& _help, std::vector<double> const& _bounds, std::string const& _labels = "");
+
+	/// Renders all metrics in the Prometheus text exposition format (version 0.0.4).
+	std::string exposition() const;
+
+private:
+	enum class Type
+	{
+		Counter,
+		Gauge,
+		Histogram
+	};
+
+	struct Family
+	{
+		Type type;
+		std::string help;
+		std::map<std::string, std::unique_ptr<MetricCounter>> counters;
+		std::map<std::string, std::unique_ptr<MetricGauge>> gauges;
+		std::map<std::string, std::unique_ptr<MetricHistogram>> histograms;
+	};
+
+	MetricsRegistry() = default;
+	Family& family(std::string const& _name, std::string const& _help, Type _type);
+
+	mutable Mutex x_families;
+	std::map<std::string, Family> m_families;
+};
+
+}
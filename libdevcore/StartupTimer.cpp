@@ -0,0 +1,71 @@
+/// Timing of the startup phases up to the first hash.
+///
+/// @file
+/// @copyright GNU General Public License
+
+#include "StartupTimer.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include "Log.h"
+#include "Metrics.h"
+
+using namespace std;
+using namespace dev;
+
+namespace
+{
+
+// Taken when the library is loaded, before main() runs.
+StartupTimer::Clock::time_point const c_processStart = StartupTimer::Clock::now();
+
+double sinceStart(StartupTimer::Clock::time_point _t)
+{
+	return chrono::duration<double>(_t - c_processStart).count();
+}
+
+}
+
+StartupTimer& StartupTimer::get()
+{
+	static StartupTimer s_timer;
+	return s_timer;
+}
+
+void StartupTimer::record(string const& _name, Clock::time_point _start)
+{
+	if (done())
+		return;
+	Guard l(x_phases);
+	m_phases.push_back(Phase{_name, sinceStart(_start), sinceStart(Clock::now())});
+}
+
+void StartupTimer::firstHash(string const& _device)
+{
+	double now = sinceStart(Clock::now());
+	if (m_done.exchange(true))
+		return;
+	MetricsRegistry::get().gauge("ethminer_startup_seconds", "Time from the start of the process to the first hash.").set(now);
+
+	ostringstream total;
+	total << fixed << setprecision(2) << now << "s";
+	cnote << "Time to first hash" << total.str() << "on" << _device << "- startup phases:";
+	for (Phase const& p: phases())
+	{
+		ostringstream line;
+		line << fixed << setprecision(2) << "  " << left << setw(20) << p.name << right
+			<< setw(8) << p.start << "s to" << setw(8) << p.end << "s" << setw(8) << p.end - p.start << "s";
+		cnote << line.str();
+	}
+}
+
+vector<StartupTimer::Phase> StartupTimer::phases() const
+{
+	vector<Phase> ret;
+	{
+		Guard l(x_phases);
+		ret = m_phases;
+	}
+	stable_sort(ret.begin(), ret.end(), [](Phase const& _a, Phase const& _b) { return _a.start < _b.start; });
+	return ret;
+}
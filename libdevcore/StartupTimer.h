@@ -0,0 +1,69 @@
+/// Timing of the startup phases up to the first hash.
+///
+/// @file
+/// @copyright GNU General Public License
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "Guards.h"
+
+namespace dev
+{
+
+/**
+ * @brief Collects how long each startup phase took, relative to the start of the process.
+ * Phases may overlap, e.g. the light cache builds while devices are enumerated and kernels
+ * compile. The first hash of any device logs the breakdown and freezes it; later phases, such as
+ * the DAG builds of following epochs, are ignored.
+ */
+class StartupTimer
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	struct Phase
+	{
+		std::string name;
+		double start;	///< Seconds since the process started.
+		double end;
+	};
+
+	static StartupTimer& get();
+
+	/// Records phase @a _name as running from @a _start until now.
+	void record(std::string const& _name, Clock::time_point _start);
+	/// Records a point in time, e.g. the arrival of the first work.
+	void mark(std::string const& _name) { record(_name, Clock::now()); }
+
+	/// Reports the first hashes of @a _device. The first call logs the breakdown.
+	void firstHash(std::string const& _device);
+
+	bool done() const { return m_done.load(std::memory_order_relaxed); }
+	/// @returns the phases recorded so far, in order of their start.
+	std::vector<Phase> phases() const;
+
+private:
+	StartupTimer() = default;
+
+	mutable Mutex x_phases;
+	std::vector<Phase> m_phases;
+	std::atomic<bool> m_done = {false};
+};
+
+/// Records the enclosing scope as startup phase @a _name.
+class StartupPhase
+{
+public:
+	explicit StartupPhase(std::string const& _name): m_name(_name) {}
+	~StartupPhase() { StartupTimer::get().record(m_name, m_start); }
+
+private:
+	std::string m_name;
+	StartupTimer::Clock::time_point m_start = StartupTimer::Clock::now();
+};
+
+}
@@ -0,0 +1,163 @@
+/// Work-stealing thread pool for CPU-bound tasks.
+///
+/// @file
+/// @copyright GNU General Public License
+
+#include "TaskPool.h"
+
+#include <algorithm>
+#include "Log.h"
+#include "Metrics.h"
+
+using namespace std;
+using namespace dev;
+
+namespace
+{
+
+thread_local TaskPool const* t_pool = nullptr;
+thread_local unsigned t_lane = 0;
+
+char const* const c_priorityNames[] = {"high", "normal", "low"};
+
+}
+
+TaskPool& TaskPool::get()
+{
+	static TaskPool* s_pool = new TaskPool(max(2u, thread::hardware_concurrency()));
+	return *s_pool;
+}
+
+TaskPool::TaskPool(unsigned _workers, string const& _name):
+	m_name(_name),
+	m_tasks(MetricsRegistry::get().counter("ethminer_tasks_total", "Tasks run by the CPU task pool.", metricLabel("pool", _name))),
+	m_steals(MetricsRegistry::get().counter("ethminer_task_steals_total", "Tasks a worker took from another worker's queue.", metricLabel("pool", _name))),
+	m_wait(MetricsRegistry::get().histogram("ethminer_task_queue_seconds", "Time tasks spent queued before starting.", exponentialBuckets(0.00001, 4, 12), metricLabel("pool", _name)))
+{
+	for (unsigned p = 0; p < c_priorities; ++p)
+		m_depth[p] = &MetricsRegistry::get().gauge("ethminer_task_queue_depth", "Tasks queued in the CPU task pool.", metricLabel("pool", _name) + "," + metricLabel("priority", c_priorityNames[p]));
+
+	_workers = max(1u, _workers);
+	for (unsigned i = 0; i < _workers; ++i)
+		m_lanes.emplace_back(new Lane);
+	for (unsigned i = 0; i < _workers; ++i)
+		m_threads.emplace_back([this, i]() { workerLoop(i); });
+}
+
+TaskPool::~TaskPool()
+{
+	{
+		lock_guard<mutex> l(x_sleep);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+	for (auto& t: m_threads)
+		t.join();
+}
+
+void TaskPool::submit(Task _task, TaskPriority _priority, unsigned _affinity)
+{
+	unsigned lane;
+	if (_affinity != c_anyWorker)
+		lane = _affinity % m_lanes.size();
+	else if (isWorker())
+		lane = currentLane();
+	else
+		lane = m_next.fetch_add(1, memory_order_relaxed) % m_lanes.size();
+
+	unsigned p = (unsigned)_priority;
+	{
+		Guard l(m_lanes[lane]->x_tasks);
+		m_lanes[lane]->tasks[p].push_back(Queued{move(_task), chrono::steady_clock::now()});
+		m_queued.fetch_add(1, memory_order_relaxed);
+	}
+	m_depth[p]->add(1);
+
+	// Taking the lock orders the increment before a worker's check, so the wake up is not lost.
+	{
+		lock_guard<mutex> l(x_sleep);
+	}
+	m_wake.notify_one();
+}
+
+bool TaskPool::runOne(unsigned _lane)
+{
+	Queued q;
+	unsigned priority = 0;
+	bool found = false;
+	bool stolen = false;
+	for (unsigned p = 0; p < c_priorities && !found; ++p)
+	{
+		for (unsigned i = 0; i < m_lanes.size() && !found; ++i)
+		{
+			// Own lane first, newest task first; then steal the oldest task of the others.
+			unsigned lane = _lane == c_anyWorker ? i : (_lane + i) % m_lanes.size();
+			Lane& l = *m_lanes[lane];
+			Guard g(l.x_tasks);
+			auto& tasks = l.tasks[p];
+			if (tasks.empty())
+				continue;
+			if (lane == _lane)
+			{
+				q = move(tasks.back());
+				tasks.pop_back();
+			}
+			else
+			{
+				q = move(tasks.front());
+				tasks.pop_front();
+				stolen = true;
+			}
+			m_queued.fetch_sub(1, memory_order_relaxed);
+			priority = p;
+			found = true;
+		}
+	}
+	if (!found)
+		return false;
+
+	m_depth[priority]->add(-1);
+	m_wait.observe(chrono::duration<double>(chrono::steady_clock::now() - q.since).count());
+	if (stolen)
+		m_steals.inc();
+	try
+	{
+		q.task();
+	}
+	catch (std::exception const& _e)
+	{
+		clog(WarnChannel) << "Exception thrown in task pool" << m_name << ":" << _e.what();
+	}
+	catch (...)
+	{
+		clog(WarnChannel) << "Unknown exception thrown in task pool" << m_name;
+	}
+	m_tasks.inc();
+	return true;
+}
+
+void TaskPool::workerLoop(unsigned _lane)
+{
+	t_pool = this;
+	t_lane = _lane;
+	setThreadName((m_name + to_string(_lane)).c_str());
+	while (true)
+	{
+		if (runOne(_lane))
+			continue;
+		unique_lock<mutex> l(x_sleep);
+		m_wake.wait(l, [&]() { return m_stop || m_queued.load(memory_order_relaxed) > 0; });
+		if (m_stop && !m_queued.load(memory_order_relaxed))
+			return;
+	}
+}
+
+bool TaskPool::isWorker() const
+{
+	return t_pool == this;
+}
+
+unsigned TaskPool::currentLane() const
+{
+	return t_lane;
+}
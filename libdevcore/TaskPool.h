@@ -0,0 +1,133 @@
+/// Work-stealing thread pool for CPU-bound tasks.
+///
+/// @file
+/// @copyright GNU General Public License
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Guards.h"
+
+namespace dev
+{
+
+class MetricCounter;
+class MetricGauge;
+class MetricHistogram;
+
+/// Tasks of a higher priority run first on every worker.
+enum class TaskPriority
+{
+	High,	///< Latency sensitive, e.g. verifying a solution.
+	Normal,
+	Low,	///< Background, e.g. preparing the next epoch.
+};
+
+/**
+ * @brief Fixed set of worker threads, each with its own task queue per priority.
+ * A worker runs the newest task of its own queue first and, when that is empty, steals the oldest
+ * task of another worker. Tasks submitted from a worker go to its own queue, so follow-up work
+ * stays on a warm cache. Other submissions go round robin, or to the worker named by the affinity
+ * hint. A hint never prevents an idle worker from stealing the task.
+ */
+class TaskPool
+{
+public:
+	using Task = std::function<void()>;
+
+	static const unsigned c_anyWorker = ~0u;
+
+	/// The process wide pool with one worker per hardware thread (at least two). It is never
+	/// destroyed, so threads still running at exit can keep submitting.
+	static TaskPool& get();
+
+	explicit TaskPool(unsigned _workers, std::string const& _name = "pool");
+	/// Runs the tasks still queued, then joins the workers.
+	~TaskPool();
+
+	TaskPool(TaskPool const&) = delete;
+	TaskPool& operator=(TaskPool const&) = delete;
+
+	/// Queues @a _task. Exceptions escaping a task are logged and dropped.
+	void submit(Task _task, TaskPriority _priority = TaskPriority::Normal, unsigned _affinity = c_anyWorker);
+
+	/// Queues @a _f and @returns a future of its result or exception.
+	template <class F>
+	auto async(F _f, TaskPriority _priority = TaskPriority::Normal, unsigned _affinity = c_anyWorker) -> std::shared_future<decltype(_f())>
+	{
+		using R = decltype(_f());
+		auto task = std::make_shared<std::packaged_task<R()>>(std::move(_f));
+		std::shared_future<R> ret = task->get_future().share();
+		submit([task]() { (*task)(); }, _priority, _affinity);
+		return ret;
+	}
+
+	/**
+	 * @brief Waits for @a _f. A worker of this pool runs other queued tasks meanwhile, so a task
+	 * waiting for another one can not deadlock the pool.
+	 */
+	template <class T>
+	void wait(std::shared_future<T> const& _f)
+	{
+		if (!isWorker())
+		{
+			_f.wait();
+			return;
+		}
+		while (_f.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			if (!runOne(currentLane()))
+				_f.wait_for(std::chrono::milliseconds(1));
+	}
+
+	unsigned workers() const { return (unsigned)m_lanes.size(); }
+
+	/// @returns the number of tasks queued and not yet started.
+	size_t queued() const { return m_queued.load(std::memory_order_relaxed); }
+
+private:
+	static const unsigned c_priorities = 3;
+
+	struct Queued
+	{
+		Task task;
+		std::chrono::steady_clock::time_point since;
+	};
+
+	struct Lane
+	{
+		Mutex x_tasks;
+		std::deque<Queued> tasks[c_priorities];
+	};
+
+	void workerLoop(unsigned _lane);
+	/// Runs one task, preferring higher priorities and the own lane. @returns false if nothing was queued.
+	bool runOne(unsigned _lane);
+	bool isWorker() const;
+	unsigned currentLane() const;
+
+	std::vector<std::unique_ptr<Lane>> m_lanes;
+	std::vector<std::thread> m_threads;
+	std::string m_name;
+	std::atomic<unsigned> m_next = {0};
+	std::atomic<size_t> m_queued = {0};
+
+	std::mutex x_sleep;
+	std::condition_variable m_wake;
+	bool m_stop = false;
+
+	MetricGauge* m_depth[c_priorities];
+	MetricCounter& m_tasks;
+	MetricCounter& m_steals;
+	MetricHistogram& m_wait;
+};
+
+}
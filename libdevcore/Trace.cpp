@@ -0,0 +1,195 @@
+/// Low overhead event tracer with Chrome trace export.
+///
+/// @file
+/// @copyright GNU General Public License
+
+#include "Trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "Guards.h"
+#include "Log.h"
+
+using namespace std;
+using namespace dev;
+
+atomic<bool> Tracer::s_enabled = {false};
+atomic<bool> Tracer::s_dumpRequested = {false};
+
+namespace
+{
+
+// Fields are relaxed atomics so a dump racing with the owning thread reads stale or
+// discarded records, never undefined behaviour. Relaxed stores are plain moves on x86.
+struct TraceRecord
+{
+	atomic<uint64_t> ts;
+	atomic<uint64_t> arg;
+	atomic<char const*> name;
+	atomic<char> phase;
+};
+
+struct TraceBuffer
+{
+	explicit TraceBuffer(unsigned _tid): tid(_tid), threadName(getThreadName()) {}
+
+	unsigned tid;
+	string threadName;
+	atomic<uint64_t> head = {0};	///< Number of records ever written.
+	TraceRecord records[Tracer::c_bufferSize];
+};
+
+struct TraceState
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	string file;
+
+	Mutex x_buffers;
+	// Buffers outlive their threads so events of finished threads remain in the dump.
+	vector<unique_ptr<TraceBuffer>> buffers;
+
+	atomic<bool> stop = {false};
+	thread dumper;
+};
+
+// Never destroyed: threads may still record while static destructors run.
+TraceState& state()
+{
+	static TraceState* s = new TraceState;
+	return *s;
+}
+
+/// Stops the dumper thread and writes the final trace at exit.
+struct TraceAtExit
+{
+	~TraceAtExit()
+	{
+		TraceState& s = state();
+		s.stop = true;
+		if (s.dumper.joinable())
+			s.dumper.join();
+		Tracer::dump(s.file);
+	}
+};
+
+thread_local TraceBuffer* t_buffer = nullptr;
+
+TraceBuffer& threadBuffer()
+{
+	if (!t_buffer)
+	{
+		TraceState& s = state();
+		Guard l(s.x_buffers);
+		s.buffers.emplace_back(new TraceBuffer(s.buffers.size() + 1));
+		t_buffer = s.buffers.back().get();
+	}
+	return *t_buffer;
+}
+
+void writeEscaped(ostream& _out, string const& _s)
+{
+	for (char c: _s)
+		if (c == '"' || c == '\\')
+			_out << '\\' << c;
+		else if ((unsigned char)c >= 0x20)
+			_out << c;
+}
+
+#if !defined(_WIN32)
+void onDumpSignal(int)
+{
+	Tracer::requestDump();
+}
+#endif
+
+}
+
+void Tracer::enable(string const& _file)
+{
+	TraceState& s = state();
+	if (s.dumper.joinable())
+		return;
+	static TraceAtExit s_atExit;
+	s.file = _file;
+	s_enabled = true;
+#if !defined(_WIN32)
+	signal(SIGUSR1, onDumpSignal);
+#endif
+	s.dumper = thread([&s]() {
+		setThreadName("trace");
+		while (!s.stop)
+		{
+			if (s_dumpRequested.exchange(false))
+			{
+				if (dump(s.file))
+					cnote << "Trace written to" << s.file;
+				else
+					cwarn << "Failed to write trace to" << s.file;
+			}
+			this_thread::sleep_for(chrono::milliseconds(100));
+		}
+	});
+}
+
+void Tracer::record(char const* _name, char _phase, uint64_t _arg)
+{
+	TraceBuffer& b = threadBuffer();
+	uint64_t head = b.head.load(memory_order_relaxed);
+	TraceRecord& r = b.records[head % c_bufferSize];
+	r.ts.store(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - state().start).count(), memory_order_relaxed);
+	r.arg.store(_arg, memory_order_relaxed);
+	r.name.store(_name, memory_order_relaxed);
+	r.phase.store(_phase, memory_order_relaxed);
+	b.head.store(head + 1, memory_order_release);
+}
+
+bool Tracer::dump(string const& _file)
+{
+	ofstream out(_file);
+	if (!out)
+		return false;
+
+	TraceState& s = state();
+	Guard l(s.x_buffers);
+	out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+	bool first = true;
+	for (auto const& b: s.buffers)
+	{
+		out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << b->tid << ",\"args\":{\"name\":\"";
+		writeEscaped(out, b->threadName);
+		out << "\"}}";
+		first = false;
+
+		uint64_t head = b->head.load(memory_order_acquire);
+		uint64_t begin = head > c_bufferSize ? head - c_bufferSize : 0;
+		for (uint64_t i = begin; i < head; ++i)
+		{
+			TraceRecord const& r = b->records[i % c_bufferSize];
+			uint64_t ts = r.ts.load(memory_order_relaxed);
+			uint64_t arg = r.arg.load(memory_order_relaxed);
+			char const* name = r.name.load(memory_order_relaxed);
+			char phase = r.phase.load(memory_order_relaxed);
+			// Skip records the owning thread may have overwritten while we were reading. Record i is
+			// rewritten while head is still i + c_bufferSize, before the head store that follows it.
+			// The fence keeps the record reads above from moving after the head re-check.
+			atomic_thread_fence(memory_order_acquire);
+			if (b->head.load(memory_order_relaxed) - i >= c_bufferSize)
+				continue;
+			out << ",\n{\"name\":\"" << name << "\",\"ph\":\"" << phase << "\",\"pid\":1,\"tid\":" << b->tid
+				<< ",\"ts\":" << ts / 1000 << "." << setfill('0') << setw(3) << ts % 1000;
+			if (phase == 'i')
+				out << ",\"s\":\"t\"";
+			if (phase != 'E')
+				out << ",\"args\":{\"v\":" << arg << "}";
+			out << "}";
+		}
+	}
+	out << "\n]}\n";
+	return bool(out);
+}
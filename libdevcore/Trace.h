@@ -0,0 +1,74 @@
+/// Low overhead event tracer with Chrome trace export.
+///
+/// @file
+/// @copyright GNU General Public License
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace dev
+{
+
+/**
+ * @brief Records timestamped events into per-thread ring buffers.
+ * Recording takes no lock: each thread owns a fixed-size buffer of the latest events and only
+ * the dumper reads them. When tracing is disabled every macro below costs a single relaxed load.
+ * Dumps are written as Chrome trace JSON, viewable in chrome://tracing or Perfetto.
+ */
+class Tracer
+{
+public:
+	/// Number of events kept per thread, older events are overwritten.
+	static const unsigned c_bufferSize = 1 << 14;
+
+	static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+	/// Starts recording. Dumps go to @a _file on SIGUSR1 (where available) and at exit.
+	static void enable(std::string const& _file);
+
+	/// Records an event; @a _name must be a string literal. @a _phase is a Chrome trace phase:
+	/// 'B' begin, 'E' end or 'i' instant.
+	static void record(char const* _name, char _phase, uint64_t _arg = 0);
+
+	/// Writes all buffered events to @a _file. @returns false if the file cannot be written.
+	static bool dump(std::string const& _file);
+
+	/// Asks the dumper thread to write the trace file. Async-signal-safe.
+	static void requestDump() { s_dumpRequested.store(true, std::memory_order_relaxed); }
+
+private:
+	static std::atomic<bool> s_enabled;
+	static std::atomic<bool> s_dumpRequested;
+};
+
+/// Records a begin event on construction and the matching end event on destruction.
+class TraceScope
+{
+public:
+	TraceScope(char const* _name, uint64_t _arg = 0): m_name(Tracer::enabled() ? _name : nullptr)
+	{
+		if (m_name)
+			Tracer::record(m_name, 'B', _arg);
+	}
+	~TraceScope()
+	{
+		if (m_name)
+			Tracer::record(m_name, 'E');
+	}
+
+private:
+	char const* m_name;
+};
+
+}
+
+#define DEV_TRACE_CAT2(A, B) A ## B
+#define DEV_TRACE_CAT(A, B) DEV_TRACE_CAT2(A, B)
+
+/// Traces the enclosing scope.
+#define DEV_TRACE_SCOPE(NAME, ARG) dev::TraceScope DEV_TRACE_CAT(__traceScope, __LINE__)(NAME, ARG)
+/// Traces a point in time.
+#define DEV_TRACE_INSTANT(NAME, ARG) if (dev::Tracer::enabled()) dev::Tracer::record(NAME, 'i', ARG); else {}
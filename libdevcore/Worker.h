@@ -55,8 +55,13 @@ public:
 	/// Stop worker thread; causes call to stopWorking().
 	void stopWorking();
 
+	/// Asks the worker thread to stop without waiting for it, so it may be called from the thread itself.
+	void requestStop() { WorkerState ex = WorkerState::Started; m_state.compare_exchange_strong(ex, WorkerState::Stopping); }
+
 	bool shouldStop() const { return m_state != WorkerState::Started; }
 
+	std::string const& name() const { return m_name; }
+
 private:
 	virtual void workLoop() = 0;
 
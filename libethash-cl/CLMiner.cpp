@@ -5,12 +5,16 @@
 
 #include "CLMiner.h"
 #include <libethash/internal.h>
+#include <libdevcore/TaskPool.h>
+#include <libethcore/BandwidthProbe.h>
 #include "CLMiner_kernel_stable.h"
 #include "CLMiner_kernel_unstable.h"
+#include "CLMiner_probe.h"
 
 #include <string>
 #include <fstream>
 #include <streambuf>
+#include <sys/stat.h>
 
 using namespace dev;
 using namespace eth;
@@ -25,7 +29,8 @@ unsigned CLMiner::s_initialGlobalWorkSize = CLMiner::c_defaultGlobalWorkSizeMult
 unsigned CLMiner::s_threadsPerHash = 8;
 CLKernelName CLMiner::s_clKernelName = CLMiner::c_defaultKernelName;
 
-constexpr size_t c_maxSearchResults = 1;
+// A few slots, so a reloaded kernel can be validated on all the nonces it reports.
+constexpr size_t c_maxSearchResults = 4;
 
 struct CLChannel: public LogChannel
 {
@@ -205,19 +210,21 @@ static std::string ethCLErrorHelper(const char *msg, cl::Error const &clerr) {
 namespace
 {
 
-void addDefinition(string& _source, char const* _id, unsigned _value)
-{
-	char buf[256];
-	sprintf(buf, "#define %s %uu\n", _id, _value);
-	_source.insert(_source.begin(), buf, buf + strlen(buf));
-}
+// Enumeration is slow on some drivers and every device and option needs it: it is done once
+// and shared.
+Mutex x_enumeration;
 
 std::vector<cl::Platform> getPlatforms()
 {
-	vector<cl::Platform> platforms;
+	static vector<cl::Platform> s_platforms;
+	static bool s_enumerated = false;
+	Guard l(x_enumeration);
+	if (s_enumerated)
+		return s_platforms;
+	StartupPhase phase("platform enumeration");
 	try
 	{
-		cl::Platform::get(&platforms);
+		cl::Platform::get(&s_platforms);
 	}
 	catch(cl::Error const& err)
 	{
@@ -228,13 +235,20 @@ std::vector<cl::Platform> getPlatforms()
 #endif
 			throw err;
 	}
-	return platforms;
+	s_enumerated = true;
+	return s_platforms;
 }
 
 std::vector<cl::Device> getDevices(std::vector<cl::Platform> const& _platforms, unsigned _platformId)
 {
-	vector<cl::Device> devices;
+	static map<size_t, vector<cl::Device>> s_platformDevices;
 	size_t platform_num = min<size_t>(_platformId, _platforms.size() - 1);
+	Guard l(x_enumeration);
+	auto it = s_platformDevices.find(platform_num);
+	if (it != s_platformDevices.end())
+		return it->second;
+	StartupPhase phase("device enumeration");
+	vector<cl::Device> devices;
 	try
 	{
 		_platforms[platform_num].getDevices(
@@ -248,6 +262,7 @@ std::vector<cl::Device> getDevices(std::vector<cl::Platform> const& _platforms,
 		if (err.err() != CL_DEVICE_NOT_FOUND)
 			throw err;
 	}
+	s_platformDevices[platform_num] = devices;
 	return devices;
 }
 
@@ -256,8 +271,49 @@ std::vector<cl::Device> getDevices(std::vector<cl::Platform> const& _platforms,
 }
 }
 
+cl::Event* CLProfiler::add(char const* _op)
+{
+	m_pending.push_back(make_pair(_op, cl::Event()));
+	return &m_pending.back().second;
+}
+
+CLProfiler::Op& CLProfiler::op(char const* _op)
+{
+	auto it = m_ops.find(_op);
+	if (it != m_ops.end())
+		return it->second;
+	string labels = metricLabel("device", m_device) + "," + metricLabel("op", _op);
+	Op& ret = m_ops[_op];
+	ret.latency = &MetricsRegistry::get().histogram("ethminer_cl_latency_seconds", "Time from enqueueing an OpenCL command to its start on the device.", exponentialBuckets(0.000001, 4, 12), labels);
+	ret.exec = &MetricsRegistry::get().histogram("ethminer_cl_exec_seconds", "Execution time of OpenCL commands on the device.", exponentialBuckets(0.000001, 4, 14), labels);
+	return ret;
+}
+
+void CLProfiler::collect()
+{
+	for (auto const& p: m_pending)
+	{
+		cl_ulong queued = p.second.getProfilingInfo<CL_PROFILING_COMMAND_QUEUED>();
+		cl_ulong start = p.second.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+		cl_ulong end = p.second.getProfilingInfo<CL_PROFILING_COMMAND_END>();
+
+		Op& o = op(p.first);
+		o.latency->observe((start - queued) / 1e9);
+		o.exec->observe((end - start) / 1e9);
+		m_busyNs.inc(end - start);
+		if (m_lastEnd && start > m_lastEnd)
+		{
+			m_idle.observe((start - m_lastEnd) / 1e9);
+			m_idleNs.inc(start - m_lastEnd);
+		}
+		m_lastEnd = max(m_lastEnd, end);
+	}
+	m_pending.clear();
+}
+
 unsigned CLMiner::s_platformId = 0;
 unsigned CLMiner::s_numInstances = 0;
+bool CLMiner::s_profiling = false;
 int CLMiner::s_devices[16] = { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 };
 string CLMiner::s_devicenames[16] = { "CL0", "CL1", "CL2", "CL3", "CL4", "CL5", "CL6", "CL7", "CL8", "CL9", "CL10", "CL11", "CL12", "CL13", "CL14", "CL15" };
 
@@ -267,20 +323,21 @@ CLMiner::CLMiner(FarmFace& _farm, unsigned _index):
 
 CLMiner::~CLMiner()
 {
+	// The worker thread uses the next epoch until it has stopped.
+	stopWorking();
+	drainTasks();
 	kick_miner();
+	dropNextEpoch();
+	// The kernel rebuild may still use this miner. The worker, which owns m_reload, is stopped.
+	if (m_reload.valid())
+		m_reload.wait();
 }
 
 void CLMiner::report(uint64_t _nonce, WorkPackage const& _w)
 {
 	assert(_nonce != 0);
 	// TODO: Why re-evaluating?
-	Result r = EthashAux::eval(_w.seed, _w.header, _nonce);
-	if (r.value < _w.boundary)
-		farm.submitProof(Solution{_nonce, r.mixHash, _w, false});
-	else {
-		farm.failedSolution();
-		cwarn << "FAILURE: GPU gave incorrect result!";
-	}
+	verifyAsync(_nonce, _w, "GPU");
 }
 
 void CLMiner::workLoop()
@@ -289,18 +346,30 @@ void CLMiner::workLoop()
 	uint32_t const c_zero = 0;
 
 	uint64_t startNonce = 0;
+	uint64_t target = 0;
 
 	// The work package currently processed by GPU.
 	WorkPackage current;
 	current.header = h256{1u};
 	current.seed = h256{1u};
 
+	// Completion time of the previous search batch, unset across work switches.
+	std::chrono::steady_clock::time_point lastBatch;
+
+	// Set the device up while the pool connection and the first light are still on their way.
+	{
+		StartupPhase phase(name() + " device");
+		if (!initDevice())
+			return;
+	}
+
 	try {
 		while (true)
 		{
 			const WorkPackage w = work();
+			bool regenerate = dagCorrupted(w.seed);
 
-			if (current.header != w.header)
+			if (current.header != w.header || regenerate)
 			{
 				// New work received. Update GPU data.
 				auto localSwitchStart = std::chrono::high_resolution_clock::now();
@@ -314,26 +383,44 @@ void CLMiner::workLoop()
 
 				cllog << "New work: header" << w.header << "target" << w.boundary.hex();
 
-				if (current.seed != w.seed)
+				if (current.seed != w.seed || regenerate)
 				{
-					if (s_dagLoadMode == DAG_LOAD_MODE_SEQUENTIAL)
+					// A DAG generated ahead needs no build slot.
+					bool ahead = m_next.seed == w.seed && m_next.ready();
+					if (!ahead && !beginDag(w.seed))
 					{
-						while (s_dagLoadIndex < index)
-							this_thread::sleep_for(chrono::seconds(1));
-						++s_dagLoadIndex;
+						// Replaced by another epoch while queued, pick up the new work.
+						if (shouldStop())
+							break;
+						continue;
 					}
 
 					cllog << "New seed" << w.seed;
 					init(w.seed);
+					if (!ahead && !endDag())
+						continue;
+
+					// Measured once, on the DAG itself, to rate the hashrate against the memory.
+					if (!ceiling() && m_dagSize)
+					{
+						try
+						{
+							setBandwidth(probeBandwidth(m_context, m_device, m_dag, m_dagSize));
+						}
+						catch (cl::Error const& _e)
+						{
+							cwarn << ethCLErrorHelper("Bandwidth probe failed", _e);
+						}
+					}
 				}
 
 				// Upper 64 bits of the boundary.
-				const uint64_t target = (uint64_t)(u64)((u256)w.boundary >> 192);
+				target = (uint64_t)(u64)((u256)w.boundary >> 192);
 				assert(target > 0);
 
 				// Update header constant buffer.
-				m_queue.enqueueWriteBuffer(m_header, CL_FALSE, 0, w.header.size, w.header.data());
-				m_queue.enqueueWriteBuffer(m_searchBuffer, CL_FALSE, 0, sizeof(c_zero), &c_zero);
+				m_queue.enqueueWriteBuffer(m_header, CL_FALSE, 0, w.header.size, w.header.data(), nullptr, profile("write"));
+				m_queue.enqueueWriteBuffer(m_searchBuffer, CL_FALSE, 0, sizeof(c_zero), &c_zero, nullptr, profile("write"));
 
 				m_searchKernel.setArg(0, m_searchBuffer);  // Supply output buffer to kernel.
 				m_searchKernel.setArg(4, target);
@@ -347,30 +434,60 @@ void CLMiner::workLoop()
 				auto switchEnd = std::chrono::high_resolution_clock::now();
 				auto globalSwitchTime = std::chrono::duration_cast<std::chrono::milliseconds>(switchEnd - workSwitchStart).count();
 				auto localSwitchTime = std::chrono::duration_cast<std::chrono::microseconds>(switchEnd - localSwitchStart).count();
-				cllog << "Switch time" << globalSwitchTime << "ms /" << localSwitchTime << "us";
+				clog_limited(CLChannel, 10, 60000) << "Switch time" << globalSwitchTime << "ms /" << localSwitchTime << "us";
+				metrics().workSwitch.observe(std::chrono::duration<double>(switchEnd - workSwitchStart).count());
+				lastBatch = std::chrono::steady_clock::time_point();
 			}
 
 			// Read results.
 			// TODO: could use pinned host pointer instead.
 			uint32_t results[c_maxSearchResults + 1];
-			m_queue.enqueueReadBuffer(m_searchBuffer, CL_TRUE, 0, sizeof(results), &results);
+			{
+				DEV_TRACE_SCOPE("result_read", 0);
+				m_queue.enqueueReadBuffer(m_searchBuffer, CL_TRUE, 0, sizeof(results), &results, nullptr, profile("read"));
+			}
+			DEV_TRACE_INSTANT("kernel_complete", current.startNonce);
+			if (m_profiler)
+				m_profiler->collect();
 
-			uint64_t nonce = 0;
+			auto batchEnd = std::chrono::steady_clock::now();
+			if (lastBatch != std::chrono::steady_clock::time_point())
+			{
+				metrics().kernelTime.observe(std::chrono::duration<double>(batchEnd - lastBatch).count());
+				batchEnd += thermalThrottle(batchEnd - lastBatch);
+			}
+			lastBatch = batchEnd;
+
+			// The device is idle until the next search is queued, read the DAG check sample now.
+			vector<uint32_t> sample = dagCheckSample(m_dagSize);
+			if (!sample.empty())
+			{
+				bytes items(sample.size() * sizeof(node));
+				for (size_t i = 0; i < sample.size(); ++i)
+					m_queue.enqueueReadBuffer(m_dag, CL_FALSE, (size_t)sample[i] * sizeof(node), sizeof(node), items.data() + i * sizeof(node));
+				m_queue.finish();
+				verifyDagSample(w.seed, sample, items);
+			}
+			reloadKernel(w.seed, target);
+
+			vector<uint64_t> nonces;
 			if (results[0] > 0)
 			{
-				// Ignore results except the first one.
-				nonce = current.startNonce + results[1];
+				for (uint32_t i = 0; i < min<uint32_t>(results[0], c_maxSearchResults); ++i)
+					nonces.push_back(current.startNonce + results[i + 1]);
 				// Reset search buffer if any solution found.
-				m_queue.enqueueWriteBuffer(m_searchBuffer, CL_FALSE, 0, sizeof(c_zero), &c_zero);
+				m_queue.enqueueWriteBuffer(m_searchBuffer, CL_FALSE, 0, sizeof(c_zero), &c_zero, nullptr, profile("write"));
 			}
 
 			// Run the kernel.
 			m_searchKernel.setArg(3, startNonce);
-			m_queue.enqueueNDRangeKernel(m_searchKernel, cl::NullRange, m_globalWorkSize, m_workgroupSize);
+			DEV_TRACE_INSTANT("kernel_enqueue", startNonce);
+			m_queue.enqueueNDRangeKernel(m_searchKernel, cl::NullRange, m_globalWorkSize, m_workgroupSize, nullptr, profile("search"));
+			prepareNextEpoch(w.seed);
 
 			// Report results while the kernel is running.
 			// It takes some time because ethash must be re-evaluated on CPU.
-			if (nonce != 0)
+			for (uint64_t nonce: nonces)
 				report(nonce, current);
 
 			current = w;        // kernel now processing newest work
@@ -394,6 +511,8 @@ void CLMiner::workLoop()
 	catch (cl::Error const& _e)
 	{
 		cwarn << ethCLErrorHelper("OpenCL Error", _e);
+		publishError(ethCLErrorHelper("OpenCL Error", _e));
+		recordFault(DeviceHealth::KernelError, ethCLErrorHelper("OpenCL Error", _e));
 	}
 }
 
@@ -455,11 +574,21 @@ void CLMiner::listDevices()
 							outString += "\tWS: " + to_string(devices[i].getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>());
 							outString += "\t" + to_string(devices[i].getInfo<CL_DEVICE_MAX_CLOCK_FREQUENCY>()) + "Hz";
 							outString += "\t(" + devices[i].getInfo<CL_DEVICE_VENDOR>() + ")";
-							int epoch = 162;
-							int dagsize = 256 * 64 * 162;
-							int cu = devices[i].getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
-							int clock = devices[i].getInfo<CL_DEVICE_MAX_CLOCK_FREQUENCY>();
-							outString += "\t~" + to_string((cu * clock * 1200) / dagsize) + "MH/s\n";
+							try
+							{
+								cl::Context context(vector<cl::Device>(&devices[i], &devices[i] + 1));
+								uint64_t bytes = min<uint64_t>(devices[i].getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>(), 1024 * 1024 * 1024);
+								cl::Buffer mem(context, CL_MEM_READ_ONLY, bytes);
+								// Written once, so the reads hit real pages rather than lazily backed ones.
+								cl::CommandQueue queue(context, devices[i]);
+								queue.enqueueFillBuffer(mem, (cl_uint)0x9e3779b9, 0, bytes & ~uint64_t(3));
+								queue.finish();
+								outString += "\t" + formatBandwidth(probeBandwidth(context, devices[i], mem, bytes)) + "\n";
+							}
+							catch (cl::Error const& _e)
+							{
+								outString += "\t" + ethCLErrorHelper("Bandwidth probe failed", _e) + "\n";
+							}
 							std::cout << outString;
 						}
 					} else {
@@ -524,13 +653,15 @@ bool CLMiner::configureGPU(
 	return false;
 }
 
-HwMonitor CLMiner::hwmon()
+HwMonitor CLMiner::readHwmon()
 {
 	HwMonitor hw;
-	unsigned int tempC = 0, fanpcnt = 0;
+	unsigned int tempC = 0, fanpcnt = 0, powerMW = 0, coreMHz = 0, memMHz = 0;
 	if (nvmlh) {
 		wrap_nvml_get_tempC(nvmlh, index, &tempC);
 		wrap_nvml_get_fanpcnt(nvmlh, index, &fanpcnt);
+		wrap_nvml_get_power_usage(nvmlh, index, &powerMW);
+		wrap_nvml_get_clocks(nvmlh, index, &coreMHz, &memMHz);
 	}
 	if (adlh) {
 		wrap_adl_get_tempC(adlh, index, &tempC);
@@ -540,10 +671,15 @@ HwMonitor CLMiner::hwmon()
 	if (sysfsh) {
 		wrap_amdsysfs_get_tempC(sysfsh, index, &tempC);
 		wrap_amdsysfs_get_fanpcnt(sysfsh, index, &fanpcnt);
+		wrap_amdsysfs_get_power_usage(sysfsh, index, &powerMW);
+		wrap_amdsysfs_get_clocks(sysfsh, index, &coreMHz, &memMHz);
 	}
 #endif
 	hw.tempC = tempC;
 	hw.fanP = fanpcnt;
+	hw.powerW = powerMW / 1000.0;
+	hw.coreMHz = coreMHz;
+	hw.memMHz = memMHz;
 	return hw;
 }
 
@@ -551,11 +687,8 @@ string CLMiner::Name() {
 	return s_devicenames[index];
 }
 
-bool CLMiner::init(const h256& seed)
+bool CLMiner::initDevice()
 {
-	EthashAux::LightType light = EthashAux::light(seed);
-
-	// get all platforms
 	try
 	{
 		vector<cl::Platform> platforms = getPlatforms();
@@ -568,7 +701,7 @@ bool CLMiner::init(const h256& seed)
 		string platformName = platforms[platformIdx].getInfo<CL_PLATFORM_NAME>();
 		ETHCL_LOG("Platform: " << platformName);
 
-		int platformId = OPENCL_PLATFORM_UNKNOWN;
+		m_platformId = OPENCL_PLATFORM_UNKNOWN;
 		{
 			// this mutex prevents race conditions when calling the adl wrapper since it is apparently not thread safe
 			static std::mutex mtx;
@@ -576,12 +709,12 @@ bool CLMiner::init(const h256& seed)
 
 			if (platformName == "NVIDIA CUDA")
 			{
-				platformId = OPENCL_PLATFORM_NVIDIA;
+				m_platformId = OPENCL_PLATFORM_NVIDIA;
 				nvmlh = wrap_nvml_create();
 			}
 			else if (platformName == "AMD Accelerated Parallel Processing")
 			{
-				platformId = OPENCL_PLATFORM_AMD;
+				m_platformId = OPENCL_PLATFORM_AMD;
 				adlh = wrap_adl_create();
 #if defined(__linux)
 				sysfsh = wrap_amdsysfs_create();
@@ -589,7 +722,7 @@ bool CLMiner::init(const h256& seed)
 			}
 			else if (platformName == "Clover")
 			{
-				platformId = OPENCL_PLATFORM_CLOVER;
+				m_platformId = OPENCL_PLATFORM_CLOVER;
 			}
 		}
 
@@ -615,7 +748,7 @@ bool CLMiner::init(const h256& seed)
 		string clVer = device_version.substr(7, 3);
 		if (clVer == "1.0" || clVer == "1.1")
 		{
-			if (platformId == OPENCL_PLATFORM_CLOVER)
+			if (m_platformId == OPENCL_PLATFORM_CLOVER)
 			{
 				ETHCL_LOG("OpenCL " << clVer << " not supported, but platform Clover might work nevertheless. USE AT OWN RISK!");
 			}
@@ -627,23 +760,27 @@ bool CLMiner::init(const h256& seed)
 		}
 
 		char options[256];
-		int computeCapability = 0;
-		if (platformId == OPENCL_PLATFORM_NVIDIA) {
+		m_computeCapability = 0;
+		if (m_platformId == OPENCL_PLATFORM_NVIDIA) {
 			cl_uint computeCapabilityMajor;
 			cl_uint computeCapabilityMinor;
 			clGetDeviceInfo(device(), CL_DEVICE_COMPUTE_CAPABILITY_MAJOR_NV, sizeof(cl_uint), &computeCapabilityMajor, NULL);
 			clGetDeviceInfo(device(), CL_DEVICE_COMPUTE_CAPABILITY_MINOR_NV, sizeof(cl_uint), &computeCapabilityMinor, NULL);
 
-			computeCapability = computeCapabilityMajor * 10 + computeCapabilityMinor;
-			int maxregs = computeCapability >= 35 ? 72 : 63;
+			m_computeCapability = computeCapabilityMajor * 10 + computeCapabilityMinor;
+			int maxregs = m_computeCapability >= 35 ? 72 : 63;
 			sprintf(options, "-cl-nv-maxrregcount=%d", maxregs);
 		}
 		else {
 			sprintf(options, "%s", "");
 		}
+		m_buildOptions = options;
+		m_device = device;
 		// create context
 		m_context = cl::Context(vector<cl::Device>(&device, &device + 1));
-		m_queue = cl::CommandQueue(m_context, device);
+		m_queue = cl::CommandQueue(m_context, device, s_profiling ? CL_QUEUE_PROFILING_ENABLE : 0);
+		if (s_profiling)
+			m_profiler.reset(new CLProfiler(name()));
 
 		// make sure that global work size is evenly divisible by the local workgroup size
 		m_workgroupSize = s_workgroupSize;
@@ -651,157 +788,470 @@ bool CLMiner::init(const h256& seed)
 		if (m_globalWorkSize % m_workgroupSize != 0)
 			m_globalWorkSize = ((m_globalWorkSize / m_workgroupSize) + 1) * m_workgroupSize;
 
-		uint64_t dagSize = ethash_get_datasize(light->light->block_number);
-		uint32_t dagSize128 = (unsigned)(dagSize / ETHASH_MIX_BYTES);
-		uint32_t lightSize64 = (unsigned)(light->data().size() / sizeof(node));
-
-		// patch source code
-		// note: The kernels here are simply compiled version of the respective .cl kernels
-		// into a byte array by bin2h.cmake. There is no need to load the file by hand in runtime
-		// See libethash-cl/CMakeLists.txt: add_custom_command()
-		// TODO: Just use C++ raw string literal.
-		string code;
-
-		if(s_clKernelName == CLKernelName::Stable) {
-			cllog << "OpenCL kernel: Stable kernel";
-			code = string(CLMiner_kernel_stable, CLMiner_kernel_stable + sizeof(CLMiner_kernel_stable));
-		} else if ( s_clKernelName == CLKernelName::Unstable ) {
-			cllog << "OpenCL kernel: Unstable kernel";
-			code = string(CLMiner_kernel_unstable, CLMiner_kernel_unstable + sizeof(CLMiner_kernel_unstable));
-		} else if (s_clKernelName == CLKernelName::Custom) {
-			string kernelname = device.getInfo<CL_DEVICE_NAME>() + ".cl";
-			cllog << "OpenCL kernel: Custom '" + kernelname + "'";
-			std::ifstream t(kernelname);
-			if (t.good()) {
-				std::string ckernel;
-				t.seekg(0, std::ios::end);
-				ckernel.reserve(t.tellg());
-				t.seekg(0, std::ios::beg);
-				ckernel.assign((std::istreambuf_iterator<char>(t)),
-				std::istreambuf_iterator<char>());
-				code = ckernel;
-				cllog << "OpenCL kernel: Custom '" + kernelname +"'";
-			} else {
-				cllog << "OpenCL kernel: Custom '" + kernelname + "' not found";
-				std::ifstream t("kernel.cl");
-				if (t.good()) {
-					std::string ckernel;
-					t.seekg(0, std::ios::end);
-					ckernel.reserve(t.tellg());
-					t.seekg(0, std::ios::beg);
-					ckernel.assign((std::istreambuf_iterator<char>(t)),
-					std::istreambuf_iterator<char>());
-					code = ckernel;
-					cllog << "OpenCL kernel: Fallback 'kernel.cl'";
-				} else {
-					cllog << "OpenCL kernel: Fallback 'kernel.cl' not found";
-					cllog << "OpenCL kernel: Stable kernel";
-					code = string(CLMiner_kernel_stable, CLMiner_kernel_stable + sizeof(CLMiner_kernel_stable));
-				}
-			}
-		} else {
-			cllog << "OpenCL kernel: Default Stable kernel";
-			code = string(CLMiner_kernel_stable, CLMiner_kernel_stable + sizeof(CLMiner_kernel_stable));
-		}
+		// create buffer for header
+		ETHCL_LOG("Creating buffer for header.");
+		m_header = cl::Buffer(m_context, CL_MEM_READ_ONLY, 32);
 
-		cllog << "OpenCL kernel: GROUP_SIZE" << m_workgroupSize;
-		addDefinition(code, "GROUP_SIZE", m_workgroupSize);
-		cllog << "OpenCL kernel: DAG_SIZE" << dagSize128;
-		addDefinition(code, "DAG_SIZE", dagSize128);
-		cllog << "OpenCL kernel: LIGHT_SIZE" << lightSize64;
-		addDefinition(code, "LIGHT_SIZE", lightSize64);
-		cllog << "OpenCL kernel: ACCESSES" << ETHASH_ACCESSES;
-		addDefinition(code, "ACCESSES", ETHASH_ACCESSES);
-		cllog << "OpenCL kernel: MAX_OUTPUTS" << c_maxSearchResults;
-		addDefinition(code, "MAX_OUTPUTS", c_maxSearchResults);
-		cllog << "OpenCL kernel: PLATFORM" << platformId;
-		addDefinition(code, "PLATFORM", platformId);
-		cllog << "OpenCL kernel: COMPUTE" << computeCapability;
-		addDefinition(code, "COMPUTE", computeCapability);
-		cllog << "OpenCL kernel: THREADS_PER_HASH" << s_threadsPerHash;
-		addDefinition(code, "THREADS_PER_HASH", s_threadsPerHash);
-
-		// create miner OpenCL program
-		cl::Program::Sources sources{{code.data(), code.size()}};
-		cl::Program program(m_context, sources);
-		try
-		{
-			program.build({device}, options);
-			cllog << "Build info:" << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device);
-		}
-		catch (cl::Error const&)
+		// create mining buffers
+		ETHCL_LOG("Creating mining buffer");
+		m_searchBuffer = cl::Buffer(m_context, CL_MEM_WRITE_ONLY, (c_maxSearchResults + 1) * sizeof(uint32_t));
+	}
+	catch (cl::Error const& err)
+	{
+		cwarn << ethCLErrorHelper("OpenCL init failed", err);
+		publishError(ethCLErrorHelper("OpenCL init failed", err));
+		m_context = cl::Context();
+		return false;
+	}
+	return true;
+}
+
+string CLMiner::customKernelFile(string const& _device)
+{
+	for (string const& file: {_device + ".cl", string("kernel.cl")})
+		if (std::ifstream(file).good())
+			return file;
+	return string();
+}
+
+string CLMiner::kernelSource(CLKernelName _kernel, string const& _device)
+{
+	if (_kernel == CLKernelName::Unstable)
+	{
+		cllog << "OpenCL kernel: Unstable kernel";
+		return string(CLMiner_kernel_unstable, CLMiner_kernel_unstable + sizeof(CLMiner_kernel_unstable));
+	}
+	if (_kernel == CLKernelName::Custom)
+	{
+		string file = customKernelFile(_device);
+		if (!file.empty())
 		{
-			cwarn << "Build info:" << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device);
-			return false;
+			cllog << "OpenCL kernel: Custom '" + file + "'";
+			std::ifstream t(file);
+			return string(std::istreambuf_iterator<char>(t), std::istreambuf_iterator<char>());
 		}
+		cllog << "OpenCL kernel: Custom '" + _device + ".cl' and fallback 'kernel.cl' not found";
+	}
+	cllog << "OpenCL kernel: Stable kernel";
+	return string(CLMiner_kernel_stable, CLMiner_kernel_stable + sizeof(CLMiner_kernel_stable));
+}
 
-		//check whether the current dag fits in memory everytime we recreate the DAG
-		cl_ulong result = 0;
-		device.getInfo(CL_DEVICE_GLOBAL_MEM_SIZE, &result);
-		if (result < dagSize)
+void CLMiner::addDefinition(string& _source, char const* _id, unsigned _value)
+{
+	char buf[256];
+	sprintf(buf, "#define %s %uu\n", _id, _value);
+	_source.insert(_source.begin(), buf, buf + strlen(buf));
+}
+
+cl::Program CLMiner::buildProgram(uint32_t dagSize128, uint32_t lightSize64)
+{
+	// patch source code
+	// note: The kernels here are simply compiled version of the respective .cl kernels
+	// into a byte array by bin2h.cmake. There is no need to load the file by hand in runtime
+	// See libethash-cl/CMakeLists.txt: add_custom_command()
+	// TODO: Just use C++ raw string literal.
+	string code = kernelSource(s_clKernelName, m_device.getInfo<CL_DEVICE_NAME>());
+
+	cllog << "OpenCL kernel: GROUP_SIZE" << m_workgroupSize;
+	addDefinition(code, "GROUP_SIZE", m_workgroupSize);
+	cllog << "OpenCL kernel: DAG_SIZE" << dagSize128;
+	addDefinition(code, "DAG_SIZE", dagSize128);
+	cllog << "OpenCL kernel: LIGHT_SIZE" << lightSize64;
+	addDefinition(code, "LIGHT_SIZE", lightSize64);
+	cllog << "OpenCL kernel: ACCESSES" << ETHASH_ACCESSES;
+	addDefinition(code, "ACCESSES", ETHASH_ACCESSES);
+	cllog << "OpenCL kernel: MAX_OUTPUTS" << c_maxSearchResults;
+	addDefinition(code, "MAX_OUTPUTS", c_maxSearchResults);
+	cllog << "OpenCL kernel: PLATFORM" << m_platformId;
+	addDefinition(code, "PLATFORM", m_platformId);
+	cllog << "OpenCL kernel: COMPUTE" << m_computeCapability;
+	addDefinition(code, "COMPUTE", m_computeCapability);
+	cllog << "OpenCL kernel: THREADS_PER_HASH" << s_threadsPerHash;
+	addDefinition(code, "THREADS_PER_HASH", s_threadsPerHash);
+
+	// create miner OpenCL program
+	cl::Program::Sources sources{{code.data(), code.size()}};
+	cl::Program program(m_context, sources);
+	try
+	{
+		program.build({m_device}, m_buildOptions.c_str());
+		cllog << "Build info:" << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(m_device);
+	}
+	catch (cl::Error const&)
+	{
+		cwarn << "Build info:" << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(m_device);
+		throw;
+	}
+	return program;
+}
+
+void CLMiner::initEpoch(Epoch& _e, EthashAux::LightType const& _light, cl::Program const& _program)
+{
+	_e.lightData = _light;
+	_e.dagSize = ethash_get_datasize(_light->light->block_number);
+	cllog << "Creating light cache buffer, size" << _light->data().size();
+	_e.light = cl::Buffer(m_context, CL_MEM_READ_ONLY, _light->data().size());
+	cllog << "Creating DAG buffer, size" << _e.dagSize;
+	_e.dag = cl::Buffer(m_context, CL_MEM_READ_ONLY, _e.dagSize);
+	cllog << "Loading kernels";
+	_e.searchKernel = cl::Kernel(_program, "ethash_search");
+	_e.dagKernel = cl::Kernel(_program, "ethash_calculate_dag_item");
+	cllog << "Writing light cache buffer";
+	// Not blocking: the epoch keeps the light alive until the queue has read it.
+	m_queue.enqueueWriteBuffer(_e.light, CL_FALSE, 0, _light->data().size(), _light->data().data(), nullptr, profile("write"));
+
+	_e.dagKernel.setArg(1, _e.light);
+	_e.dagKernel.setArg(2, _e.dag);
+	_e.dagKernel.setArg(3, ~0u);
+
+	uint32_t const work = (uint32_t)(_e.dagSize / sizeof(node));
+	_e.dagChunks = work / m_globalWorkSize;
+	if (work % m_globalWorkSize > 0)
+		_e.dagChunks++;
+	_e.dagDone = 0;
+}
+
+void CLMiner::enqueueDagChunk(Epoch& _e)
+{
+	_e.dagKernel.setArg(0, _e.dagDone * m_globalWorkSize);
+	m_queue.enqueueNDRangeKernel(_e.dagKernel, cl::NullRange, m_globalWorkSize, m_workgroupSize, nullptr, profile("dag"));
+	++_e.dagDone;
+}
+
+void CLMiner::prepareNextEpoch(h256 const& _current)
+{
+	h256 seed = nextSeed();
+	if (!seed || seed == _current || seed == m_nextSkipped || (seed == m_next.seed && m_next.ready()))
+		return;
+	try
+	{
+		if (seed != m_next.seed)
 		{
-			cnote <<
-			"OpenCL device " << device.getInfo<CL_DEVICE_NAME>()
-							 << " has insufficient GPU memory." << result <<
-							 " bytes of memory found < " << dagSize << " bytes of memory required";	
-			return false;
+			dropNextEpoch();
+			// The current DAG stays in memory until the switch, so both have to fit.
+			uint64_t block = EthashAux::number(seed);
+			uint64_t need = m_dag.getInfo<CL_MEM_SIZE>() + m_light.getInfo<CL_MEM_SIZE>() + ethash_get_datasize(block) + ethash_get_cachesize(block);
+			if (m_device.getInfo<CL_DEVICE_GLOBAL_MEM_SIZE>() < need)
+			{
+				cllog << "Not enough device memory to generate the next DAG ahead," << need / 1024 / 1024 << "MB needed";
+				m_nextSkipped = seed;
+				return;
+			}
+			m_next.seed = seed;
 		}
-
-		// create buffer for dag
-		try
+		if (!m_next.dagChunks)
 		{
-			cllog << "Creating light cache buffer, size" << light->data().size();
-			m_light = cl::Buffer(m_context, CL_MEM_READ_ONLY, light->data().size());
-			cllog << "Creating DAG buffer, size" << dagSize;
-			m_dag = cl::Buffer(m_context, CL_MEM_READ_ONLY, dagSize);
-			cllog << "Loading kernels";
-			m_searchKernel = cl::Kernel(program, "ethash_search");
-			m_dagKernel = cl::Kernel(program, "ethash_calculate_dag_item");
-			cllog << "Writing light cache buffer";
-			m_queue.enqueueWriteBuffer(m_light, CL_TRUE, 0, light->data().size(), light->data().data());
+			// The light and the program are built on the CPU while the device keeps searching.
+			if (!m_nextProgram.valid())
+			{
+				uint64_t block = EthashAux::number(seed);
+				uint32_t dagSize128 = (unsigned)(ethash_get_datasize(block) / ETHASH_MIX_BYTES);
+				uint32_t lightSize64 = (unsigned)(ethash_get_cachesize(block) / sizeof(node));
+				// Taken before the build reads the source, so an edit meanwhile is not missed.
+				m_next.kernel = kernelStamp();
+				m_nextProgram = TaskPool::get().async([this, dagSize128, lightSize64]() { return buildProgram(dagSize128, lightSize64); }, TaskPriority::Low);
+			}
+			EthashAux::LightType light = EthashAux::prepareLight(seed);
+			if (!light || m_nextProgram.wait_for(chrono::seconds(0)) != future_status::ready)
+				return;
+			cl::Program program = m_nextProgram.get();
+			m_nextProgram = shared_future<cl::Program>();
+			initEpoch(m_next, light, program);
+			cllog << "Generating the DAG of the next epoch ahead," << m_next.dagChunks << "chunks";
+			return;
 		}
-		catch (cl::Error const& err)
+		// One chunk per batch, queued behind the search.
+		enqueueDagChunk(m_next);
+		if (m_next.ready())
+			cnote << "DAG of the next epoch ready";
+	}
+	catch (std::exception const& _e)
+	{
+		cwarn << "Generating the next DAG ahead failed:" << _e.what();
+		dropNextEpoch();
+		m_nextSkipped = seed;
+	}
+}
+
+void CLMiner::dropNextEpoch()
+{
+	// The program build may still use this miner.
+	if (m_nextProgram.valid())
+		m_nextProgram.wait();
+	m_nextProgram = shared_future<cl::Program>();
+	m_next = Epoch();
+}
+
+CLMiner::KernelStamp CLMiner::kernelStamp() const
+{
+	KernelStamp ret;
+	ret.file = customKernelFile(m_device.getInfo<CL_DEVICE_NAME>());
+	struct stat st;
+	if (!ret.file.empty() && stat(ret.file.c_str(), &st) == 0)
+	{
+		ret.modified = st.st_mtime;
+		ret.size = st.st_size;
+	}
+	return ret;
+}
+
+void CLMiner::reloadKernel(h256 const& _seed, uint64_t _target)
+{
+	if (s_clKernelName != CLKernelName::Custom || !m_dagSize)
+		return;
+
+	if (!m_reload.valid())
+	{
+		auto now = chrono::steady_clock::now();
+		if (now - m_lastKernelPoll < chrono::seconds(1))
+			return;
+		m_lastKernelPoll = now;
+		KernelStamp stamp = kernelStamp();
+		if (stamp.file.empty() || stamp == m_kernelStamp || stamp == m_rejectedStamp)
+			return;
+
+		cnote << name() << "custom kernel" << stamp.file << "changed, rebuilding it";
+		uint32_t dagSize128 = (uint32_t)(m_dagSize / ETHASH_MIX_BYTES);
+		uint32_t lightSize64 = (uint32_t)(ethash_get_cachesize(EthashAux::number(_seed)) / sizeof(node));
+		// At least 256 nonces, in whole work groups, for a couple of expected finds.
+		unsigned nonces = (256 + m_workgroupSize - 1) / m_workgroupSize * m_workgroupSize;
+		m_reload = TaskPool::get().async([this, stamp, _seed, dagSize128, lightSize64, nonces]() {
+			KernelReload r;
+			r.stamp = stamp;
+			r.seed = _seed;
+			r.nonces = nonces;
+			r.target = ~uint64_t(0) / (nonces / 2);
+			try
+			{
+				r.program = buildProgram(dagSize128, lightSize64);
+				// A range where every find fits in the output slots, so the whole set is compared.
+				EthashAux::LightType light = EthashAux::light(_seed);
+				for (unsigned attempt = 0; attempt < 16 && (r.found.empty() || r.found.size() > c_maxSearchResults); ++attempt)
+				{
+					r.found.clear();
+					r.header = h256::random();
+					r.startNonce = std::random_device()() * (uint64_t)nonces;
+					for (unsigned i = 0; i < nonces; ++i)
+						if ((uint64_t)(u64)((u256)light->compute(r.header, r.startNonce + i).value >> 192) < r.target)
+							r.found.push_back(r.startNonce + i);
+				}
+				if (r.found.empty() || r.found.size() > c_maxSearchResults)
+					r.error = "no validation range found";
+			}
+			catch (std::exception const& _e)
+			{
+				r.error = _e.what();
+			}
+			return r;
+		}, TaskPriority::Low);
+		return;
+	}
+
+	if (m_reload.wait_for(chrono::seconds(0)) != future_status::ready)
+		return;
+	KernelReload r = m_reload.get();
+	m_reload = shared_future<KernelReload>();
+	// Built for an epoch that is gone; the file is compared again against the running kernel.
+	if (r.seed != _seed)
+		return;
+
+	try
+	{
+		if (!r.error.empty())
+			BOOST_THROW_EXCEPTION(std::runtime_error(r.error));
+
+		cl::Kernel kernel(r.program, "ethash_search");
+		cl::Buffer header(m_context, CL_MEM_READ_ONLY, 32);
+		cl::Buffer output(m_context, CL_MEM_WRITE_ONLY, (c_maxSearchResults + 1) * sizeof(uint32_t));
+		uint32_t const zero = 0;
+		m_queue.enqueueWriteBuffer(header, CL_FALSE, 0, r.header.size, r.header.data());
+		m_queue.enqueueWriteBuffer(output, CL_FALSE, 0, sizeof(zero), &zero);
+		kernel.setArg(0, output);
+		kernel.setArg(1, header);
+		kernel.setArg(2, m_dag);
+		kernel.setArg(3, r.startNonce);
+		kernel.setArg(4, r.target);
+		kernel.setArg(5, ~0u);
+		m_queue.enqueueNDRangeKernel(kernel, cl::NullRange, r.nonces, m_workgroupSize);
+		uint32_t results[c_maxSearchResults + 1];
+		m_queue.enqueueReadBuffer(output, CL_TRUE, 0, sizeof(results), &results);
+
+		vector<uint64_t> found;
+		for (uint32_t i = 0; i < min<uint32_t>(results[0], c_maxSearchResults); ++i)
+			found.push_back(r.startNonce + results[i + 1]);
+		sort(found.begin(), found.end());
+		if (results[0] != r.found.size() || found != r.found)
 		{
-			cwarn << ethCLErrorHelper("Creating DAG buffer failed", err);
-			return false;
+			cwarn << name() << "reloaded kernel found" << results[0] << "nonces," << r.found.size() << "expected, keeping the running kernel";
+			publishError("Reloaded kernel " + r.stamp.file + " failed validation");
+			m_rejectedStamp = r.stamp;
+			return;
 		}
-		// create buffer for header
-		ETHCL_LOG("Creating buffer for header.");
-		m_header = cl::Buffer(m_context, CL_MEM_READ_ONLY, 32);
 
-		m_searchKernel.setArg(1, m_header);
-		m_searchKernel.setArg(2, m_dag);
-		m_searchKernel.setArg(5, ~0u);  // Pass this to stop the compiler unrolling the loops.
+		kernel.setArg(0, m_searchBuffer);
+		kernel.setArg(1, m_header);
+		kernel.setArg(4, _target);
+		m_searchKernel = kernel;
+		m_kernelStamp = r.stamp;
+		// The next epoch was prepared from the previous source.
+		dropNextEpoch();
+		cnote << name() << "switched to the reloaded kernel" << r.stamp.file;
+	}
+	catch (std::exception const& _e)
+	{
+		cwarn << name() << "reloading kernel" << r.stamp.file << "failed, keeping the running kernel:" << _e.what();
+		m_rejectedStamp = r.stamp;
+	}
+}
 
-		// create mining buffers
-		ETHCL_LOG("Creating mining buffer");
-		m_searchBuffer = cl::Buffer(m_context, CL_MEM_WRITE_ONLY, (c_maxSearchResults + 1) * sizeof(uint32_t));
+double CLMiner::probeBandwidth(cl::Context const& _context, cl::Device const& _device, cl::Buffer const& _mem, uint64_t _bytes)
+{
+	if (_device.getInfo<CL_DEVICE_TYPE>() & CL_DEVICE_TYPE_CPU)
+		return probeHostBandwidth();
+
+	string code(CLMiner_probe, CLMiner_probe + sizeof(CLMiner_probe));
+	cl::Program::Sources sources{{code.data(), code.size()}};
+	cl::Program program(_context, sources);
+	program.build({_device});
+	cl::Kernel kernel(program, "bandwidth_probe");
+	cl::Buffer out(_context, CL_MEM_WRITE_ONLY, sizeof(cl_ulong));
+	cl::CommandQueue queue(_context, _device);
+
+	// Enough groups in flight to hide the latency, like the search kernel's default work size.
+	unsigned const rounds = 64;
+	size_t local = max<size_t>(8, min<size_t>(256, kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(_device)) & ~size_t(7));
+	size_t global = _device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>() * 2048;
+	global = (global + local - 1) / local * local;
+	kernel.setArg(0, _mem);
+	kernel.setArg(1, (uint32_t)(_bytes / ETHASH_MIX_BYTES));
+	kernel.setArg(2, rounds);
+	kernel.setArg(3, out);
+
+	// The first launch warms up the queue and the caches of the page tables.
+	queue.enqueueNDRangeKernel(kernel, cl::NullRange, global, local);
+	queue.finish();
+
+	unsigned launches = 0;
+	auto start = chrono::steady_clock::now();
+	do
+	{
+		for (unsigned i = 0; i < 4; ++i)
+			queue.enqueueNDRangeKernel(kernel, cl::NullRange, global, local);
+		queue.finish();
+		launches += 4;
+	}
+	while (chrono::steady_clock::now() - start < chrono::milliseconds(200));
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
 
-		uint32_t const work = (uint32_t)(dagSize / sizeof(node));
-		uint32_t fullRuns = work / m_globalWorkSize;
-		uint32_t const restWork = work % m_globalWorkSize;
-		if (restWork > 0) fullRuns++;
+	// Every group of 8 work items reads one line per round.
+	return (double)launches * (global / 8) * rounds * ETHASH_MIX_BYTES / seconds;
+}
 
-		m_dagKernel.setArg(1, m_light);
-		m_dagKernel.setArg(2, m_dag);
-		m_dagKernel.setArg(3, ~0u);
+bool CLMiner::init(const h256& seed)
+{
+	try
+	{
+		if (!m_context() && !initDevice())
+			return false;
 
+		bool ahead = m_next.seed == seed && m_next.dagChunks;
+		if (!ahead)
+		{
+			// Usually already building since the farm received the work.
+			EthashAux::prepareLight(seed, TaskPriority::High);
+			uint64_t block = EthashAux::number(seed);
+			uint64_t dagSize = ethash_get_datasize(block);
+
+			// A program being built ahead for this epoch is still good.
+			cl::Program program;
+			KernelStamp stamp = m_next.kernel;
+			if (m_next.seed == seed && m_nextProgram.valid())
+				program = m_nextProgram.get();
+			dropNextEpoch();
+
+			//check whether the current dag fits in memory everytime we recreate the DAG
+			cl_ulong result = 0;
+			m_device.getInfo(CL_DEVICE_GLOBAL_MEM_SIZE, &result);
+			if (result < dagSize)
+			{
+				cnote <<
+				"OpenCL device " << m_device.getInfo<CL_DEVICE_NAME>()
+								 << " has insufficient GPU memory." << result <<
+								 " bytes of memory found < " << dagSize << " bytes of memory required";	
+				return false;
+			}
+
+			// Free the old DAG before allocating the new one.
+			m_searchKernel = cl::Kernel();
+			m_dagKernel = cl::Kernel();
+			m_dag = cl::Buffer();
+			m_light = cl::Buffer();
+			m_dagSize = 0;
+
+			if (!program())
+			{
+				// Compiles while the light is being built.
+				StartupPhase phase(name() + " program");
+				stamp = kernelStamp();
+				program = buildProgram((unsigned)(dagSize / ETHASH_MIX_BYTES), (unsigned)(ethash_get_cachesize(block) / sizeof(node)));
+			}
+			EthashAux::LightType light = EthashAux::light(seed);
+			try
+			{
+				m_next.seed = seed;
+				m_next.kernel = stamp;
+				initEpoch(m_next, light, program);
+			}
+			catch (cl::Error const& err)
+			{
+				cwarn << ethCLErrorHelper("Creating DAG buffer failed", err);
+				publishError(ethCLErrorHelper("Creating DAG buffer failed", err));
+				dropNextEpoch();
+				return false;
+			}
+		}
+		else
+			cnote << "Switching to the DAG generated ahead," << m_next.dagDone << "of" << m_next.dagChunks << "chunks done";
+
+		// Whatever was not generated ahead is generated now, with the device idle.
+		StartupPhase phase(name() + " DAG");
 		auto startDAG = std::chrono::steady_clock::now();
-		for (uint32_t i = 0; i < fullRuns; i++)
+		while (!m_next.ready())
 		{
-			m_dagKernel.setArg(0, i * m_globalWorkSize);
-			m_queue.enqueueNDRangeKernel(m_dagKernel, cl::NullRange, m_globalWorkSize, m_workgroupSize);
+			enqueueDagChunk(m_next);
 			m_queue.finish();
+			if (m_profiler)
+				m_profiler->collect();
+			if (!publishDagProgress(m_next.dagDone, m_next.dagChunks))
+			{
+				cllog << "DAG generation cancelled for a new epoch";
+				dropNextEpoch();
+				return false;
+			}
 		}
 		auto endDAG = std::chrono::steady_clock::now();
 
+		m_searchKernel = m_next.searchKernel;
+		m_dagKernel = m_next.dagKernel;
+		m_dag = m_next.dag;
+		m_light = m_next.light;
+		m_dagSize = m_next.dagSize;
+		m_kernelStamp = m_next.kernel;
+		m_next = Epoch();
+
+		m_searchKernel.setArg(1, m_header);
+		m_searchKernel.setArg(2, m_dag);
+		m_searchKernel.setArg(5, ~0u);  // Pass this to stop the compiler unrolling the loops.
+
 		auto dagTime = std::chrono::duration_cast<std::chrono::milliseconds>(endDAG-startDAG);
-		float gb = (float)dagSize / (1024 * 1024 * 1024);
+		metrics().dagTime.set(std::chrono::duration<double>(endDAG - startDAG).count());
+		float gb = (float)m_dagSize / (1024 * 1024 * 1024);
 		cnote << gb << " GB of DAG data generated in" << dagTime.count() << "ms.";
 	}
 	catch (cl::Error const& err)
 	{
 		cwarn << ethCLErrorHelper("OpenCL init failed", err);
+		publishError(ethCLErrorHelper("OpenCL init failed", err));
 		return false;
 	}
 	return true;
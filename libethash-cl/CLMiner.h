@@ -5,6 +5,10 @@
 
 #pragma once
 
+#include <ctime>
+#include <deque>
+#include <future>
+#include <libdevcore/Metrics.h>
 #include <libdevcore/Worker.h>
 #include <libethcore/EthashAux.h>
 #include <libethcore/Miner.h>
@@ -49,6 +53,40 @@ enum CLKernelName {
 	Custom,
 };
 
+/**
+ * @brief Aggregates OpenCL profiling events of one device into per-operation histograms.
+ * Commands are registered when enqueued and recorded, in queue order, once a blocking call
+ * guarantees they have completed. Requires a queue created with CL_QUEUE_PROFILING_ENABLE.
+ */
+class CLProfiler
+{
+public:
+	explicit CLProfiler(std::string const& _device): m_device(_device) {}
+
+	/// @returns the event to pass to the enqueue call of operation @a _op ("search", "dag", "read", "write").
+	cl::Event* add(char const* _op);
+
+	/// Records all registered commands. Call only after the queue has drained up to the last one.
+	void collect();
+
+private:
+	struct Op
+	{
+		MetricHistogram* latency;	///< Queued to start.
+		MetricHistogram* exec;		///< Start to end.
+	};
+
+	Op& op(char const* _op);
+
+	std::string m_device;
+	std::map<std::string, Op> m_ops;
+	std::deque<std::pair<char const*, cl::Event>> m_pending;
+	cl_ulong m_lastEnd = 0;
+	MetricHistogram& m_idle = MetricsRegistry::get().histogram("ethminer_cl_idle_seconds", "Device idle time between two profiled commands.", exponentialBuckets(0.000001, 4, 12), metricLabel("device", m_device));
+	MetricCounter& m_busyNs = MetricsRegistry::get().counter("ethminer_cl_busy_nanoseconds_total", "Device time spent executing profiled commands.", metricLabel("device", m_device));
+	MetricCounter& m_idleNs = MetricsRegistry::get().counter("ethminer_cl_idle_nanoseconds_total", "Device time spent idle between profiled commands.", metricLabel("device", m_device));
+};
+
 class CLMiner: public Miner
 {
 public:
@@ -78,6 +116,11 @@ public:
 	);
 	static void setNumInstances(unsigned _instances) { s_numInstances = std::min<unsigned>(_instances, getNumDevices()); }
 	static void setThreadsPerHash(unsigned _threadsPerHash){s_threadsPerHash = _threadsPerHash; }
+	static void setProfiling(bool _profiling) { s_profiling = _profiling; }
+#if defined(__linux)
+	/// Reads the AMD sysfs sensors below @a _root instead of /sys, e.g. to run against a fake tree.
+	static void setSysfsRoot(std::string const& _root) { wrap_amdsysfs_set_root(_root.c_str()); }
+#endif
 	static void setDevices(unsigned * _devices, unsigned _selectedDeviceCount)
 	{
 		for (unsigned i = 0; i < _selectedDeviceCount; i++)
@@ -99,16 +142,95 @@ public:
 			s_clKernelName = CLKernelName::Stable;
 		}
 	}
-	HwMonitor hwmon() override;
+	/// @returns the file the custom kernel of the device named @a _device is read from,
+	/// "<device>.cl" or else "kernel.cl", empty if neither exists.
+	static std::string customKernelFile(std::string const& _device);
+	/// @returns the source of kernel @a _kernel, the stable one if a custom kernel is not found.
+	static std::string kernelSource(CLKernelName _kernel, std::string const& _device);
+	/// Prepends "#define @a _id @a _value" to the kernel source.
+	static void addDefinition(std::string& _source, char const* _id, unsigned _value);
+
 	string Name() override;
 protected:
 	void kick_miner() override;
+	HwMonitor readHwmon() override;
 
 private:
 	void workLoop() override;
 	void report(uint64_t _nonce, WorkPackage const& _w);
 
+	/// Identifies the version of a custom kernel file, to notice edits.
+	struct KernelStamp
+	{
+		std::string file;
+		std::time_t modified = 0;
+		uint64_t size = 0;
+
+		bool operator==(KernelStamp const& _s) const { return file == _s.file && modified == _s.modified && size == _s.size; }
+		bool operator!=(KernelStamp const& _s) const { return !operator==(_s); }
+	};
+
+	/// The buffers and kernels of one epoch, possibly still being generated.
+	struct Epoch
+	{
+		h256 seed;
+		cl::Kernel searchKernel;
+		cl::Kernel dagKernel;
+		cl::Buffer dag;
+		cl::Buffer light;
+		EthashAux::LightType lightData;	///< Kept until the non-blocking light upload completed.
+		uint64_t dagSize = 0;
+		uint32_t dagChunks = 0;
+		uint32_t dagDone = 0;
+		KernelStamp kernel;				///< Custom kernel file the program was built from.
+
+		bool ready() const { return dagChunks && dagDone == dagChunks; }
+	};
+
+	/// A custom kernel rebuilt in the background, with the nonces the host expects it to find.
+	struct KernelReload
+	{
+		KernelStamp stamp;				///< Taken before the source was read.
+		h256 seed;
+		cl::Program program;
+		h256 header;
+		uint64_t startNonce = 0;
+		uint64_t target = 0;
+		unsigned nonces = 0;
+		std::vector<uint64_t> found;	///< Nonces of the range meeting the target, computed on the host.
+		std::string error;				///< Why the build or the host computation failed.
+	};
+
 	bool init(const h256& seed);
+	/// Sets up the context, queue and buffers shared by all epochs. Done once.
+	bool initDevice();
+	/// Builds the kernels for a DAG of @a dagSize128 mixes and a light of @a lightSize64 nodes.
+	cl::Program buildProgram(uint32_t dagSize128, uint32_t lightSize64);
+	/// Allocates the buffers of @a _e and uploads the light, without generating the DAG.
+	void initEpoch(Epoch& _e, EthashAux::LightType const& _light, cl::Program const& _program);
+	void enqueueDagChunk(Epoch& _e);
+	/// Advances the generation of the next epoch's DAG by at most one chunk, between two searches.
+	void prepareNextEpoch(h256 const& _current);
+	void dropNextEpoch();
+
+	/// @returns the stamp of the custom kernel file of this device, an empty one if there is none.
+	KernelStamp kernelStamp() const;
+	/**
+	 * @brief Rebuilds the custom kernel in the background once its file changed, and swaps it in,
+	 * keeping the DAG, when it finds the same nonces as the host. Called between two searches.
+	 * @param _target Target of the current work, set on the swapped-in kernel.
+	 */
+	void reloadKernel(h256 const& _seed, uint64_t _target);
+
+	/**
+	 * @brief Measures the random-read bandwidth of @a _device, reading @a _bytes of @a _mem,
+	 * which must have been written, e.g. the DAG. CPU devices are measured with the host probe instead.
+	 * @returns bytes per second.
+	 */
+	static double probeBandwidth(cl::Context const& _context, cl::Device const& _device, cl::Buffer const& _mem, uint64_t _bytes);
+
+	/// @returns the profiling event for a command of operation @a _op, or null when not profiling.
+	cl::Event* profile(char const* _op) { return m_profiler ? m_profiler->add(_op) : nullptr; }
 
 	cl::Context m_context;
 	cl::CommandQueue m_queue;
@@ -118,12 +240,29 @@ private:
 	cl::Buffer m_light;
 	cl::Buffer m_header;
 	cl::Buffer m_searchBuffer;
+	uint64_t m_dagSize = 0;
 	unsigned m_globalWorkSize = 0;
 	unsigned m_workgroupSize = 0;
+	std::unique_ptr<CLProfiler> m_profiler;
+
+	cl::Device m_device;
+	std::string m_buildOptions;
+	int m_platformId = 0;
+	int m_computeCapability = 0;
+
+	Epoch m_next;							///< The next epoch's DAG, generated ahead.
+	std::shared_future<cl::Program> m_nextProgram;
+	h256 m_nextSkipped;						///< Next seed that could not be generated ahead.
+
+	KernelStamp m_kernelStamp;				///< Custom kernel file the running search kernel was built from.
+	KernelStamp m_rejectedStamp;			///< Last version that failed to build or validate, not retried.
+	std::shared_future<KernelReload> m_reload;
+	std::chrono::steady_clock::time_point m_lastKernelPoll;
 
 	static unsigned s_platformId;
 	static unsigned s_numInstances;
 	static unsigned s_threadsPerHash;
+	static bool s_profiling;
 	static CLKernelName s_clKernelName;
 	static int s_devices[16];
 
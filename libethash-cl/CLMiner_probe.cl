@@ -0,0 +1,29 @@
+// Random-read bandwidth probe.
+// Each group of 8 work items reads one 128-byte line per round at a random offset of g_mem,
+// 16 bytes per work item, the way the search kernel reads the DAG with THREADS_PER_HASH 8.
+
+__kernel void bandwidth_probe(
+	__global ulong2 const* g_mem,
+	uint g_lines,
+	uint g_rounds,
+	__global ulong* g_out
+	)
+{
+	uint const gid = get_global_id(0);
+	uint const lane = gid & 7;
+	// xorshift never leaves a non-zero state, and all lanes of a group follow the same one.
+	uint x = ((gid >> 3) * 2654435761u) | 1u;
+	ulong2 acc = (ulong2)(0, 0);
+
+	for (uint i = 0; i < g_rounds; ++i)
+	{
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		acc ^= g_mem[(ulong)(x % g_lines) * 8 + lane];
+	}
+
+	// Practically never true, keeps the reads from being optimized away.
+	if (acc.x == 0x9e3779b97f4a7c15UL && acc.y == 0x9e3779b97f4a7c15UL)
+		g_out[0] = gid;
+}
@@ -19,6 +19,7 @@ along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
 #undef max
 
 #include "CUDAMiner.h"
+#include <libethash/internal.h>
 
 using namespace std;
 using namespace dev;
@@ -47,15 +48,13 @@ CUDAMiner::CUDAMiner(FarmFace& _farm, unsigned _index) :
 CUDAMiner::~CUDAMiner()
 {
 	stopWorking();
+	drainTasks();
 	kick_miner();
 }
 
 bool CUDAMiner::init(const h256& seed)
 {
 	try {
-		if (s_dagLoadMode == DAG_LOAD_MODE_SEQUENTIAL)
-			while (s_dagLoadIndex < index)
-				this_thread::sleep_for(chrono::milliseconds(100));
 		unsigned device = s_devices[index] > -1 ? s_devices[index] : index;
 
 		cnote << "Initialising miner " << index;
@@ -64,8 +63,12 @@ bool CUDAMiner::init(const h256& seed)
 		light = EthashAux::light(seed);
 		bytesConstRef lightData = light->data();
 
+		auto startDAG = std::chrono::steady_clock::now();
+		publishDagProgress(0, 1);
 		cuda_init(getNumDevices(), light->light, lightData.data(), lightData.size(), 
 			device, (s_dagLoadMode == DAG_LOAD_MODE_SINGLE), s_dagInHostMemory, s_dagCreateDevice);
+		metrics().dagTime.set(std::chrono::duration<double>(std::chrono::steady_clock::now() - startDAG).count());
+		publishDagProgress(1, 1);
 		s_dagLoadIndex++;
     
 		if (s_dagLoadMode == DAG_LOAD_MODE_SINGLE)
@@ -83,6 +86,7 @@ bool CUDAMiner::init(const h256& seed)
 	catch (std::runtime_error const& _e)
 	{
 		cwarn << "Error CUDA mining: " << _e.what();
+		publishError(_e.what());
 		return false;
 	}
 }
@@ -98,8 +102,9 @@ void CUDAMiner::workLoop()
 		{
 	                // take local copy of work since it may end up being overwritten.
 			const WorkPackage w = work();
+			bool regenerate = dagCorrupted(w.seed);
 			
-			if (current.header != w.header || current.seed != w.seed)
+			if (current.header != w.header || current.seed != w.seed || regenerate)
 			{
 				if(!w || w.header == h256())
 				{
@@ -107,9 +112,22 @@ void CUDAMiner::workLoop()
 					std::this_thread::sleep_for(std::chrono::seconds(3));
 					continue;
 				}
-				if (current.seed != w.seed)
+				if (current.seed != w.seed || regenerate)
 				{
-					if(!init(w.seed))
+					// In single mode the other devices copy the DAG of the creating device and
+					// must not hold a slot while they wait for it.
+					unsigned device = s_devices[index] > -1 ? s_devices[index] : index;
+					if ((s_dagLoadMode != DAG_LOAD_MODE_SINGLE || device == s_dagCreateDevice) && !beginDag(w.seed))
+					{
+						// Replaced by another epoch while queued, pick up the new work.
+						if (shouldStop())
+							break;
+						continue;
+					}
+					bool ok = init(w.seed);
+					if (!endDag())
+						continue;
+					if (!ok)
 						break;
 				}
 				current = w;
@@ -120,6 +138,16 @@ void CUDAMiner::workLoop()
 				startN = current.startNonce | ((uint64_t)index << (64 - 4 - current.exSizeBits)); // this can support up to 16 devices
 			search(current.header.data(), upper64OfBoundary, (current.exSizeBits >= 0), startN, w);
 
+			// Checked between two jobs, search() keeps the device busy until the work changes.
+			vector<uint32_t> sample = m_dag ? dagCheckSample((uint64_t)m_dag_size * sizeof(hash128_t)) : vector<uint32_t>();
+			if (!sample.empty())
+			{
+				bytes items(sample.size() * sizeof(node));
+				for (size_t i = 0; i < sample.size(); ++i)
+					CUDA_SAFE_CALL(cudaMemcpy(items.data() + i * sizeof(node), reinterpret_cast<uint8_t const*>(m_dag) + (size_t)sample[i] * sizeof(node), sizeof(node), cudaMemcpyDeviceToHost));
+				verifyDagSample(current.seed, sample, items);
+			}
+
 			// Check if we should stop.
 			if (shouldStop())
 			{
@@ -130,6 +158,8 @@ void CUDAMiner::workLoop()
 	catch (std::runtime_error const& _e)
 	{
 		cwarn << "Error CUDA mining: " << _e.what();
+		publishError(_e.what());
+		recordFault(DeviceHealth::KernelError, _e.what());
 	}
 }
 
@@ -192,15 +222,21 @@ void CUDAMiner::listDevices()
 	}
 }
 
-HwMonitor CUDAMiner::hwmon()
+HwMonitor CUDAMiner::readHwmon()
 {
 	dev::eth::HwMonitor hw;
 	if (nvmlh) {
-		unsigned int tempC = 0, fanpcnt = 0;
-		wrap_nvml_get_tempC(nvmlh, nvmlh->cuda_nvml_device_id[m_device_num], &tempC);
-		wrap_nvml_get_fanpcnt(nvmlh, nvmlh->cuda_nvml_device_id[m_device_num], &fanpcnt);
+		unsigned int tempC = 0, fanpcnt = 0, powerMW = 0, coreMHz = 0, memMHz = 0;
+		int nvmlIndex = nvmlh->cuda_nvml_device_id[m_device_num];
+		wrap_nvml_get_tempC(nvmlh, nvmlIndex, &tempC);
+		wrap_nvml_get_fanpcnt(nvmlh, nvmlIndex, &fanpcnt);
+		wrap_nvml_get_power_usage(nvmlh, nvmlIndex, &powerMW);
+		wrap_nvml_get_clocks(nvmlh, nvmlIndex, &coreMHz, &memMHz);
 		hw.tempC = tempC;
 		hw.fanP = fanpcnt;
+		hw.powerW = powerMW / 1000.0;
+		hw.coreMHz = coreMHz;
+		hw.memMHz = memMHz;
 	}
 	return hw;
 }
@@ -470,7 +506,10 @@ void CUDAMiner::search(
 				m_search_buf[i]->count = 0;
 		}
 	}
+	if (initialize)
+		metrics().workSwitch.observe(std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - workSwitchStart).count());
 	uint64_t batch_size = s_gridSize * s_blockSize;
+	std::chrono::steady_clock::time_point lastBatch;
 	while (true)
 	{
 		m_current_index++;
@@ -485,6 +524,14 @@ void CUDAMiner::search(
 		if (m_current_index >= s_numStreams)
 		{
 			CUDA_SAFE_CALL(cudaStreamSynchronize(stream));
+			DEV_TRACE_INSTANT("kernel_complete", nonce_base);
+			auto batchEnd = std::chrono::steady_clock::now();
+			if (lastBatch != std::chrono::steady_clock::time_point())
+			{
+				metrics().kernelTime.observe(std::chrono::duration<double>(batchEnd - lastBatch).count());
+				batchEnd += thermalThrottle(batchEnd - lastBatch);
+			}
+			lastBatch = batchEnd;
 			found_count = buffer->count;
 			if (found_count) {
 				buffer->count = 0;
@@ -503,6 +550,7 @@ void CUDAMiner::search(
 				}
 			}
 		}
+		DEV_TRACE_INSTANT("kernel_enqueue", m_current_nonce);
 		run_ethash_search(s_gridSize, s_blockSize, stream, buffer, m_current_nonce, m_parallelHash);
 		if (m_current_index >= s_numStreams)
 		{
@@ -512,7 +560,9 @@ void CUDAMiner::search(
 						Solution{nonces[i],
 						*((const h256 *)mixes[i]),
 						w,
-						m_abort});
+						m_abort,
+						(unsigned)index,
+						std::chrono::steady_clock::now()});
 			addHashCount(batch_size);
 			bool t = true;
 			if (m_abort.compare_exchange_strong(t, false))
@@ -60,7 +60,6 @@ public:
 		);
 	static void setNumInstances(unsigned _instances);
 	static void setDevices(const unsigned* _devices, unsigned _selectedDeviceCount);
-	HwMonitor hwmon() override;
 	static bool cuda_configureGPU(
 		size_t numDevices,
 		const int* _devices,
@@ -101,6 +100,7 @@ public:
 
 protected:
 	void kick_miner() override;
+	HwMonitor readHwmon() override;
 
 private:
 	atomic<bool> m_abort = {false};
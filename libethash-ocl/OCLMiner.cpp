@@ -210,12 +210,21 @@ void addDefinition(string& _source, char const* _id, unsigned _value)
 	_source.insert(_source.begin(), buf, buf + strlen(buf));
 }
 
+// Enumeration is slow on some drivers and every device and option needs it: it is done once
+// and shared.
+Mutex x_enumeration;
+
 std::vector<cl::Platform> getPlatforms()
 {
-	vector<cl::Platform> platforms;
+	static vector<cl::Platform> s_platforms;
+	static bool s_enumerated = false;
+	Guard l(x_enumeration);
+	if (s_enumerated)
+		return s_platforms;
+	StartupPhase phase("platform enumeration");
 	try
 	{
-		cl::Platform::get(&platforms);
+		cl::Platform::get(&s_platforms);
 	}
 	catch(cl::Error const& err)
 	{
@@ -226,13 +235,20 @@ std::vector<cl::Platform> getPlatforms()
 #endif
 			throw err;
 	}
-	return platforms;
+	s_enumerated = true;
+	return s_platforms;
 }
 
 std::vector<cl::Device> getDevices(std::vector<cl::Platform> const& _platforms, unsigned _platformId)
 {
-	vector<cl::Device> devices;
+	static map<size_t, vector<cl::Device>> s_platformDevices;
 	size_t platform_num = min<size_t>(_platformId, _platforms.size() - 1);
+	Guard l(x_enumeration);
+	auto it = s_platformDevices.find(platform_num);
+	if (it != s_platformDevices.end())
+		return it->second;
+	StartupPhase phase("device enumeration");
+	vector<cl::Device> devices;
 	try
 	{
 		_platforms[platform_num].getDevices(
@@ -246,6 +262,7 @@ std::vector<cl::Device> getDevices(std::vector<cl::Platform> const& _platforms,
 		if (err.err() != CL_DEVICE_NOT_FOUND)
 			throw err;
 	}
+	s_platformDevices[platform_num] = devices;
 	return devices;
 }
 
@@ -264,6 +281,8 @@ OCLMiner::OCLMiner(FarmFace& _farm, unsigned _index):
 
 OCLMiner::~OCLMiner()
 {
+	stopWorking();
+	drainTasks();
 	kick_miner();
 }
 
@@ -271,13 +290,7 @@ void OCLMiner::report(uint64_t _nonce, WorkPackage const& _w)
 {
 	assert(_nonce != 0);
 	// TODO: Why re-evaluating?
-	Result r = EthashAux::eval(_w.seed, _w.header, _nonce);
-	if (r.value < _w.boundary)
-		farm.submitProof(Solution{_nonce, r.mixHash, _w, false});
-	else {
-		farm.failedSolution();
-		cwarn << "FAILURE: FPGA gave incorrect result!";
-	}
+	verifyAsync(_nonce, _w, "FPGA");
 }
 
 void OCLMiner::workLoop()
@@ -292,6 +305,9 @@ void OCLMiner::workLoop()
 	current.header = h256{1u};
 	current.seed = h256{1u};
 
+	// Completion time of the previous search batch, unset across work switches.
+	std::chrono::steady_clock::time_point lastBatch;
+
 	try {
 		while (true)
 		{
@@ -313,15 +329,18 @@ void OCLMiner::workLoop()
 
 				if (current.seed != w.seed)
 				{
-					if (s_dagLoadMode == DAG_LOAD_MODE_SEQUENTIAL)
+					if (!beginDag(w.seed))
 					{
-						while (s_dagLoadIndex < index)
-							this_thread::sleep_for(chrono::seconds(1));
-						++s_dagLoadIndex;
+						// Replaced by another epoch while queued, pick up the new work.
+						if (shouldStop())
+							break;
+						continue;
 					}
 
 					cllog << "New seed" << w.seed;
 					init(w.seed);
+					if (!endDag())
+						continue;
 				}
 
 				// Upper 64 bits of the boundary.
@@ -344,13 +363,27 @@ void OCLMiner::workLoop()
 				auto switchEnd = std::chrono::high_resolution_clock::now();
 				auto globalSwitchTime = std::chrono::duration_cast<std::chrono::milliseconds>(switchEnd - workSwitchStart).count();
 				auto localSwitchTime = std::chrono::duration_cast<std::chrono::microseconds>(switchEnd - localSwitchStart).count();
-				cllog << "Switch time" << globalSwitchTime << "ms /" << localSwitchTime << "us";
+				clog_limited(CLChannel, 10, 60000) << "Switch time" << globalSwitchTime << "ms /" << localSwitchTime << "us";
+				metrics().workSwitch.observe(std::chrono::duration<double>(switchEnd - workSwitchStart).count());
+				lastBatch = std::chrono::steady_clock::time_point();
 			}
 
 			// Read results.
 			// TODO: could use pinned host pointer instead.
 			uint32_t results[c_maxSearchResults + 1];
-			m_queue.enqueueReadBuffer(m_searchBuffer, CL_TRUE, 0, sizeof(results), &results);
+			{
+				DEV_TRACE_SCOPE("result_read", 0);
+				m_queue.enqueueReadBuffer(m_searchBuffer, CL_TRUE, 0, sizeof(results), &results);
+			}
+			DEV_TRACE_INSTANT("kernel_complete", current.startNonce);
+
+			auto batchEnd = std::chrono::steady_clock::now();
+			if (lastBatch != std::chrono::steady_clock::time_point())
+			{
+				metrics().kernelTime.observe(std::chrono::duration<double>(batchEnd - lastBatch).count());
+				batchEnd += thermalThrottle(batchEnd - lastBatch);
+			}
+			lastBatch = batchEnd;
 
 			uint64_t nonce = 0;
 			if (results[0] > 0)
@@ -363,6 +396,7 @@ void OCLMiner::workLoop()
 
 			// Run the kernel.
 			m_searchKernel.setArg(3, startNonce);
+			DEV_TRACE_INSTANT("kernel_enqueue", startNonce);
 			m_queue.enqueueNDRangeKernel(m_searchKernel, cl::NullRange, m_globalWorkSize, m_workgroupSize);
 
 			// Report results while the kernel is running.
@@ -391,6 +425,7 @@ void OCLMiner::workLoop()
 	catch (cl::Error const& _e)
 	{
 		cwarn << ethCLErrorHelper("OpenCL Error", _e);
+		publishError(ethCLErrorHelper("OpenCL Error", _e));
 	}
 }
 
@@ -441,12 +476,8 @@ void OCLMiner::listDevices()
 							//outString += "\tCU: " + to_string(devices[i].getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>());
 							//outString += "\tWS: " + to_string(devices[i].getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>());
 							outString += "\t" + to_string(devices[i].getInfo<CL_DEVICE_MAX_CLOCK_FREQUENCY>()) + "Hz";
-							outString += "\t(" + devices[i].getInfo<CL_DEVICE_VENDOR>() + ")";
-							int epoch = 162;
-							int dagsize = 256 * 64 * 162;
-							int cu = devices[i].getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
-							int clock = devices[i].getInfo<CL_DEVICE_MAX_CLOCK_FREQUENCY>();
-							outString += "\t~" + to_string((cu * clock * 1200) / dagsize) + "MH/s\n";
+							// FPGA images are built offline, so there is no probe kernel to measure the bandwidth with.
+							outString += "\t(" + devices[i].getInfo<CL_DEVICE_VENDOR>() + ")\n";
 							std::cout << outString;
 						}
 					} else {
@@ -513,7 +544,7 @@ bool OCLMiner::configureGPU(
 	return false;
 }
 
-HwMonitor OCLMiner::hwmon()
+HwMonitor OCLMiner::readHwmon()
 {
 	HwMonitor hw;
 	unsigned int tempC = 0, fanpcnt = 0;
@@ -682,6 +713,7 @@ bool OCLMiner::init(const h256& seed)
 		catch (cl::Error const& err)
 		{
 			cwarn << ethCLErrorHelper("Creating DAG buffer failed", err);
+			publishError(ethCLErrorHelper("Creating DAG buffer failed", err));
 			return false;
 		}
 		// create buffer for header
@@ -711,16 +743,23 @@ bool OCLMiner::init(const h256& seed)
 			m_dagKernel.setArg(0, i * m_globalWorkSize);
 			m_queue.enqueueNDRangeKernel(m_dagKernel, cl::NullRange, m_globalWorkSize, m_workgroupSize);
 			m_queue.finish();
+			if (!publishDagProgress(i + 1, fullRuns))
+			{
+				cllog << "DAG generation cancelled for a new epoch";
+				return false;
+			}
 		}
 		auto endDAG = std::chrono::steady_clock::now();
 
 		auto dagTime = std::chrono::duration_cast<std::chrono::milliseconds>(endDAG-startDAG);
+		metrics().dagTime.set(std::chrono::duration<double>(endDAG - startDAG).count());
 		float gb = (float)dagSize / (1024 * 1024 * 1024);
 		cnote << gb << " GB of DAG data generated in" << dagTime.count() << "ms.";
 	}
 	catch (cl::Error const& err)
 	{
 		cwarn << ethCLErrorHelper("OpenCL init failed", err);
+		publishError(ethCLErrorHelper("OpenCL init failed", err));
 		return false;
 	}
 	return true;
@@ -84,10 +84,10 @@ public:
 	static void setCLKernel(unsigned _clKernel) { 
 		s_clKernelName = OCLKernelName::Fpga;
 	}
-	HwMonitor hwmon() override;
 	string Name() override;
 protected:
 	void kick_miner() override;
+	HwMonitor readHwmon() override;
 
 private:
 	void workLoop() override;
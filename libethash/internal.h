@@ -69,6 +69,36 @@ ethash_return_value_t ethash_light_compute_internal(
 	uint64_t nonce
 );
 
+/**
+ * Calculate the hash from a precomputed full data set.
+ *
+ * @param full_nodes     The full data set, full_size bytes of nodes from @ref ethash_calculate_dag_item()
+ * @param full_size      The size of the full data in bytes.
+ * @param header_hash    The header hash to pack into the mix
+ * @param nonce          The nonce to pack into the mix
+ * @return               The resulting hash.
+ */
+ethash_return_value_t ethash_full_compute_internal(
+	node const* full_nodes,
+	uint64_t full_size,
+	ethash_h256_t const header_hash,
+	uint64_t nonce
+);
+
+/**
+ * Compute the cache nodes from the seed (SeqMemoHash).
+ *
+ * @param nodes          Output, cache_size bytes
+ * @param cache_size     The size of the cache in bytes, a multiple of the node size
+ * @param seed           Block seedhash
+ * @return               false if cache_size is not a multiple of the node size
+ */
+bool ethash_compute_cache_nodes(
+	node* const nodes,
+	uint64_t cache_size,
+	ethash_h256_t const* seed
+);
+
 void ethash_calculate_dag_item(
 	node* const ret,
 	uint32_t node_index,
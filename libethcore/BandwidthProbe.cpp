@@ -0,0 +1,91 @@
+/// Measures random-read memory bandwidth and the ethash hashrate it can feed.
+///
+/// @file
+/// @copyright GNU General Public License
+
+#include "BandwidthProbe.h"
+#include <atomic>
+#include <iomanip>
+#include <new>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace dev;
+using namespace eth;
+
+namespace
+{
+
+// 64-bit words per ethash mix.
+unsigned const c_lineWords = ETHASH_MIX_BYTES / sizeof(uint64_t);
+
+// Lines read between two looks at the clock.
+unsigned const c_probeBatch = 4096;
+
+}
+
+double dev::eth::probeHostBandwidth(uint64_t _bytes, chrono::milliseconds _duration)
+{
+	uint64_t lines = _bytes / ETHASH_MIX_BYTES;
+	if (!lines)
+		return 0;
+
+	vector<uint64_t> mem;
+	try
+	{
+		// Written once, so the reads hit real pages rather than the shared zero page.
+		mem.resize(lines * c_lineWords);
+		for (size_t i = 0; i < mem.size(); ++i)
+			mem[i] = i;
+	}
+	catch (bad_alloc const&)
+	{
+		return 0;
+	}
+
+	unsigned threads = max(1u, thread::hardware_concurrency());
+	atomic<bool> stop(false);
+	atomic<uint64_t> read(0);
+	atomic<uint64_t> sink(0);
+	vector<thread> workers;
+
+	auto start = chrono::steady_clock::now();
+	for (unsigned t = 0; t < threads; ++t)
+		workers.emplace_back([&, t]() {
+			uint64_t x = 0x9e3779b97f4a7c15ULL * (t + 1) | 1;
+			uint64_t acc = 0;
+			uint64_t done = 0;
+			while (!stop.load(memory_order_relaxed))
+			{
+				for (unsigned i = 0; i < c_probeBatch; ++i)
+				{
+					x ^= x << 13;
+					x ^= x >> 7;
+					x ^= x << 17;
+					uint64_t const* line = mem.data() + (x % lines) * c_lineWords;
+					for (unsigned w = 0; w < c_lineWords; ++w)
+						acc ^= line[w];
+				}
+				done += c_probeBatch;
+				if (t == 0 && chrono::steady_clock::now() - start >= _duration)
+					stop = true;
+			}
+			read += done;
+			// Keeps the reads from being optimized away.
+			sink ^= acc;
+		});
+	for (auto& w: workers)
+		w.join();
+
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	return seconds > 0 ? read.load() * ETHASH_MIX_BYTES / seconds : 0;
+}
+
+string dev::eth::formatBandwidth(double _bytesPerSecond)
+{
+	ostringstream out;
+	out << fixed << setprecision(2) << _bytesPerSecond / 1e9 << " GB/s, ceiling " << ethashCeiling(_bytesPerSecond) / 1e6 << " MH/s";
+	return out.str();
+}
@@ -0,0 +1,43 @@
+/// Measures random-read memory bandwidth and the ethash hashrate it can feed.
+///
+/// @file
+/// @copyright GNU General Public License
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <libethash/ethash.h>
+
+namespace dev
+{
+namespace eth
+{
+
+/// Bytes ethash reads from the DAG per hash: ETHASH_ACCESSES reads of one mix each.
+static const unsigned c_ethashBytesPerHash = ETHASH_ACCESSES * ETHASH_MIX_BYTES;
+
+/// Buffer size of the host probe, well beyond the last level cache.
+static const uint64_t c_hostProbeBytes = 256 * 1024 * 1024;
+
+/**
+ * @brief The theoretical ethash hashrate of a memory.
+ * Ethash is bound by random reads of the DAG, so no kernel can beat the random-read bandwidth
+ * divided by the bytes read per hash.
+ * @returns hashes per second.
+ */
+inline double ethashCeiling(double _bytesPerSecond) { return _bytesPerSecond / c_ethashBytesPerHash; }
+
+/**
+ * @brief Measures the random-read bandwidth of host memory the way ethash reads the DAG:
+ * whole 128-byte lines at random offsets of a buffer of @a _bytes, from every hardware thread.
+ * @returns bytes per second, 0 if the buffer could not be allocated.
+ */
+double probeHostBandwidth(uint64_t _bytes = c_hostProbeBytes, std::chrono::milliseconds _duration = std::chrono::milliseconds(500));
+
+/// @returns e.g. "412.30 GB/s, ceiling 50.33 MH/s".
+std::string formatBandwidth(double _bytesPerSecond);
+
+}
+}
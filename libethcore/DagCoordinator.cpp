@@ -0,0 +1,204 @@
+/// Schedules DAG builds of all devices.
+///
+/// @file
+/// @copyright GNU General Public License
+
+#include "DagCoordinator.h"
+#include <libdevcore/Log.h>
+#include <libdevcore/Metrics.h>
+
+using namespace std;
+using namespace dev;
+using namespace eth;
+
+char const* dev::eth::toString(DagBuild::State _state)
+{
+	switch (_state)
+	{
+	case DagBuild::Queued: return "queued";
+	case DagBuild::Building: return "building";
+	case DagBuild::Done: return "done";
+	case DagBuild::Cancelled: return "cancelled";
+	}
+	return "unknown";
+}
+
+DagCoordinator::Slot& DagCoordinator::Slot::operator=(Slot&& _s)
+{
+	if (this != &_s)
+	{
+		release();
+		m_owner = _s.m_owner;
+		m_id = _s.m_id;
+		_s.m_owner = nullptr;
+	}
+	return *this;
+}
+
+bool DagCoordinator::Slot::progress(unsigned _done, unsigned _total)
+{
+	return !m_owner || m_owner->progress(m_id, _done, _total);
+}
+
+bool DagCoordinator::Slot::release()
+{
+	if (!m_owner)
+		return true;
+	bool ret = m_owner->release(m_id);
+	m_owner = nullptr;
+	return ret;
+}
+
+DagCoordinator& DagCoordinator::get()
+{
+	static DagCoordinator s_coordinator;
+	return s_coordinator;
+}
+
+DagCoordinator::DagCoordinator():
+	m_queued(MetricsRegistry::get().gauge("ethminer_dag_builds", "DAG builds by state.", metricLabel("state", "queued"))),
+	m_building(MetricsRegistry::get().gauge("ethminer_dag_builds", "DAG builds by state.", metricLabel("state", "building")))
+{}
+
+void DagCoordinator::setConcurrency(unsigned _builds)
+{
+	Guard l(x_builds);
+	m_concurrency = _builds;
+	grant();
+}
+
+void DagCoordinator::setSeed(h256 const& _seed)
+{
+	Guard l(x_builds);
+	if (_seed == m_seed)
+		return;
+	m_seed = _seed;
+	for (auto& i: m_entries)
+		if (i.second.build.seed != _seed && !i.second.cancelled)
+		{
+			i.second.cancelled = true;
+			setState(i.second, DagBuild::Cancelled);
+		}
+	grant();
+}
+
+DagCoordinator::Slot DagCoordinator::acquire(string const& _device, h256 const& _seed, double _priority, function<bool()> const& _abort)
+{
+	unique_lock<Mutex> l(x_builds);
+	unsigned id = ++m_lastId;
+	Entry& e = m_entries[id];
+	e.id = id;
+	e.build.device = _device;
+	e.build.seed = _seed;
+	e.build.priority = _priority;
+	if (m_seed && _seed != m_seed)
+		e.cancelled = true;
+	setState(e, e.cancelled ? DagBuild::Cancelled : DagBuild::Queued);
+	grant();
+
+	while (!e.cancelled && e.build.state == DagBuild::Queued)
+	{
+		if (_abort && _abort())
+		{
+			e.cancelled = true;
+			setState(e, DagBuild::Cancelled);
+			break;
+		}
+		m_changed.wait_for(l, chrono::milliseconds(100));
+	}
+
+	if (e.build.state != DagBuild::Building)
+	{
+		// Cancelled, possibly right after being granted a slot.
+		bool granted = e.granted;
+		m_entries.erase(id);
+		if (granted)
+			--m_running;
+		grant();
+		return Slot();
+	}
+	if (m_concurrency)
+		cnote << _device << "building DAG," << m_running << "of" << m_concurrency << "slots in use";
+	return Slot(this, id);
+}
+
+bool DagCoordinator::progress(unsigned _id, unsigned _done, unsigned _total)
+{
+	Guard l(x_builds);
+	auto it = m_entries.find(_id);
+	if (it == m_entries.end())
+		return false;
+	DagBuild& b = it->second.build;
+	b.done = _done;
+	b.total = _total;
+	m_latest[b.device] = b;
+	MetricsRegistry::get().gauge("ethminer_dag_progress", "Fraction of the device's current DAG build completed.", metricLabel("device", b.device)).set(_total ? (double)_done / _total : 0);
+	return !it->second.cancelled;
+}
+
+bool DagCoordinator::release(unsigned _id)
+{
+	Guard l(x_builds);
+	auto it = m_entries.find(_id);
+	if (it == m_entries.end())
+		return false;
+	Entry& e = it->second;
+	bool ret = !e.cancelled;
+	--m_running;
+	// A build that never reported progress counts as complete unless it was cancelled.
+	bool complete = ret && e.build.done == e.build.total;
+	setState(e, complete ? DagBuild::Done : DagBuild::Cancelled);
+	m_entries.erase(it);
+	grant();
+	return ret;
+}
+
+void DagCoordinator::grant()
+{
+	while (!m_concurrency || m_running < m_concurrency)
+	{
+		Entry* best = nullptr;
+		for (auto& i: m_entries)
+		{
+			Entry& e = i.second;
+			if (e.cancelled || e.build.state != DagBuild::Queued)
+				continue;
+			// Ids grow with arrival, so the first of equal priorities is the earliest.
+			if (!best || e.build.priority > best->build.priority)
+				best = &e;
+		}
+		if (!best)
+			break;
+		++m_running;
+		best->granted = true;
+		setState(*best, DagBuild::Building);
+	}
+	updateGauges();
+	m_changed.notify_all();
+}
+
+void DagCoordinator::setState(Entry& _e, DagBuild::State _state)
+{
+	_e.build.state = _state;
+	_e.build.since = chrono::steady_clock::now();
+	m_latest[_e.build.device] = _e.build;
+}
+
+void DagCoordinator::updateGauges()
+{
+	unsigned queued = 0;
+	for (auto const& i: m_entries)
+		if (i.second.build.state == DagBuild::Queued)
+			++queued;
+	m_queued.set(queued);
+	m_building.set(m_running);
+}
+
+vector<DagBuild> DagCoordinator::status() const
+{
+	Guard l(x_builds);
+	vector<DagBuild> ret;
+	for (auto const& i: m_latest)
+		ret.push_back(i.second);
+	return ret;
+}
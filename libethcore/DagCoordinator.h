@@ -0,0 +1,140 @@
+/// Schedules DAG builds of all devices.
+///
+/// @file
+/// @copyright GNU General Public License
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include <libdevcore/FixedHash.h>
+#include <libdevcore/Guards.h>
+
+namespace dev
+{
+
+class MetricGauge;
+
+namespace eth
+{
+
+/// A device's most recent DAG build, as reported by DagCoordinator::status().
+struct DagBuild
+{
+	enum State
+	{
+		Queued,
+		Building,
+		Done,
+		Cancelled,	///< Replaced by another epoch, or aborted before completion.
+	};
+
+	std::string device;
+	h256 seed;
+	State state = Queued;
+	double priority = 0;
+	unsigned done = 0;
+	unsigned total = 0;
+	std::chrono::steady_clock::time_point since;	///< When the build entered its current state.
+};
+
+char const* toString(DagBuild::State _state);
+
+/**
+ * @brief Limits how many devices generate or upload their DAG at the same time.
+ * Building every DAG at once draws peak power on all boards together and saturates the host
+ * while the lights are copied; building them one after the other wastes time on rigs that can
+ * afford more. Devices queue for one of a configurable number of slots, faster devices first,
+ * so the bulk of the hashrate is back soonest. A new epoch cancels queued and running builds
+ * for the previous one.
+ */
+class DagCoordinator
+{
+public:
+	/**
+	 * @brief Permission to build one DAG, released on destruction.
+	 * An empty slot means the build was cancelled before it could start.
+	 */
+	class Slot
+	{
+	public:
+		Slot() = default;
+		Slot(Slot&& _s): m_owner(_s.m_owner), m_id(_s.m_id) { _s.m_owner = nullptr; }
+		Slot& operator=(Slot&& _s);
+		~Slot() { release(); }
+
+		explicit operator bool() const { return m_owner != nullptr; }
+
+		/// Records the progress of the build. @returns false if the build has been cancelled
+		/// and should be abandoned.
+		bool progress(unsigned _done, unsigned _total);
+
+		/// Frees the slot for the next device. @returns false if the build had been cancelled.
+		bool release();
+
+	private:
+		friend class DagCoordinator;
+		Slot(DagCoordinator* _owner, unsigned _id): m_owner(_owner), m_id(_id) {}
+
+		DagCoordinator* m_owner = nullptr;
+		unsigned m_id = 0;
+	};
+
+	static DagCoordinator& get();
+
+	/// Sets the number of builds allowed to run at once, 0 for no limit.
+	void setConcurrency(unsigned _builds);
+	unsigned concurrency() const { Guard l(x_builds); return m_concurrency; }
+
+	/// Announces the epoch the farm is mining. Builds for any other seed are cancelled.
+	void setSeed(h256 const& _seed);
+
+	/**
+	 * @brief Blocks until @a _device may build the DAG for @a _seed.
+	 * @param _priority Higher goes first, usually the device's last measured hashrate. Equal
+	 * priorities go in order of arrival.
+	 * @param _abort Polled while waiting; the wait gives up once it returns true.
+	 * @returns an empty slot if the build was cancelled or aborted while queued.
+	 */
+	Slot acquire(std::string const& _device, h256 const& _seed, double _priority, std::function<bool()> const& _abort = std::function<bool()>());
+
+	/// @returns the latest build of every device that ever queued, ordered by device name.
+	std::vector<DagBuild> status() const;
+
+private:
+	struct Entry
+	{
+		DagBuild build;
+		unsigned id;
+		bool granted = false;	///< Holds one of the slots.
+		bool cancelled = false;
+	};
+
+	DagCoordinator();
+
+	bool progress(unsigned _id, unsigned _done, unsigned _total);
+	bool release(unsigned _id);
+	/// Moves the best queued builds into free slots. Called with x_builds held.
+	void grant();
+	void setState(Entry& _e, DagBuild::State _state);
+	void updateGauges();
+
+	mutable Mutex x_builds;
+	std::condition_variable m_changed;
+	std::map<unsigned, Entry> m_entries;			///< Queued and running builds by id.
+	std::map<std::string, DagBuild> m_latest;		///< Last known build of each device.
+	unsigned m_concurrency = 0;
+	unsigned m_running = 0;
+	unsigned m_lastId = 0;
+	h256 m_seed;
+
+	MetricGauge& m_queued;
+	MetricGauge& m_building;
+};
+
+}
+}
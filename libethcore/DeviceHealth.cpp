@@ -0,0 +1,99 @@
+/// Per-device fault tracking and rate-driven recovery policies.
+///
+/// @file
+/// @copyright GNU General Public License
+
+#include "DeviceHealth.h"
+#include <algorithm>
+
+using namespace std;
+using namespace dev;
+using namespace eth;
+
+constexpr double DeviceHealth::c_throttleStep;
+constexpr double DeviceHealth::c_minIntensity;
+
+unsigned DeviceHealth::record(Fault _fault, Clock::time_point _now)
+{
+	recover(_now);
+	++m_counts[_fault];
+	m_faults.push_back(_now);
+	recent(_now);
+
+	unsigned ret = None;
+	if (m_quarantined)
+		return ret;
+	if (m_policy.quarantine && since(Clock::time_point(), _now) >= m_policy.quarantine)
+	{
+		m_quarantined = true;
+		return Quarantine;
+	}
+	if (m_policy.regenerate && since(m_lastRegenerate, _now) >= m_policy.regenerate)
+	{
+		m_lastRegenerate = _now;
+		ret |= Regenerate;
+	}
+	if (m_policy.throttle && since(m_lastThrottle, _now) >= m_policy.throttle && m_intensity > c_minIntensity)
+	{
+		m_lastThrottle = _now;
+		m_intensity = max(m_intensity * c_throttleStep, c_minIntensity);
+		ret |= Throttle;
+	}
+	return ret;
+}
+
+bool DeviceHealth::recover(Clock::time_point _now)
+{
+	if (m_quarantined || m_intensity >= 1 || _now - m_lastThrottle < m_policy.window)
+		return false;
+	if (since(m_lastThrottle, _now) >= m_policy.throttle)
+		return false;
+	// The next step needs another quiet window, and only the faults after it count towards a throttle.
+	m_lastThrottle = _now;
+	m_intensity = min(m_intensity / c_throttleStep, 1.0);
+	return true;
+}
+
+DeviceHealth::State DeviceHealth::state() const
+{
+	if (m_quarantined)
+		return Quarantined;
+	return m_intensity < 1 ? Throttled : Healthy;
+}
+
+unsigned DeviceHealth::recent(Clock::time_point _now)
+{
+	while (!m_faults.empty() && m_faults.front() <= _now - m_policy.window)
+		m_faults.pop_front();
+	return m_faults.size();
+}
+
+unsigned DeviceHealth::since(Clock::time_point _since, Clock::time_point _now) const
+{
+	Clock::time_point from = max(_since, _now - m_policy.window);
+	return count_if(m_faults.begin(), m_faults.end(), [&](Clock::time_point _t) { return _t > from; });
+}
+
+char const* dev::eth::toString(DeviceHealth::Fault _fault)
+{
+	switch (_fault)
+	{
+	case DeviceHealth::IncorrectResult: return "incorrect_result";
+	case DeviceHealth::KernelError: return "kernel_error";
+	case DeviceHealth::Stall: return "stall";
+	case DeviceHealth::CorruptDag: return "corrupt_dag";
+	case DeviceHealth::FaultKinds: break;
+	}
+	return "unknown";
+}
+
+char const* dev::eth::toString(DeviceHealth::State _state)
+{
+	switch (_state)
+	{
+	case DeviceHealth::Healthy: return "healthy";
+	case DeviceHealth::Throttled: return "throttled";
+	case DeviceHealth::Quarantined: return "quarantined";
+	}
+	return "unknown";
+}
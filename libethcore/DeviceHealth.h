@@ -0,0 +1,102 @@
+/// Per-device fault tracking and rate-driven recovery policies.
+///
+/// @file
+/// @copyright GNU General Public License
+
+#pragma once
+
+#include <chrono>
+#include <deque>
+
+namespace dev
+{
+namespace eth
+{
+
+/// Thresholds on a device's fault rate, in faults per window. 0 disables an action.
+struct HealthPolicy
+{
+	unsigned throttle = 0;		///< Lower the device's intensity by another step.
+	unsigned regenerate = 0;	///< Regenerate the device's DAG.
+	unsigned quarantine = 0;	///< Stop the device until the miner restarts.
+	std::chrono::seconds window = std::chrono::hours(1);
+	std::chrono::seconds stall = std::chrono::seconds(60);	///< No hashes for this long with work counts as a stall, 0 disables.
+};
+
+/**
+ * @brief Tracks the faults of one device and decides what to do about them.
+ * Every kind of fault counts towards the same rate. Each action fires when the faults seen
+ * within the window, and since the action last fired, reach its threshold; so a device that
+ * keeps failing is throttled step by step, then gets its DAG rebuilt, then is quarantined.
+ * A throttled device gets a step of intensity back after each whole window with fewer faults
+ * than the throttle threshold.
+ */
+class DeviceHealth
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	enum Fault
+	{
+		IncorrectResult,	///< A solution failed CPU verification.
+		KernelError,		///< The device API reported an error.
+		Stall,				///< No hashes for HealthPolicy::stall while there was work.
+		CorruptDag,			///< A DAG check found bad items.
+		FaultKinds
+	};
+
+	enum State
+	{
+		Healthy,
+		Throttled,
+		Quarantined,
+	};
+
+	enum Action
+	{
+		None = 0,
+		Throttle = 1,
+		Regenerate = 2,
+		Quarantine = 4,
+	};
+
+	/// Intensity lost per throttle step, and the floor it stops at.
+	static constexpr double c_throttleStep = 0.75;
+	static constexpr double c_minIntensity = 0.25;
+
+	explicit DeviceHealth(HealthPolicy const& _policy = HealthPolicy()): m_policy(_policy) {}
+
+	/// Records a fault seen at @a _now. @returns the Action flags to carry out.
+	unsigned record(Fault _fault, Clock::time_point _now = Clock::now());
+	/// Raises the intensity a step if the last window since the intensity changed stayed below the
+	/// throttle threshold. Call it periodically. @returns true if the intensity was raised.
+	bool recover(Clock::time_point _now = Clock::now());
+
+	/// @returns Throttled while the intensity is below 1, until enough quiet windows restored it.
+	State state() const;
+	/// @returns the fraction of its full intensity the device may use, in [c_minIntensity, 1].
+	double intensity() const { return m_intensity; }
+	unsigned count(Fault _fault) const { return m_counts[_fault]; }
+	/// @returns the faults seen within the window before @a _now.
+	unsigned recent(Clock::time_point _now = Clock::now());
+
+	HealthPolicy const& policy() const { return m_policy; }
+
+private:
+	/// @returns the faults seen within the window and after @a _since.
+	unsigned since(Clock::time_point _since, Clock::time_point _now) const;
+
+	HealthPolicy m_policy;
+	std::deque<Clock::time_point> m_faults;		///< Within the window, oldest first.
+	unsigned m_counts[FaultKinds] = {};
+	Clock::time_point m_lastThrottle;
+	Clock::time_point m_lastRegenerate;
+	bool m_quarantined = false;
+	double m_intensity = 1;
+};
+
+char const* toString(DeviceHealth::Fault _fault);
+char const* toString(DeviceHealth::State _state);
+
+}
+}
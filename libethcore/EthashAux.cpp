@@ -21,6 +21,8 @@
 
 #include "EthashAux.h"
 #include <libethash/internal.h>
+#include <libdevcore/StartupTimer.h>
+#include <libdevcore/TaskPool.h>
 
 using namespace std;
 using namespace chrono;
@@ -75,19 +77,80 @@ uint64_t EthashAux::number(h256 const& _seedHash)
 	return epoch * ETHASH_EPOCH_LENGTH;
 }
 
+h256 EthashAux::nextSeedHash(h256 const& _seedHash)
+{
+	return sha3(_seedHash);
+}
+
 EthashAux::LightType EthashAux::light(h256 const& _seedHash)
 {
 	// TODO: Use epoch number instead of seed hash?
 
+	EthashAux& ethash = EthashAux::get();
+	shared_future<LightType> light;
+	{
+		Guard l(ethash.x_lights);
+		auto it = ethash.m_lights.find(_seedHash);
+		if (it != ethash.m_lights.end())
+			light = it->second;
+		else
+			light = ethash.m_lights[_seedHash] = TaskPool::get().async([_seedHash]() { return make_shared<LightAllocation>(_seedHash); }, TaskPriority::High);
+	}
+	TaskPool::get().wait(light);
+	try
+	{
+		return light.get();
+	}
+	catch (...)
+	{
+		// Do not cache a failure, the next caller tries again.
+		Guard l(ethash.x_lights);
+		ethash.m_lights.erase(_seedHash);
+		throw;
+	}
+}
+
+EthashAux::LightType EthashAux::prepareLight(h256 const& _seedHash, TaskPriority _priority)
+{
+	EthashAux& ethash = EthashAux::get();
+	shared_future<LightType> light;
+	{
+		Guard l(ethash.x_lights);
+		auto it = ethash.m_lights.find(_seedHash);
+		if (it != ethash.m_lights.end())
+			light = it->second;
+		else
+			light = ethash.m_lights[_seedHash] = TaskPool::get().async([_seedHash]() { return make_shared<LightAllocation>(_seedHash); }, _priority);
+	}
+	if (light.wait_for(chrono::seconds(0)) != future_status::ready)
+		return LightType();
+	try
+	{
+		return light.get();
+	}
+	catch (...)
+	{
+		Guard l(ethash.x_lights);
+		ethash.m_lights.erase(_seedHash);
+		return LightType();
+	}
+}
+
+void EthashAux::releaseLight(h256 const& _seedHash)
+{
 	EthashAux& ethash = EthashAux::get();
 	Guard l(ethash.x_lights);
-	if (ethash.m_lights.count(_seedHash))
-		return ethash.m_lights.at(_seedHash);
-	return (ethash.m_lights[_seedHash] = make_shared<LightAllocation>(_seedHash));
+	ethash.m_lights.erase(_seedHash);
+}
+
+uint64_t EthashAux::dataSize(unsigned _blockNumber)
+{
+	return ethash_get_datasize(_blockNumber);
 }
 
 EthashAux::LightAllocation::LightAllocation(h256 const& _seedHash)
 {
+	StartupPhase phase("light");
 	uint64_t blockNumber = EthashAux::number(_seedHash);
 	light = ethash_light_new(blockNumber);
 	if (!light)
@@ -22,8 +22,10 @@
 #pragma once
 
 #include <condition_variable>
+#include <future>
 #include <libethash/ethash.h>
 #include <libdevcore/Log.h>
+#include <libdevcore/TaskPool.h>
 #include <libdevcore/Worker.h>
 #include "BlockHeader.h"
 
@@ -55,8 +57,18 @@ public:
 
 	static h256 seedHash(unsigned _number);
 	static uint64_t number(h256 const& _seedHash);
+	/// @returns the seed hash of the epoch following the one of @a _seedHash.
+	static h256 nextSeedHash(h256 const& _seedHash);
 
 	static LightType light(h256 const& _seedHash);
+	/// Starts building the light client of an epoch in the background without waiting for it.
+	/// @returns the light if it is already built, null otherwise.
+	static LightType prepareLight(h256 const& _seedHash, TaskPriority _priority = TaskPriority::Low);
+	/// Drops the cached light client of an epoch, e.g. once a sweep moved past it. Holders keep their copy.
+	static void releaseLight(h256 const& _seedHash);
+
+	/// @returns the size of the full DAG in bytes for the epoch of @a _blockNumber.
+	static uint64_t dataSize(unsigned _blockNumber);
 
 	static Result eval(h256 const& _seedHash, h256 const& _headerHash, uint64_t  _nonce) noexcept;
 
@@ -65,7 +77,8 @@ private:
 	static EthashAux& get();
 
 	Mutex x_lights;
-	std::unordered_map<h256, LightType> m_lights;
+	/// Lights being built or ready. Building runs on the task pool without holding x_lights.
+	std::unordered_map<h256, std::shared_future<LightType>> m_lights;
 
 	Mutex x_epochs;
 	std::unordered_map<h256, unsigned> m_epochs;
@@ -87,6 +100,7 @@ struct WorkPackage
 	h256 header;	///< When h256() means "pause until notified a new work package is available".
 	h256 seed;
 	h256 job;
+	uint64_t height = 0;	///< Block number, 0 if the pool did not send it.
 
 	uint64_t startNonce = 0;
 	int exSizeBits = -1;
@@ -99,6 +113,8 @@ struct Solution
 	h256 mixHash;
 	WorkPackage work;
 	bool stale;
+	unsigned device;	///< Index of the miner that found it.
+	std::chrono::steady_clock::time_point found;	///< When the device reported it, zero if unknown.
 };
 
 }
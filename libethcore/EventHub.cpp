@@ -0,0 +1,75 @@
+/// Publish/subscribe hub for mining events.
+///
+/// @file
+/// @copyright GNU General Public License
+
+#include "EventHub.h"
+
+#include <chrono>
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+Event::Event(string const& _type)
+{
+	m_out.precision(6);
+	m_out << fixed;
+	auto ts = chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+	m_out << "{\"event\":\"" << _type << "\",\"ts\":" << ts;
+}
+
+ostream& Event::key(string const& _key)
+{
+	return m_out << ",\"" << _key << "\":";
+}
+
+Event& Event::add(string const& _key, string const& _value)
+{
+	ostream& out = key(_key);
+	out << '"';
+	for (char c: _value)
+	{
+		if (c == '"' || c == '\\')
+			out << '\\' << c;
+		else if (c == '\n')
+			out << "\\n";
+		else if ((unsigned char)c < 0x20)
+			out << ' ';
+		else
+			out << c;
+	}
+	out << '"';
+	return *this;
+}
+
+EventHub& EventHub::get()
+{
+	static EventHub instance;
+	return instance;
+}
+
+unsigned EventHub::subscribe(Handler const& _handler)
+{
+	Guard l(x_handlers);
+	m_handlers.push_back(make_pair(++m_lastId, _handler));
+	m_subscribers = m_handlers.size();
+	return m_lastId;
+}
+
+void EventHub::unsubscribe(unsigned _id)
+{
+	Guard l(x_handlers);
+	m_handlers.remove_if([&](pair<unsigned, Handler> const& _h) { return _h.first == _id; });
+	m_subscribers = m_handlers.size();
+}
+
+void EventHub::publish(Event const& _event)
+{
+	if (!active())
+		return;
+	string line = _event.line();
+	Guard l(x_handlers);
+	for (auto const& h: m_handlers)
+		h.second(line);
+}
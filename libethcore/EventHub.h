@@ -0,0 +1,78 @@
+/// Publish/subscribe hub for mining events.
+///
+/// @file
+/// @copyright GNU General Public License
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <list>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <libdevcore/Guards.h>
+
+namespace dev
+{
+namespace eth
+{
+
+/**
+ * @brief A single event, rendered as one line of JSON, e.g.
+ * {"event":"share_accepted","ts":1514764800123,"rtt":0.042}
+ */
+class Event
+{
+public:
+	explicit Event(std::string const& _type);
+
+	Event& add(std::string const& _key, std::string const& _value);
+	Event& add(std::string const& _key, char const* _value) { return add(_key, std::string(_value)); }
+	Event& add(std::string const& _key, bool _value) { key(_key) << (_value ? "true" : "false"); return *this; }
+	template <class T>
+	typename std::enable_if<std::is_arithmetic<T>::value, Event&>::type add(std::string const& _key, T _value)
+	{
+		key(_key) << _value;
+		return *this;
+	}
+
+	/// @returns the JSON object terminated by a newline.
+	std::string line() const { return m_out.str() + "}\n"; }
+
+private:
+	std::ostream& key(std::string const& _key);
+
+	std::ostringstream m_out;
+};
+
+/**
+ * @brief Process wide event dispatcher.
+ * Publishing is a single atomic load when nobody is subscribed; callers should check active()
+ * before building an Event. Handlers run on the publishing thread and must not block.
+ */
+class EventHub
+{
+public:
+	using Handler = std::function<void(std::string const&)>;
+
+	static EventHub& get();
+
+	bool active() const { return m_subscribers.load(std::memory_order_relaxed) > 0; }
+
+	unsigned subscribe(Handler const& _handler);
+	void unsubscribe(unsigned _id);
+
+	void publish(Event const& _event);
+
+private:
+	EventHub() = default;
+
+	std::atomic<unsigned> m_subscribers = {0};
+	unsigned m_lastId = 0;
+	Mutex x_handlers;
+	std::list<std::pair<unsigned, Handler>> m_handlers;
+};
+
+}
+}
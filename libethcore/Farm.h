@@ -28,10 +28,16 @@
 #include <thread>
 #include <list>
 #include <atomic>
+#include <condition_variable>
 #include <libdevcore/Common.h>
+#include <libdevcore/EventLoop.h>
+#include <libdevcore/Metrics.h>
+#include <libdevcore/Trace.h>
 #include <libdevcore/Worker.h>
 #include <libethcore/Miner.h>
 #include <libethcore/BlockHeader.h>
+#include <libethcore/EventHub.h>
+#include <libethcore/ShareStats.h>
 
 namespace dev
 {
@@ -66,6 +72,24 @@ public:
 	~Farm()
 	{
 		stop();
+		EventLoop::get().run(m_strand, [&]()
+		{
+			if (p_feetimer)
+			{
+				p_feetimer->cancel();
+				delete p_feetimer;
+				p_feetimer = nullptr;
+			}
+		});
+		EventLoop::get().drain(m_strand);
+
+		{
+			Guard l(x_hwmon);
+			m_hwmonStop = true;
+		}
+		m_hwmonSignal.notify_all();
+		if (m_hwmonThread.joinable())
+			m_hwmonThread.join();
 	}
 
 	/**
@@ -74,6 +98,7 @@ public:
 	 */
 	void setWork(WorkPackage const& _wp)
 	{
+		DEV_TRACE_SCOPE("set_work", 0);
 		//Collect hashrate before miner reset their work
 		collectHashRate();
 
@@ -81,9 +106,44 @@ public:
 		Guard l(x_minerWork);
 		if (_wp.header == m_work.header && _wp.startNonce == m_work.startNonce)
 			return;
+		if (_wp && !m_work)
+			StartupTimer::get().mark("work");
+		if (_wp && _wp.seed != m_work.seed)
+		{
+			// Miners may still be setting up their devices or waiting for a DAG slot, start the
+			// light they all need right away.
+			EthashAux::prepareLight(_wp.seed, TaskPriority::High);
+			// Cancels DAG builds still queued or running for the previous epoch.
+			DagCoordinator::get().setSeed(_wp.seed);
+		}
 		m_work = _wp;
 		for (auto const& m: m_miners)
 			m->setWork(m_work);
+		if (_wp && m_dagPregenBlocks && !_wp.height && !m_pregenNoHeight)
+		{
+			// Without a block number the distance to the boundary is unknown. Building the next DAG
+			// anyway could start days early and hold twice the memory for the rest of the epoch.
+			m_pregenNoHeight = true;
+			cnote << "The pool sends no block number, the next epoch's DAG is not prepared ahead";
+		}
+		if (_wp && m_dagPregenBlocks && _wp.height && ETHASH_EPOCH_LENGTH - _wp.height % ETHASH_EPOCH_LENGTH <= m_dagPregenBlocks)
+		{
+			h256 next = EthashAux::nextSeedHash(_wp.seed);
+			if (next != m_nextSeed)
+			{
+				m_nextSeed = next;
+				EthashAux::prepareLight(next);
+				cnote << "Preparing the DAG of the next epoch";
+				for (auto const& m: m_miners)
+					m->setNextSeed(m_nextSeed);
+			}
+		}
+
+		if (EventHub::get().active())
+			EventHub::get().publish(Event("new_job")
+				.add("header", _wp.header.hex())
+				.add("seed", _wp.seed.hex())
+				.add("boundary", _wp.boundary.hex()));
 	}
 
 	void setSealers(std::map<std::string, SealerDescriptor> const& _sealers) { m_sealers = _sealers; }
@@ -119,6 +179,7 @@ public:
 		{
 			// TODO: Improve miners creation, use unique_ptr.
 			m_miners.push_back(std::shared_ptr<Miner>(m_sealers[_sealer].create(*this, i)));
+			m_miners.back()->setNextSeed(m_nextSeed);
 
 			// Start miners' threads. They should pause waiting for new work
 			// package.
@@ -126,22 +187,23 @@ public:
 		}
 		m_isMining = true;
 		m_lastSealer = _sealer;
+
+		if (m_hwmonInterval && !m_hwmonThread.joinable())
+			m_hwmonThread = std::thread{ boost::bind(&Farm::hwmonLoop, this) };
 		b_lastMixed = mixed;
 
-		if (!p_feetimer) {
-			p_feetimer = new boost::asio::deadline_timer(m_io_service, boost::posix_time::seconds(60*5));
-			p_feetimer->async_wait(boost::bind(&Farm::switchPool, this, boost::asio::placeholders::error));
-		}
-		if (!p_hashrateTimer) {
-			p_hashrateTimer = new boost::asio::deadline_timer(m_io_service, boost::posix_time::milliseconds(1000));
-			p_hashrateTimer->async_wait(boost::bind(&Farm::processHashRate, this, boost::asio::placeholders::error));
-			if (m_serviceThread.joinable()) {
-				m_io_service.reset();
+		// Not waiting for the strand: its handlers take x_minerWork, which is held here.
+		m_strand.post([this]()
+		{
+			if (!p_feetimer) {
+				p_feetimer = new boost::asio::deadline_timer(m_io_service, boost::posix_time::seconds(60*5));
+				p_feetimer->async_wait(m_strand.wrap(boost::bind(&Farm::switchPool, this, boost::asio::placeholders::error)));
 			}
-			else {
-				m_serviceThread = std::thread{ boost::bind(&boost::asio::io_service::run, &m_io_service) };
+			if (!p_hashrateTimer) {
+				p_hashrateTimer = new boost::asio::deadline_timer(m_io_service, boost::posix_time::milliseconds(1000));
+				p_hashrateTimer->async_wait(m_strand.wrap(boost::bind(&Farm::processHashRate, this, boost::asio::placeholders::error)));
 			}
-		}
+		});
 
 		return true;
 	}
@@ -157,13 +219,15 @@ public:
 			m_isMining = false;
 		}
 
-		m_io_service.stop();
-		m_serviceThread.join();
-
-		if (p_hashrateTimer) {
-			p_hashrateTimer->cancel();
-			p_hashrateTimer = nullptr;
-		}
+		// Timer handlers run on the event loop, so the timer is only touched from its strand.
+		EventLoop::get().run(m_strand, [&]()
+		{
+			if (p_hashrateTimer) {
+				p_hashrateTimer->cancel();
+				delete p_hashrateTimer;
+				p_hashrateTimer = nullptr;
+			}
+		});
 	}
 
     void collectHashRate()
@@ -181,6 +245,8 @@ public:
 			uint64_t minerHashCount = i->hashCount();
             p.hashes += minerHashCount;
             p.minersHashes.push_back(minerHashCount);
+			i->checkStall(minerHashCount, (bool)m_work);
+			m_shareStats.addHashes(i->Index(), minerHashCount, now);
         }
 
         // Reset
@@ -197,17 +263,62 @@ public:
 
         if (allMs > m_hashrateSmoothInterval)
             m_lastProgresses.erase(m_lastProgresses.begin());
+
+        // Publish the smoothed per device hashrate
+        for (size_t m = 0; m < m_miners.size(); ++m)
+        {
+            uint64_t hashes = 0;
+            uint64_t ms = 0;
+            for (auto const& cp : m_lastProgresses)
+            {
+                ms += cp.ms;
+                if (m < cp.minersHashes.size())
+                    hashes += cp.minersHashes[m];
+            }
+            double rate = ms ? hashes * 1000.0 / ms : 0;
+            m_miners[m]->metrics().hashrate.set(rate);
+            m_miners[m]->metrics().efficiency.set(hashesPerJoule(rate, m_miners[m]->hwmon()));
+            m_miners[m]->metrics().effectiveHashrate.set(m_shareStats.effective(m_miners[m]->Index(), now).effective);
+        }
     }
 
+	/**
+	 * @brief Sets how often the sensors of all miners are sampled, 0 disables sampling.
+	 * Must be called before start().
+	 */
+	void setHwmonInterval(unsigned _ms) { m_hwmonInterval = _ms; }
+
+	/**
+	 * @brief Lets the miners build the DAG of the next epoch once the work is within @a _blocks
+	 * of the epoch boundary, 0 disables it. Work without a block number, as sent by most stratum
+	 * pools, never triggers it.
+	 */
+	void setDagPregeneration(unsigned _blocks) { m_dagPregenBlocks = _blocks; }
+
+	void publishHashRate()
+	{
+		if (!EventHub::get().active())
+			return;
+		WorkingProgress p = miningProgress();
+		Event e("hashrate");
+		e.add("total", p.rate());
+		for (size_t i = 0; i < p.minersHashes.size(); ++i)
+			e.add(p.minersNames[i], p.minerRate(p.minersHashes[i]));
+		EventHub::get().publish(e);
+	}
+
 	void processHashRate(const boost::system::error_code& ec) {
 
+		if (ec == boost::asio::error::operation_aborted || !p_hashrateTimer)
+			return;
 		if (!ec) {
 			collectHashRate();
+			publishHashRate();
 		}
 
 		// Restart timer 	
 		p_hashrateTimer->expires_at(p_hashrateTimer->expires_at() + boost::posix_time::milliseconds(1000));
-		p_hashrateTimer->async_wait(boost::bind(&Farm::processHashRate, this, boost::asio::placeholders::error));
+		p_hashrateTimer->async_wait(m_strand.wrap(boost::bind(&Farm::processHashRate, this, boost::asio::placeholders::error)));
 	}
 	
 	/**
@@ -225,6 +336,8 @@ public:
 
 	void switchPool(const boost::system::error_code& error)
 	{
+		if (error == boost::asio::error::operation_aborted || !p_feetimer)
+			return;
 		p_feetimer->cancel();
 		if (m_onSwitchPool) {
 			m_onSwitchPool();
@@ -237,7 +350,7 @@ public:
 				p_feetimer->expires_from_now(boost::posix_time::seconds(60*2));
 			}
 		}
-		p_feetimer->async_wait(boost::bind(&Farm::switchPool, this, boost::asio::placeholders::error));
+		p_feetimer->async_wait(m_strand.wrap(boost::bind(&Farm::switchPool, this, boost::asio::placeholders::error)));
 	}
 		
 	bool isMining() const
@@ -245,6 +358,13 @@ public:
 		return m_isMining;
 	}
 
+	/// @returns a snapshot of the running miners.
+	std::vector<std::shared_ptr<Miner>> miners() const
+	{
+		Guard l(x_minerWork);
+		return m_miners;
+	}
+
 	bool isFee() const
 	{
 		return m_isFee;
@@ -271,6 +391,7 @@ public:
         {
             p.minersHashes.push_back(0);
 			p.minersNames.push_back(i->Name());
+			p.minersCeilings.push_back(i->ceiling());
             if (hwmon)
                 p.minerMonitors.push_back(i->hwmon());
         }
@@ -293,29 +414,40 @@ public:
 		return m_solutionStats;
 	}
 
+	/// @returns the shares and effective hashrates per device and per pool.
+	ShareStats const& shareStats() const { return m_shareStats; }
+
 	void failedSolution() override {
 		m_solutionStats.failed();
+		m_sharesFailed.inc();
 	}
 
-	void acceptedSolution(bool _stale) {
-		if (!_stale)
+	/// Records the pool's verdict on a share, farm-wide and for the device and the pool.
+	void acceptedSolution(Solution const& _s, std::string const& _pool) {
+		m_shareStats.record(_s.device, _pool, true, _s.stale, ShareStats::difficulty(_s.work.boundary));
+		if (!_s.stale)
 		{
 			m_solutionStats.accepted();
+			m_sharesAccepted.inc();
 		}
 		else
 		{
 			m_solutionStats.acceptedStale();
+			m_sharesAcceptedStale.inc();
 		}
 	}
 
-	void rejectedSolution(bool _stale) {
-		if (!_stale)
+	void rejectedSolution(Solution const& _s, std::string const& _pool) {
+		m_shareStats.record(_s.device, _pool, false, _s.stale, ShareStats::difficulty(_s.work.boundary));
+		if (!_s.stale)
 		{
 			m_solutionStats.rejected();
+			m_sharesRejected.inc();
 		}
 		else
 		{
 			m_solutionStats.rejectedStale();
+			m_sharesRejectedStale.inc();
 		}
 	}
 
@@ -368,6 +500,31 @@ public:
 	}
 
 private:
+	/**
+	 * @brief Polls the sensors of every miner, publishing readings for Miner::hwmon().
+	 * Hardware queries can take milliseconds, so they are done here and never while holding
+	 * x_minerWork.
+	 */
+	void hwmonLoop()
+	{
+		setThreadName("hwmon");
+		std::unique_lock<std::mutex> l(x_hwmon);
+		while (!m_hwmonStop)
+		{
+			l.unlock();
+			std::vector<std::shared_ptr<Miner>> miners;
+			{
+				Guard m(x_minerWork);
+				miners = m_miners;
+			}
+			for (auto const& m : miners)
+				m->sampleHwmon();
+			miners.clear();
+			l.lock();
+			m_hwmonSignal.wait_for(l, std::chrono::milliseconds(m_hwmonInterval), [&]() { return m_hwmonStop; });
+		}
+	}
+
 	/**
 	 * @brief Called from a Miner to note a WorkPackage has a solution.
 	 * @param _p The solution.
@@ -377,12 +534,20 @@ private:
 	void submitProof(Solution const& _s) override
 	{
 		assert(m_onSolutionFound);
+		if (EventHub::get().active())
+			EventHub::get().publish(Event("share_found")
+				.add("nonce", toHex(_s.nonce))
+				.add("header", _s.work.header.hex())
+				.add("stale", _s.stale));
 		m_onSolutionFound(_s);
 	}
 
 	mutable Mutex x_minerWork;
 	std::vector<std::shared_ptr<Miner>> m_miners;
 	WorkPackage m_work;
+	unsigned m_dagPregenBlocks = 0;
+	h256 m_nextSeed;	///< Epoch the miners were told to prepare.
+	bool m_pregenNoHeight = false;	///< Logged that work without a block number disables pre-generation.
 
 	std::atomic<bool> m_isMining = { false };
 	std::atomic<bool> m_isFee = { false };
@@ -399,13 +564,25 @@ private:
 
 	std::chrono::steady_clock::time_point m_lastStart;
 	int m_hashrateSmoothInterval = 10000;
-	std::thread m_serviceThread;  ///< The IO service thread.
-	boost::asio::io_service m_io_service;
+	boost::asio::io_service& m_io_service = EventLoop::get().service();
+	boost::asio::io_service::strand m_strand{m_io_service};	///< Serialises the timer handlers.
 	boost::asio::deadline_timer * p_hashrateTimer = nullptr;
 	boost::asio::deadline_timer * p_feetimer = nullptr;
 	std::vector<WorkingProgress> m_lastProgresses;
 
+	unsigned m_hwmonInterval = 1000;
+	std::thread m_hwmonThread;  ///< The sensor sampling thread.
+	Mutex x_hwmon;
+	std::condition_variable m_hwmonSignal;
+	bool m_hwmonStop = false;
+
 	mutable SolutionStats m_solutionStats;
+	ShareStats m_shareStats;
+	MetricCounter& m_sharesAccepted = MetricsRegistry::get().counter("ethminer_shares_total", "Shares by pool verdict.", metricLabel("result", "accepted"));
+	MetricCounter& m_sharesAcceptedStale = MetricsRegistry::get().counter("ethminer_shares_total", "Shares by pool verdict.", metricLabel("result", "accepted_stale"));
+	MetricCounter& m_sharesRejected = MetricsRegistry::get().counter("ethminer_shares_total", "Shares by pool verdict.", metricLabel("result", "rejected"));
+	MetricCounter& m_sharesRejectedStale = MetricsRegistry::get().counter("ethminer_shares_total", "Shares by pool verdict.", metricLabel("result", "rejected_stale"));
+	MetricCounter& m_sharesFailed = MetricsRegistry::get().counter("ethminer_shares_total", "Shares by pool verdict.", metricLabel("result", "failed"));
 	std::chrono::steady_clock::time_point m_farm_launched = std::chrono::steady_clock::now();
 
     string m_pool_addresses;
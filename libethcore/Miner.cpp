@@ -1,15 +1,326 @@
 #include "Miner.h"
+#include "BandwidthProbe.h"
 #include "EthashAux.h"
+#include "EventHub.h"
+#include <libdevcore/TaskPool.h>
+#include <libethash/internal.h>
 
 using namespace dev;
 using namespace eth;
 
 unsigned dev::eth::Miner::s_dagLoadMode = 0;
 
-unsigned dev::eth::Miner::s_dagLoadIndex = 0;
+std::atomic<unsigned> dev::eth::Miner::s_dagLoadIndex = {0};
 
 unsigned dev::eth::Miner::s_dagCreateDevice = 0;
 
 uint8_t* dev::eth::Miner::s_dagInHostMemory = NULL;
 
+unsigned dev::eth::Miner::s_thermalTarget = 0;
 
+bool dev::eth::Miner::s_thermalSimulation = false;
+
+unsigned dev::eth::Miner::s_dagCheckInterval = 0;
+
+HealthPolicy dev::eth::Miner::s_healthPolicy;
+
+
+MinerMetrics::MinerMetrics(std::string const& _device):
+	hashes(MetricsRegistry::get().counter("ethminer_hashes_total", "Hashes computed by the device.", metricLabel("device", _device))),
+	hashrate(MetricsRegistry::get().gauge("ethminer_hashrate", "Smoothed device hashrate in hashes per second.", metricLabel("device", _device))),
+	kernelTime(MetricsRegistry::get().histogram("ethminer_kernel_seconds", "Time between completed search batches.", exponentialBuckets(0.001, 2, 14), metricLabel("device", _device))),
+	workSwitch(MetricsRegistry::get().histogram("ethminer_work_switch_seconds", "Latency from receiving a job to the device searching it.", exponentialBuckets(0.0001, 2, 16), metricLabel("device", _device))),
+	dagTime(MetricsRegistry::get().gauge("ethminer_dag_generation_seconds", "Duration of the last DAG generation.", metricLabel("device", _device))),
+	temperature(MetricsRegistry::get().gauge("ethminer_temperature_celsius", "Device temperature.", metricLabel("device", _device))),
+	fan(MetricsRegistry::get().gauge("ethminer_fan_percent", "Device fan speed.", metricLabel("device", _device))),
+	power(MetricsRegistry::get().gauge("ethminer_power_watts", "Device power draw.", metricLabel("device", _device))),
+	coreClock(MetricsRegistry::get().gauge("ethminer_core_clock_mhz", "Device core clock.", metricLabel("device", _device))),
+	memClock(MetricsRegistry::get().gauge("ethminer_memory_clock_mhz", "Device memory clock.", metricLabel("device", _device))),
+	efficiency(MetricsRegistry::get().gauge("ethminer_hashes_per_joule", "Smoothed device hashrate divided by its power draw.", metricLabel("device", _device))),
+	duty(MetricsRegistry::get().gauge("ethminer_duty_cycle", "Fraction of time the thermal controller lets the device search.", metricLabel("device", _device))),
+	dagChecks(MetricsRegistry::get().counter("ethminer_dag_checks_total", "DAG items read back from the device and compared with the host.", metricLabel("device", _device))),
+	dagCorruptions(MetricsRegistry::get().counter("ethminer_dag_corruptions_total", "DAG samples that found the device's DAG corrupted.", metricLabel("device", _device))),
+	health(MetricsRegistry::get().gauge("ethminer_device_health", "Device health: 0 healthy, 1 throttled, 2 quarantined.", metricLabel("device", _device))),
+	intensity(MetricsRegistry::get().gauge("ethminer_device_intensity", "Fraction of its full intensity the health policy lets the device use, raised a step after each quiet window.", metricLabel("device", _device))),
+	effectiveHashrate(MetricsRegistry::get().gauge("ethminer_effective_hashrate", "Hashrate implied by the difficulty of the accepted shares since the device started.", metricLabel("device", _device))),
+	ceiling(MetricsRegistry::get().gauge("ethminer_hashrate_ceiling", "Ethash hashrate allowed by the device's measured random-read bandwidth.", metricLabel("device", _device)))
+{}
+
+MetricGauge& dev::eth::verifyQueueDepth()
+{
+	static MetricGauge& s_gauge = MetricsRegistry::get().gauge("ethminer_verify_queue_depth", "Solutions waiting for CPU verification.");
+	return s_gauge;
+}
+
+Miner::~Miner()
+{
+	drainTasks();
+}
+
+void Miner::drainTasks()
+{
+	std::unique_lock<std::mutex> l(x_tasks);
+	m_draining = true;
+	m_tasksDone.wait(l, [this]() { return !m_tasks; });
+}
+
+Miner::TaskScope::TaskScope(Miner& _m): miner(_m)
+{
+	std::lock_guard<std::mutex> l(miner.x_tasks);
+	++miner.m_tasks;
+}
+
+Miner::TaskScope::~TaskScope()
+{
+	std::lock_guard<std::mutex> l(miner.x_tasks);
+	if (!--miner.m_tasks)
+		miner.m_tasksDone.notify_all();
+}
+
+void Miner::verifyAsync(uint64_t _nonce, WorkPackage const& _w, char const* _device)
+{
+	verifyQueueDepth().add(1);
+	auto found = std::chrono::steady_clock::now();
+	auto scope = std::make_shared<TaskScope>(*this);
+	TaskPool::get().submit([=]()
+	{
+		// Captured so the task stays counted until the pool destroys it, after it ran.
+		(void)scope;
+
+		DEV_TRACE_SCOPE("verify", _nonce);
+		Result r = EthashAux::eval(_w.seed, _w.header, _nonce);
+		verifyQueueDepth().add(-1);
+		if (r.value < _w.boundary)
+			farm.submitProof(Solution{_nonce, r.mixHash, _w, false, (unsigned)index, found});
+		else
+		{
+			farm.failedSolution();
+			clog_limited(WarnChannel, 10, 60000) << "FAILURE:" << _device << "gave incorrect result!";
+			publishError("incorrect result");
+			recordFault(DeviceHealth::IncorrectResult, "incorrect result");
+		}
+	}, TaskPriority::High, index);
+}
+
+void Miner::setBandwidth(double _bytesPerSecond)
+{
+	m_ceiling = ethashCeiling(_bytesPerSecond);
+	m_metrics.ceiling.set(m_ceiling);
+	cnote << name() << "random-read bandwidth" << formatBandwidth(_bytesPerSecond);
+}
+
+void Miner::publishError(std::string const& _what)
+{
+	if (EventHub::get().active())
+		EventHub::get().publish(Event("device_error").add("device", name()).add("error", _what));
+}
+
+bool Miner::beginDag(h256 const& _seed)
+{
+	m_dagBuilding = true;
+	m_dagSlot = DagCoordinator::get().acquire(name(), _seed, m_metrics.hashrate.value(), [this]() { return shouldStop(); });
+	if (!m_dagSlot)
+		m_dagBuilding = false;
+	return (bool)m_dagSlot;
+}
+
+bool Miner::publishDagProgress(unsigned _done, unsigned _total)
+{
+	bool ret = m_dagSlot.progress(_done, _total);
+	if (!EventHub::get().active() || !_total)
+		return ret;
+	unsigned percent = _done * 100 / _total;
+	if (_done && percent / 5 == (_done - 1) * 100 / _total / 5)
+		return ret;
+	EventHub::get().publish(Event("dag_progress").add("device", name()).add("percent", percent));
+	return ret;
+}
+
+std::vector<uint32_t> Miner::dagCheckSample(uint64_t _dagSize)
+{
+	// Enough to catch a DAG with a few percent of bad items within a check or two, few enough
+	// to leave the search undisturbed.
+	static const unsigned c_dagCheckItems = 32;
+
+	std::vector<uint32_t> ret;
+	auto now = std::chrono::steady_clock::now();
+	if (!s_dagCheckInterval || now - m_lastDagCheck < std::chrono::seconds(s_dagCheckInterval) || _dagSize < sizeof(node))
+		return ret;
+	m_lastDagCheck = now;
+	std::uniform_int_distribution<uint32_t> item(0, (uint32_t)(_dagSize / sizeof(node)) - 1);
+	for (unsigned i = 0; i < c_dagCheckItems; ++i)
+		ret.push_back(item(m_dagCheckRng));
+	return ret;
+}
+
+void Miner::verifyDagSample(h256 const& _seed, std::vector<uint32_t> const& _indexes, bytes const& _items)
+{
+	auto scope = std::make_shared<TaskScope>(*this);
+	TaskPool::get().submit([=]()
+	{
+		// Captured so the task stays counted until the pool destroys it, after it ran.
+		(void)scope;
+
+		DEV_TRACE_SCOPE("dag_check", _indexes.size());
+		EthashAux::LightType light = EthashAux::light(_seed);
+		unsigned bad = 0;
+		for (size_t i = 0; i < _indexes.size(); ++i)
+		{
+			node n;
+			ethash_calculate_dag_item(&n, _indexes[i], light->light);
+			if (memcmp(n.bytes, _items.data() + i * sizeof(node), sizeof(node)))
+				++bad;
+		}
+		m_metrics.dagChecks.inc(_indexes.size());
+		if (!bad)
+			return;
+
+		m_metrics.dagCorruptions.inc();
+		m_dagCorruptions.fetch_add(1, std::memory_order_relaxed);
+		cwarn << name() << "DAG corrupted:" << bad << "of" << _indexes.size() << "sampled items differ from the host. Regenerating it.";
+		publishError("corrupted DAG");
+		{
+			Guard l(x_dagCorrupted);
+			m_dagCorrupted = true;
+			m_dagCorruptedSeed = _seed;
+		}
+		recordFault(DeviceHealth::CorruptDag, "corrupted DAG");
+	}, TaskPriority::Low, index);
+}
+
+bool Miner::dagCorrupted(h256 const& _seed)
+{
+	Guard l(x_dagCorrupted);
+	if (!m_dagCorrupted || m_dagCorruptedSeed != _seed)
+		return false;
+	m_dagCorrupted = false;
+	return true;
+}
+
+void Miner::recordFault(DeviceHealth::Fault _fault, std::string const& _what)
+{
+	unsigned actions;
+	DeviceHealth::State state;
+	{
+		Guard l(x_health);
+		actions = m_health.record(_fault);
+		state = m_health.state();
+		m_intensityPermille.store(unsigned(m_health.intensity() * 1000), std::memory_order_relaxed);
+		m_metrics.health.set(state);
+		m_metrics.intensity.set(m_health.intensity());
+	}
+	MetricsRegistry::get().counter("ethminer_device_faults_total", "Device faults by kind.", metricLabel("device", name()) + "," + metricLabel("kind", toString(_fault))).inc();
+
+	if (actions & DeviceHealth::Throttle)
+		cwarn << name() << "keeps failing with" << _what << "- lowering its intensity to" << m_intensityPermille.load() / 10 << "%";
+	if (actions & DeviceHealth::Regenerate)
+	{
+		cwarn << name() << "keeps failing with" << _what << "- regenerating its DAG";
+		Guard l(x_dagCorrupted);
+		m_dagCorrupted = true;
+		m_dagCorruptedSeed = work().seed;
+	}
+	if (actions & DeviceHealth::Quarantine)
+	{
+		cwarn << name() << "keeps failing with" << _what << "- quarantined until the miner restarts";
+		// Pool tasks get here too: once the miner is being destroyed, its virtuals are off limits.
+		std::lock_guard<std::mutex> l(x_tasks);
+		if (!m_draining && !shouldStop())
+		{
+			requestStop();
+			kick_miner();
+			wakeThrottle();
+		}
+	}
+	if (EventHub::get().active())
+		EventHub::get().publish(Event("device_health").add("device", name()).add("fault", toString(_fault)).add("state", toString(state)));
+}
+
+void Miner::checkStall(uint64_t _hashes, bool _haveWork)
+{
+	auto now = std::chrono::steady_clock::now();
+	std::chrono::seconds limit;
+	bool recovered;
+	{
+		Guard l(x_health);
+		limit = m_health.policy().stall;
+		recovered = m_health.recover(now);
+		if (recovered)
+		{
+			m_intensityPermille.store(unsigned(m_health.intensity() * 1000), std::memory_order_relaxed);
+			m_metrics.health.set(m_health.state());
+			m_metrics.intensity.set(m_health.intensity());
+		}
+	}
+	if (recovered)
+		cnote << name() << "has been stable - raising its intensity to" << m_intensityPermille.load() / 10 << "%";
+	if (_hashes || !_haveWork || m_dagBuilding || shouldStop())
+	{
+		m_lastProgress = now;
+		m_stalled = false;
+		return;
+	}
+	if (!limit.count() || m_stalled || now - m_lastProgress < limit)
+		return;
+	// Reported once per stall.
+	m_stalled = true;
+	cwarn << name() << "computed no hashes for" << limit.count() << "s";
+	publishError("stall");
+	recordFault(DeviceHealth::Stall, "stall");
+}
+
+void Miner::updateThermal(HwMonitor& _hw)
+{
+	auto now = std::chrono::steady_clock::now();
+	double dt = m_lastThermalSample == std::chrono::steady_clock::time_point() ? 0 : std::chrono::duration<double>(now - m_lastThermalSample).count();
+	m_lastThermalSample = now;
+
+	if (s_thermalSimulation)
+	{
+		if (!m_thermalModel)
+			m_thermalModel.reset(new SimulatedThermal);
+		_hw.tempC = (int)std::lround(m_thermalModel->step(duty(), dt));
+	}
+
+	if (!s_thermalTarget || _hw.tempC <= 0)
+		return;
+	if (!m_thermalPid)
+		m_thermalPid.reset(new ThermalPid(s_thermalTarget));
+	double d = m_thermalPid->update(_hw.tempC, dt);
+	m_dutyPermille.store(unsigned(d * 1000), std::memory_order_relaxed);
+	m_metrics.duty.set(d);
+}
+
+std::chrono::steady_clock::duration Miner::thermalThrottle(std::chrono::steady_clock::duration _busy)
+{
+	// The health policy lowers the intensity of failing devices through the same duty cycle.
+	unsigned permille = m_dutyPermille.load(std::memory_order_relaxed) * m_intensityPermille.load(std::memory_order_relaxed) / 1000;
+	if (permille >= 1000 || permille == 0)
+		return std::chrono::steady_clock::duration::zero();
+
+	// Idle (1 - duty) / duty of the busy time, capped so a work switch is never held up for long.
+	auto idle = _busy * (1000 - permille) / permille;
+	idle = std::min<std::chrono::steady_clock::duration>(idle, std::chrono::milliseconds(500));
+	DEV_TRACE_SCOPE("thermal_throttle", permille);
+	auto start = std::chrono::steady_clock::now();
+	auto until = start + idle;
+	std::unique_lock<std::mutex> l(x_throttle);
+	while (!m_throttleKicked && !shouldStop())
+	{
+		// Wake up regularly to notice stopWorking(), which does not kick.
+		auto next = std::min(until, std::chrono::steady_clock::now() + std::chrono::milliseconds(20));
+		if (m_throttleWake.wait_until(l, next) == std::cv_status::timeout && next == until)
+			break;
+	}
+	m_throttleKicked = false;
+	return std::chrono::steady_clock::now() - start;
+}
+
+void Miner::wakeThrottle()
+{
+	{
+		std::lock_guard<std::mutex> l(x_throttle);
+		m_throttleKicked = true;
+	}
+	m_throttleWake.notify_one();
+}
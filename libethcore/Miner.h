@@ -21,14 +21,23 @@
 
 #pragma once
 
+#include <condition_variable>
 #include <thread>
 #include <list>
+#include <mutex>
+#include <random>
 #include <string>
 #include <boost/timer.hpp>
 #include <libdevcore/Common.h>
 #include <libdevcore/Log.h>
+#include <libdevcore/Metrics.h>
+#include <libdevcore/StartupTimer.h>
+#include <libdevcore/Trace.h>
 #include <libdevcore/Worker.h>
+#include "DagCoordinator.h"
+#include "DeviceHealth.h"
 #include "EthashAux.h"
+#include "ThermalControl.h"
 
 #define MINER_WAIT_STATE_WORK	 1
 
@@ -62,17 +71,30 @@ enum class MinerType
 	CL,
 	CUDA,
 	Fpga,
+	Sim,
 };
 
 struct HwMonitor
 {
 	int tempC = 0;
 	int fanP = 0;
+	double powerW = 0;		///< Board power draw, 0 if the device does not report it.
+	unsigned coreMHz = 0;	///< Current core clock, 0 if unknown.
+	unsigned memMHz = 0;	///< Current memory clock, 0 if unknown.
 };
 
+/// @returns the efficiency in hashes per joule of a device hashing at @a _rate hashes per second, 0 if the power draw is unknown.
+inline double hashesPerJoule(double _rate, HwMonitor const& _hw)
+{
+	return _hw.powerW > 0 ? _rate / _hw.powerW : 0;
+}
+
 inline std::ostream& operator<<(std::ostream& os, HwMonitor _hw)
 {
-	return os <<  std::fixed << std::setw(3) << _hw.tempC << "C " << std::fixed << std::setw(3) << _hw.fanP << "%";
+	os <<  std::fixed << std::setw(3) << _hw.tempC << "C " << std::fixed << std::setw(3) << _hw.fanP << "%";
+	if (_hw.powerW > 0)
+		os << " " << std::fixed << std::setw(3) << std::setprecision(0) << _hw.powerW << "W";
+	return os;
 }
 
 /// Describes the progress of a mining operation.
@@ -86,6 +108,7 @@ struct WorkingProgress
 	std::vector<string> minersNames;
 	std::vector<uint64_t> minersHashes;
 	std::vector<HwMonitor> minerMonitors;
+	std::vector<double> minersCeilings;	///< Ethash hashrate each device's bandwidth allows, 0 if unknown.
 	uint64_t minerRate(const uint64_t hashCount) const { return ms == 0 ? 0 : hashCount * 1000 / ms; }
 };
 
@@ -111,6 +134,16 @@ inline std::ostream& operator<<(std::ostream& _out, WorkingProgress _p)
 			_out << EthTeal << std::fixed << std::setw(10) << " " << EthReset;
 		}
 		_out << " - " << EthTeal << std::fixed << std::setw(6) << std::setprecision(2) << mh << "Mh/s " << EthReset;
+		if (i < _p.minersCeilings.size() && _p.minersCeilings[i] > 0)
+		{
+			double pct = _p.minerRate(_p.minersHashes[i]) * 100.0 / _p.minersCeilings[i];
+			_out << EthTeal << std::fixed << std::setw(5) << std::setprecision(1) << pct << "% " << EthReset;
+		}
+		if (_p.minerMonitors.size() == _p.minersHashes.size() && _p.minerMonitors[i].powerW > 0)
+		{
+			double mhj = hashesPerJoule(_p.minerRate(_p.minersHashes[i]), _p.minerMonitors[i]) / 1000000.0;
+			_out << EthTeal << std::fixed << std::setw(6) << std::setprecision(3) << mhj << "Mh/J " << EthReset;
+		}
 		_out << "\n";
 	}
 
@@ -150,6 +183,33 @@ inline std::ostream& operator<<(std::ostream& os, SolutionStats s)
 
 class Miner;
 
+/// Per-device performance metrics, labelled with the miner's device name (e.g. device="cl-0").
+struct MinerMetrics
+{
+	explicit MinerMetrics(std::string const& _device);
+
+	MetricCounter& hashes;
+	MetricGauge& hashrate;
+	MetricHistogram& kernelTime;
+	MetricHistogram& workSwitch;
+	MetricGauge& dagTime;
+	MetricGauge& temperature;
+	MetricGauge& fan;
+	MetricGauge& power;
+	MetricGauge& coreClock;
+	MetricGauge& memClock;
+	MetricGauge& efficiency;
+	MetricGauge& duty;
+	MetricCounter& dagChecks;
+	MetricCounter& dagCorruptions;
+	MetricGauge& health;
+	MetricGauge& intensity;
+	MetricGauge& effectiveHashrate;
+	MetricGauge& ceiling;
+};
+
+/// Number of solutions waiting for CPU verification, across all devices.
+MetricGauge& verifyQueueDepth();
 
 /**
  * @brief Class for hosting one or more Miners.
@@ -181,10 +241,14 @@ public:
 	Miner(std::string const& _name, FarmFace& _farm, size_t _index):
 		Worker(_name + std::to_string(_index)),
 		index(_index),
-		farm(_farm)
-	{}
+		farm(_farm),
+		m_metrics(_name + std::to_string(_index))
+	{
+		m_metrics.duty.set(1);
+	}
 
-	virtual ~Miner() = default;
+	/// Waits for the tasks still running; derived classes must have called drainTasks() already.
+	virtual ~Miner();
 
 	void setWork(WorkPackage const& _work)
 	{
@@ -194,18 +258,90 @@ public:
 			workSwitchStart = std::chrono::high_resolution_clock::now();
 		}
 		kick_miner();
+		wakeThrottle();
 	}
 
+	/// Names the seed of the coming epoch, so the miner can build its DAG ahead of the switch.
+	void setNextSeed(h256 const& _seed) { Guard l(x_work); m_nextSeed = _seed; }
+
 	uint64_t hashCount() const { return m_hashCount.load(std::memory_order_relaxed); }
 
 	void resetHashCount() { m_hashCount.store(0, std::memory_order_relaxed); }
 
-	virtual HwMonitor hwmon() = 0;
+	/// @returns the most recent sensor readings published by sampleHwmon(). Never blocks.
+	HwMonitor hwmon() const
+	{
+		HwMonitor hw;
+		hw.tempC = m_hwTempC.load(std::memory_order_relaxed);
+		hw.fanP = m_hwFanP.load(std::memory_order_relaxed);
+		hw.powerW = m_hwPowerMW.load(std::memory_order_relaxed) / 1000.0;
+		hw.coreMHz = m_hwCoreMHz.load(std::memory_order_relaxed);
+		hw.memMHz = m_hwMemMHz.load(std::memory_order_relaxed);
+		return hw;
+	}
+
+	/// Queries the device sensors and publishes the readings. Called by the Farm's sampler thread.
+	void sampleHwmon()
+	{
+		HwMonitor hw = s_thermalSimulation ? HwMonitor() : readHwmon();
+		updateThermal(hw);
+		m_hwTempC.store(hw.tempC, std::memory_order_relaxed);
+		m_hwFanP.store(hw.fanP, std::memory_order_relaxed);
+		m_hwPowerMW.store(unsigned(hw.powerW * 1000), std::memory_order_relaxed);
+		m_hwCoreMHz.store(hw.coreMHz, std::memory_order_relaxed);
+		m_hwMemMHz.store(hw.memMHz, std::memory_order_relaxed);
+		m_metrics.temperature.set(hw.tempC);
+		m_metrics.fan.set(hw.fanP);
+		m_metrics.power.set(hw.powerW);
+		m_metrics.coreClock.set(hw.coreMHz);
+		m_metrics.memClock.set(hw.memMHz);
+	}
 
 	virtual string Name() = 0;
 
 	unsigned Index() { return index; };
 
+	MinerMetrics& metrics() { return m_metrics; }
+
+	/// Holds every device at @a _c degrees Celsius by scaling its duty cycle, 0 disables the controller.
+	static void setThermalTarget(unsigned _c) { s_thermalTarget = _c; }
+	/// Replaces the device sensors by a simulated thermal model driven by the duty cycle.
+	static void setThermalSimulation(bool _simulate) { s_thermalSimulation = _simulate; }
+
+	/// Reads random DAG items back from the devices every @a _seconds and compares them with the
+	/// host, 0 disables the check.
+	static void setDagCheckInterval(unsigned _seconds) { s_dagCheckInterval = _seconds; }
+
+	/// @returns the number of times a DAG check found this device's DAG corrupted.
+	unsigned dagCorruptions() const { return m_dagCorruptions.load(std::memory_order_relaxed); }
+
+	/// Sets the fault rates at which devices are throttled, get their DAG rebuilt or are
+	/// quarantined. Applies to miners created afterwards.
+	static void setHealthPolicy(HealthPolicy const& _policy) { s_healthPolicy = _policy; }
+
+	/// @returns a snapshot of the device's fault counts and state.
+	DeviceHealth health() const { Guard l(x_health); return m_health; }
+
+	/**
+	 * @brief Records a fault of the device and carries out the actions the health policy asks for.
+	 * @param _what Describes the fault in the log.
+	 */
+	void recordFault(DeviceHealth::Fault _fault, std::string const& _what);
+
+	/**
+	 * @brief Reports a stall once the device computed no hashes for the policy's stall time
+	 * while there was work, and gives a throttled device its intensity back once it is stable.
+	 * Called by the Farm each time it collects the hash counts.
+	 * @param _hashes Hashes computed since the previous call.
+	 */
+	void checkStall(uint64_t _hashes, bool _haveWork);
+
+	/// @returns the ethash hashrate the device's measured memory bandwidth allows, 0 if not probed.
+	double ceiling() const { return m_ceiling.load(std::memory_order_relaxed); }
+
+	/// @returns the duty cycle set by the thermal controller, in [0, 1].
+	double duty() const { return m_dutyPermille.load(std::memory_order_relaxed) / 1000.0; }
+
 	uint64_t get_start_nonce()
 	{
 		// Each GPU is given a non-overlapping 2^40 range to search
@@ -219,14 +355,97 @@ protected:
 	 */
 	virtual void kick_miner() = 0;
 
+	/**
+	 * @brief Waits for the verification and DAG check tasks of this miner; after it, they call no
+	 * virtual function. Call it first thing in the destructor of every miner, after stopWorking(),
+	 * while the derived part still exists.
+	 */
+	void drainTasks();
+
+	/// Reads the device sensors. May be slow, never call it from the mining thread.
+	virtual HwMonitor readHwmon() = 0;
+
 	WorkPackage work() const { Guard l(x_work); return m_work; }
 
-	void addHashCount(uint64_t _n) { m_hashCount.fetch_add(_n, std::memory_order_relaxed); }
+	/// @returns the seed set by setNextSeed(), null if there is none.
+	h256 nextSeed() const { Guard l(x_work); return m_nextSeed; }
+
+	/**
+	 * @brief Re-evaluates @a _nonce on the CPU task pool and submits it if it meets the boundary,
+	 * so the device thread can start the next batch right away.
+	 * @param _device Kind of device named in the warning about incorrect results, e.g. "GPU".
+	 */
+	void verifyAsync(uint64_t _nonce, WorkPackage const& _w, char const* _device);
+
+	/// Records the random-read bandwidth measured on the device, in bytes per second.
+	void setBandwidth(double _bytesPerSecond);
+
+	/// Publishes a device_error event.
+	void publishError(std::string const& _what);
+
+	/**
+	 * @brief Waits for the DagCoordinator to let this device build the DAG for @a _seed.
+	 * Faster devices, by their last measured hashrate, are let through first.
+	 * @returns false if the farm moved to another epoch or the miner is stopping meanwhile.
+	 */
+	bool beginDag(h256 const& _seed);
+
+	/// Frees the slot taken by beginDag(). @returns false if the build was cancelled.
+	bool endDag() { m_dagBuilding = false; return m_dagSlot.release(); }
+
+	/**
+	 * @brief Reports DAG progress to the coordinator and publishes a dag_progress event each
+	 * time another 5% of @a _total chunks is done.
+	 * @returns false if the build was cancelled and should be abandoned.
+	 */
+	bool publishDagProgress(unsigned _done, unsigned _total);
+
+	/**
+	 * @brief Idles the device to hold the thermal controller's duty cycle.
+	 * Call from the mining loop while the device is idle, e.g. after reading back a batch.
+	 * New work or a stop cuts the pause short.
+	 * @param _busy Time the device just spent searching.
+	 * @returns the time slept.
+	 */
+	std::chrono::steady_clock::duration thermalThrottle(std::chrono::steady_clock::duration _busy);
+
+	/**
+	 * @brief Picks the DAG items to read back when a DAG check is due.
+	 * @param _dagSize Size in bytes of the device's DAG.
+	 * @returns the indexes of the nodes to read, none if no check is due.
+	 */
+	std::vector<uint32_t> dagCheckSample(uint64_t _dagSize);
+
+	/**
+	 * @brief Compares DAG nodes read from the device with the ones computed from the light of
+	 * @a _seed, on the task pool. A mismatch flags the device and makes dagCorrupted() true.
+	 * @param _items The nodes at @a _indexes, 64 bytes each, in the same order.
+	 */
+	void verifyDagSample(h256 const& _seed, std::vector<uint32_t> const& _indexes, bytes const& _items);
+
+	/// @returns true, once, if a check found the DAG of @a _seed corrupted. The miner should
+	/// regenerate it.
+	bool dagCorrupted(h256 const& _seed);
+
+	void addHashCount(uint64_t _n)
+	{
+		m_hashCount.fetch_add(_n, std::memory_order_relaxed);
+		m_metrics.hashes.inc(_n);
+		if (!m_hashed)
+		{
+			m_hashed = true;
+			StartupTimer::get().firstHash(name());
+		}
+	}
 
 	static unsigned s_dagLoadMode;
-	static unsigned s_dagLoadIndex;
+	static std::atomic<unsigned> s_dagLoadIndex;
 	static unsigned s_dagCreateDevice;
 	static uint8_t* s_dagInHostMemory;
+	static unsigned s_thermalTarget;
+	static bool s_thermalSimulation;
+	static unsigned s_dagCheckInterval;
+	static HealthPolicy s_healthPolicy;
 
 	const size_t index = 0;
 	FarmFace& farm;
@@ -234,8 +453,61 @@ protected:
 
 private:
 	std::atomic<uint64_t> m_hashCount = {0};
+	/// Tasks on the pool that use this miner, and whether drainTasks() started. Under x_tasks.
+	std::mutex x_tasks;
+	std::condition_variable m_tasksDone;
+	unsigned m_tasks = 0;
+	bool m_draining = false;
+
+	/// Counts a pool task of this miner while it exists.
+	struct TaskScope
+	{
+		explicit TaskScope(Miner& _m);
+		~TaskScope();
+		Miner& miner;
+	};
+	MinerMetrics m_metrics;
+	DagCoordinator::Slot m_dagSlot;
+	bool m_hashed = false;	///< Reported its first hashes. Only used by the mining thread.
+
+	std::chrono::steady_clock::time_point m_lastDagCheck;
+	std::mt19937 m_dagCheckRng{std::random_device()()};
+	std::atomic<unsigned> m_dagCorruptions = {0};
+	Mutex x_dagCorrupted;
+	bool m_dagCorrupted = false;	///< A DAG was found corrupted and not yet regenerated.
+	h256 m_dagCorruptedSeed;
+
+	mutable Mutex x_health;
+	DeviceHealth m_health{s_healthPolicy};
+	std::atomic<unsigned> m_intensityPermille = {1000};	///< Set by the health policy, scales the duty cycle.
+	std::atomic<bool> m_dagBuilding = {false};
+	std::atomic<double> m_ceiling = {0};
+
+	/// Ends the pause of thermalThrottle(), or skips the next one if the miner is not pausing.
+	void wakeThrottle();
+
+	std::mutex x_throttle;
+	std::condition_variable m_throttleWake;
+	bool m_throttleKicked = false;
+	std::chrono::steady_clock::time_point m_lastProgress = std::chrono::steady_clock::now();	///< Only used by checkStall().
+	bool m_stalled = false;
+
+	std::atomic<int> m_hwTempC = {0};
+	std::atomic<int> m_hwFanP = {0};
+	std::atomic<unsigned> m_hwPowerMW = {0};
+	std::atomic<unsigned> m_hwCoreMHz = {0};
+	std::atomic<unsigned> m_hwMemMHz = {0};
+
+	/// Runs the thermal controller on a fresh reading, only called from the sampler thread.
+	void updateThermal(HwMonitor& _hw);
+
+	std::unique_ptr<ThermalPid> m_thermalPid;
+	std::unique_ptr<SimulatedThermal> m_thermalModel;
+	std::chrono::steady_clock::time_point m_lastThermalSample;
+	std::atomic<unsigned> m_dutyPermille = {1000};
 
 	WorkPackage m_work;
+	h256 m_nextSeed;
 	mutable Mutex x_work;
 };
 
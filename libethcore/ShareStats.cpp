@@ -0,0 +1,89 @@
+/// Per-device and per-pool share tallies and the effective hashrate they imply.
+///
+/// @file
+/// @copyright GNU General Public License
+
+#include "ShareStats.h"
+#include <cmath>
+#include <libdevcore/Common.h>
+
+using namespace std;
+using namespace dev;
+using namespace eth;
+
+namespace
+{
+
+// Two-sided 99% quantile of the normal distribution.
+double const c_z99 = 2.576;
+
+}
+
+double ShareStats::difficulty(h256 const& _boundary)
+{
+	u256 b = u256(_boundary);
+	return b ? ldexp(1.0, 256) / static_cast<double>(b) : 0;
+}
+
+void ShareStats::addHashes(unsigned _device, uint64_t _hashes, Clock::time_point _now)
+{
+	if (!_hashes)
+		return;
+	Guard l(x_stats);
+	Device& d = m_devices[_device];
+	if (!d.hashes)
+		d.since = _now;
+	d.hashes += _hashes;
+}
+
+void ShareStats::record(unsigned _device, string const& _pool, bool _accepted, bool _stale, double _difficulty)
+{
+	Guard l(x_stats);
+	count(m_pools[_pool], _accepted, _stale);
+	if (_device == c_unknownDevice)
+		return;
+	Device& d = m_devices[_device];
+	count(d.tally, _accepted, _stale);
+	// Stale shares accepted by the pool are useful work all the same.
+	if (_accepted)
+	{
+		d.difficulty += _difficulty;
+		d.difficulty2 += _difficulty * _difficulty;
+	}
+}
+
+void ShareStats::count(ShareTally& _t, bool _accepted, bool _stale)
+{
+	if (_accepted)
+		++(_stale ? _t.acceptedStale : _t.accepted);
+	else
+		++(_stale ? _t.rejectedStale : _t.rejected);
+}
+
+ShareTally ShareStats::device(unsigned _device) const
+{
+	Guard l(x_stats);
+	auto it = m_devices.find(_device);
+	return it == m_devices.end() ? ShareTally() : it->second.tally;
+}
+
+EffectiveHashrate ShareStats::effective(unsigned _device, Clock::time_point _now) const
+{
+	EffectiveHashrate ret;
+	Guard l(x_stats);
+	auto it = m_devices.find(_device);
+	if (it == m_devices.end() || !it->second.hashes)
+		return ret;
+	Device const& d = it->second;
+	double seconds = chrono::duration<double>(_now - d.since).count();
+	if (seconds <= 0)
+		return ret;
+	ret.shares = d.tally.accepted + d.tally.acceptedStale;
+	ret.reported = d.hashes / seconds;
+	ret.effective = d.difficulty / seconds;
+	double margin = c_z99 * sqrt(d.difficulty2) / seconds;
+	ret.low = max(ret.effective - margin, 0.0);
+	ret.high = ret.effective + margin;
+	ret.diverging = ret.shares >= c_minShares && (ret.reported < ret.low || ret.reported > ret.high);
+	return ret;
+}
@@ -0,0 +1,88 @@
+/// Per-device and per-pool share tallies and the effective hashrate they imply.
+///
+/// @file
+/// @copyright GNU General Public License
+
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <libdevcore/FixedHash.h>
+#include <libdevcore/Guards.h>
+
+namespace dev
+{
+namespace eth
+{
+
+/// Shares by pool verdict.
+struct ShareTally
+{
+	unsigned accepted = 0;
+	unsigned rejected = 0;
+	unsigned acceptedStale = 0;
+	unsigned rejectedStale = 0;
+};
+
+/**
+ * @brief Hashrate estimated from the difficulty of the accepted shares.
+ * Finding a share of difficulty D takes D hashes on average, and shares arrive as a Poisson
+ * process; so the accepted difficulty over time estimates the useful hashrate, with a variance
+ * of the sum of the squared difficulties.
+ */
+struct EffectiveHashrate
+{
+	double effective = 0;	///< Hashes per second.
+	double low = 0;			///< Bounds of the 99% confidence interval.
+	double high = 0;
+	double reported = 0;	///< Mean rate the device reported over the same time.
+	unsigned shares = 0;
+	/// The reported rate lies outside the confidence interval, with enough shares to tell.
+	bool diverging = false;
+};
+
+class ShareStats
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	/// Shares needed before a device can be flagged as diverging.
+	static const unsigned c_minShares = 10;
+
+	/// Device of a verdict that matches no submission, counted for its pool only.
+	static const unsigned c_unknownDevice = ~0u;
+
+	/// @returns the expected number of hashes to find a share meeting @a _boundary.
+	static double difficulty(h256 const& _boundary);
+
+	/// Counts @a _hashes computed by @a _device.
+	void addHashes(unsigned _device, uint64_t _hashes, Clock::time_point _now = Clock::now());
+
+	/// Records the verdict on a share of @a _device, or c_unknownDevice, submitted to @a _pool.
+	void record(unsigned _device, std::string const& _pool, bool _accepted, bool _stale, double _difficulty);
+
+	ShareTally device(unsigned _device) const;
+	std::map<std::string, ShareTally> pools() const { Guard l(x_stats); return m_pools; }
+
+	EffectiveHashrate effective(unsigned _device, Clock::time_point _now = Clock::now()) const;
+
+private:
+	struct Device
+	{
+		ShareTally tally;
+		Clock::time_point since;	///< First hashes counted.
+		uint64_t hashes = 0;
+		double difficulty = 0;		///< Sum over the accepted shares.
+		double difficulty2 = 0;		///< Sum of the squares.
+	};
+
+	static void count(ShareTally& _t, bool _accepted, bool _stale);
+
+	mutable Mutex x_stats;
+	std::map<unsigned, Device> m_devices;
+	std::map<std::string, ShareTally> m_pools;
+};
+
+}
+}
@@ -0,0 +1,194 @@
+/// Simulated mining device for scaling tests without hardware.
+///
+/// @file
+/// @copyright GNU General Public License
+
+#include "SimMiner.h"
+
+#include <cmath>
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+struct SimChannel: public LogChannel { static const char* name() { return "sim"; } static const int verbosity = 2; static const bool debug = false; };
+#define simlog clog(SimChannel)
+
+unsigned SimMiner::s_numInstances = 1;
+
+SimSettings SimMiner::s_settings;
+
+SimMiner::SimMiner(FarmFace& _farm, unsigned _index):
+	Miner("sim-", _farm, _index),
+	m_rng(random_device{}() ^ _index)
+{}
+
+SimMiner::~SimMiner()
+{
+	stopWorking();
+	drainTasks();
+	kick_miner();
+}
+
+void SimMiner::kick_miner()
+{
+	{
+		lock_guard<mutex> l(x_kick);
+		m_kicked = true;
+	}
+	m_kick.notify_one();
+}
+
+bool SimMiner::wait(chrono::steady_clock::duration _duration, bool _kickable)
+{
+	auto until = chrono::steady_clock::now() + _duration;
+	unique_lock<mutex> l(x_kick);
+	while (!(m_kicked && _kickable) && !shouldStop())
+	{
+		// Wake up regularly to notice stopWorking(), which does not kick.
+		auto next = min(until, chrono::steady_clock::now() + chrono::milliseconds(100));
+		if (m_kick.wait_until(l, next) == cv_status::timeout && next == until)
+			break;
+	}
+	bool kicked = m_kicked;
+	m_kicked = false;
+	return kicked;
+}
+
+HwMonitor SimMiner::readHwmon()
+{
+	HwMonitor hw;
+	hw.tempC = 60 + index % 10;
+	hw.fanP = 50;
+	hw.powerW = s_settings.hashrate / 250e3;	// 0.25 Mh/J
+	return hw;
+}
+
+void SimMiner::findSolution(WorkPackage const& _w, uint64_t _nonce, uint64_t _batch)
+{
+	h256 boundary = max(_w.boundary, h256(u256(1) << (256 - min(s_settings.difficultyBits, 255u))));
+	uint64_t tries = min<uint64_t>(_batch, 4096);
+	for (uint64_t i = 0; i < tries && !shouldStop(); ++i)
+	{
+		DEV_TRACE_SCOPE("verify", _nonce + i);
+		Result r = EthashAux::eval(_w.seed, _w.header, _nonce + i);
+		if (r.value < boundary)
+		{
+			if (uniform() < s_settings.badSolutionRate)
+				farm.submitProof(Solution{_nonce + i + 1, r.mixHash, _w, false, (unsigned)index, chrono::steady_clock::now()});
+			else
+				farm.submitProof(Solution{_nonce + i, r.mixHash, _w, false, (unsigned)index, chrono::steady_clock::now()});
+			return;
+		}
+	}
+}
+
+void SimMiner::workLoop()
+{
+	WorkPackage current;
+	uint64_t startNonce = 0;
+	std::chrono::steady_clock::time_point lastBatch;
+
+	while (!shouldStop())
+	{
+		const WorkPackage w = work();
+		if (!w)
+		{
+			wait(chrono::milliseconds(500), true);
+			continue;
+		}
+
+		bool regenerate = dagCorrupted(w.seed);
+		if (current.header != w.header || regenerate)
+		{
+			if (current.seed != w.seed && m_nextSeed == w.seed && m_nextChunks == 100)
+			{
+				simlog << "Switched to the pre-generated DAG of" << w.seed;
+				metrics().dagTime.set(0);
+			}
+			else if (current.seed != w.seed || regenerate)
+			{
+				if (!beginDag(w.seed))
+					continue;
+				simlog << "New seed" << w.seed;
+				auto dagStart = chrono::steady_clock::now();
+				for (unsigned i = 0; s_settings.dagMs && i < 100 && !shouldStop(); ++i)
+				{
+					this_thread::sleep_for(chrono::milliseconds(s_settings.dagMs) / 100);
+					if (!publishDagProgress(i + 1, 100))
+						break;
+				}
+				if (!endDag())
+					continue;
+				StartupTimer::get().record(name() + " DAG", dagStart);
+				metrics().dagTime.set(chrono::duration<double>(chrono::steady_clock::now() - dagStart).count());
+			}
+
+			if (w.exSizeBits >= 0)
+				startNonce = w.startNonce | ((uint64_t)index << (64 - 4 - w.exSizeBits));
+			else
+				startNonce = get_start_nonce();
+			current = w;
+			metrics().workSwitch.observe(chrono::duration<double>(chrono::high_resolution_clock::now() - workSwitchStart).count());
+			lastBatch = std::chrono::steady_clock::time_point();
+		}
+
+		if (s_settings.failureRate > 0 && uniform() < s_settings.failureRate)
+		{
+			publishError("simulated hang");
+			clog_limited(WarnChannel, 10, 60000) << "Simulated device" << index << "hangs for" << s_settings.hangMs << "ms";
+			auto until = chrono::steady_clock::now() + chrono::milliseconds(s_settings.hangMs);
+			while (!shouldStop() && chrono::steady_clock::now() < until)
+				this_thread::sleep_for(chrono::milliseconds(100));
+			lastBatch = std::chrono::steady_clock::time_point();
+			continue;
+		}
+
+		double ms = s_settings.kernelMs * (1 + s_settings.jitter * (2 * uniform() - 1));
+		auto kernel = chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double, milli>(max(ms, 0.0)));
+		auto kernelStart = chrono::steady_clock::now();
+		DEV_TRACE_INSTANT("kernel_enqueue", startNonce);
+		// Like a GPU kernel, a batch runs to completion on the job it was started with, even when
+		// a new job arrives meanwhile.
+		wait(kernel, false);
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - kernelStart).count();
+		uint64_t batch = (uint64_t)(s_settings.hashrate * seconds);
+		DEV_TRACE_INSTANT("kernel_complete", startNonce);
+
+		auto batchEnd = std::chrono::steady_clock::now();
+		if (lastBatch != std::chrono::steady_clock::time_point())
+		{
+			metrics().kernelTime.observe(std::chrono::duration<double>(batchEnd - lastBatch).count());
+			batchEnd += thermalThrottle(batchEnd - lastBatch);
+		}
+		lastBatch = batchEnd;
+
+		double chance = s_settings.solutionRate;
+		if (s_settings.poolDifficulty)
+			chance = 1 - exp(-(double)batch * ldexp(static_cast<double>(u256(current.boundary)), -256));
+		if (uniform() < chance)
+			findSolution(current, startNonce, batch);
+
+		addHashCount(batch);
+		startNonce += batch;
+		prepareNextEpoch(current.seed);
+	}
+}
+
+void SimMiner::prepareNextEpoch(h256 const& _current)
+{
+	h256 next = nextSeed();
+	if (!next || next == _current)
+		return;
+	if (next != m_nextSeed)
+	{
+		m_nextSeed = next;
+		m_nextChunks = 0;
+		simlog << "Pre-generating the DAG of" << next;
+	}
+	if (m_nextChunks == 100)
+		return;
+	this_thread::sleep_for(chrono::milliseconds(s_settings.dagMs) / 100);
+	if (++m_nextChunks == 100)
+		simlog << "DAG of the next epoch ready";
+}
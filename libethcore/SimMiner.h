@@ -0,0 +1,78 @@
+/// Simulated mining device for scaling tests without hardware.
+///
+/// @file
+/// @copyright GNU General Public License
+
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include "Miner.h"
+
+namespace dev
+{
+namespace eth
+{
+
+/// Behaviour of every simulated device.
+struct SimSettings
+{
+	double hashrate = 30e6;			///< Hashes per second of each device.
+	unsigned kernelMs = 50;			///< Duration of one search batch.
+	double jitter = 0.1;			///< Relative random variation of the batch duration.
+	unsigned dagMs = 0;				///< Duration of a simulated DAG generation on each epoch change.
+	double failureRate = 0;			///< Probability per batch that the device hangs for hangMs.
+	unsigned hangMs = 10000;
+	double solutionRate = 0.01;		///< Probability per batch of finding a solution.
+	bool poolDifficulty = false;	///< Find solutions as often as the work's boundary implies for the batch instead.
+	double badSolutionRate = 0;		///< Fraction of solutions reported with a wrong nonce.
+	unsigned difficultyBits = 4;	///< Solutions meet a boundary of 2^(256 - bits), or the work's if that is easier.
+};
+
+/**
+ * @brief Miner that pretends to hash at a configured rate.
+ * Nonces come from the real nonce allocation, and solutions are found by evaluating ethash on the
+ * CPU, so they verify against the simulated difficulty.
+ */
+class SimMiner: public Miner
+{
+public:
+	SimMiner(FarmFace& _farm, unsigned _index);
+	~SimMiner();
+
+	static unsigned instances() { return s_numInstances; }
+	static void setNumInstances(unsigned _instances) { s_numInstances = _instances; }
+	static SimSettings& settings() { return s_settings; }
+
+	string Name() override { return "simulated"; }
+
+protected:
+	void kick_miner() override;
+	HwMonitor readHwmon() override;
+
+private:
+	void workLoop() override;
+
+	/// Waits up to @a _duration, returns early when stopping or, if @a _kickable, when kicked. @returns true if kicked.
+	bool wait(std::chrono::steady_clock::duration _duration, bool _kickable);
+	/// Searches the batch starting at @a _nonce on the CPU and submits the first nonce meeting the boundary.
+	void findSolution(WorkPackage const& _w, uint64_t _nonce, uint64_t _batch);
+	double uniform() { return std::uniform_real_distribution<double>(0, 1)(m_rng); }
+	/// Generates one of the 100 chunks of the next epoch's DAG after a batch, like a DAG kernel
+	/// queued behind the search.
+	void prepareNextEpoch(h256 const& _current);
+
+	static unsigned s_numInstances;
+	static SimSettings s_settings;
+
+	std::mutex x_kick;
+	std::condition_variable m_kick;
+	bool m_kicked = false;
+	std::mt19937_64 m_rng;
+	h256 m_nextSeed;			///< Epoch whose DAG is being generated ahead.
+	unsigned m_nextChunks = 0;	///< Chunks of it done so far.
+};
+
+}
+}
@@ -0,0 +1,48 @@
+/// Thermal-target duty cycle controller.
+///
+/// @file
+/// @copyright GNU General Public License
+
+#include "ThermalControl.h"
+
+#include <algorithm>
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+ThermalPid::ThermalPid(double _targetC, double _kp, double _ki, double _kd, double _minDuty):
+	m_target(_targetC), m_kp(_kp), m_ki(_ki), m_kd(_kd), m_minDuty(_minDuty)
+{}
+
+double ThermalPid::update(double _tempC, double _dt)
+{
+	if (_dt <= 0)
+		return m_duty;
+
+	// Positive error means too hot. The derivative is taken on the measurement so changing
+	// the target does not kick the output.
+	double error = _tempC - m_target;
+	double derivative = m_haveLast ? (_tempC - m_lastTemp) / _dt : 0;
+	m_lastTemp = _tempC;
+	m_haveLast = true;
+
+	double integral = m_integral + error * _dt;
+	double out = 1 - (m_kp * error + m_ki * integral + m_kd * derivative);
+	double clamped = max(m_minDuty, min(1.0, out));
+
+	// Anti windup: only keep integrating while the output is not pinned at a limit, or when the
+	// error drives it back into range.
+	if (out == clamped || (out > 1 && error > 0) || (out < m_minDuty && error < 0))
+		m_integral = integral;
+
+	m_duty = clamped;
+	return m_duty;
+}
+
+double SimulatedThermal::step(double _duty, double _dt)
+{
+	double equilibrium = m_ambient + m_gain * _duty;
+	m_temp += (equilibrium - m_temp) * min(1.0, _dt / m_tau);
+	return m_temp;
+}
@@ -0,0 +1,66 @@
+/// Thermal-target duty cycle controller.
+///
+/// @file
+/// @copyright GNU General Public License
+
+#pragma once
+
+namespace dev
+{
+namespace eth
+{
+
+/**
+ * @brief PID controller holding a device at a target temperature by scaling its duty cycle,
+ * the fraction of time the device spends searching.
+ * Starts at full duty; only backs off once the device runs hotter than the target.
+ */
+class ThermalPid
+{
+public:
+	explicit ThermalPid(double _targetC, double _kp = 0.05, double _ki = 0.005, double _kd = 0.1, double _minDuty = 0.2);
+
+	/// Feeds a reading taken @a _dt seconds after the previous one. @returns the new duty cycle in [minDuty, 1].
+	double update(double _tempC, double _dt);
+
+	double duty() const { return m_duty; }
+	double target() const { return m_target; }
+
+private:
+	double m_target;
+	double m_kp;
+	double m_ki;
+	double m_kd;
+	double m_minDuty;
+
+	double m_integral = 0;
+	double m_lastTemp = 0;
+	bool m_haveLast = false;
+	double m_duty = 1;
+};
+
+/**
+ * @brief First order thermal model standing in for a real sensor.
+ * The temperature relaxes towards ambient + gain * duty with time constant tau.
+ */
+class SimulatedThermal
+{
+public:
+	explicit SimulatedThermal(double _ambientC = 35, double _gainC = 50, double _tauSeconds = 20):
+		m_ambient(_ambientC), m_gain(_gainC), m_tau(_tauSeconds), m_temp(_ambientC)
+	{}
+
+	/// Advances the model by @a _dt seconds at duty cycle @a _duty. @returns the new temperature.
+	double step(double _duty, double _dt);
+
+	double temperature() const { return m_temp; }
+
+private:
+	double m_ambient;
+	double m_gain;
+	double m_tau;
+	double m_temp;
+};
+
+}
+}
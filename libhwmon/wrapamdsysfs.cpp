@@ -17,6 +17,8 @@
 #include <sys/types.h>
 #if defined(__linux)
 #include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 #include "wrapamdsysfs.h"
 
@@ -35,6 +37,62 @@ static bool getFileContentValue(const char* filename, unsigned int& value)
 	return (p != p2);
 }
 
+static std::string s_root = "/sys";
+
+void wrap_amdsysfs_set_root(const char *root)
+{
+	s_root = root;
+}
+
+#if defined(__linux)
+// Sensor files are kept open and re-read from offset 0, sysfs regenerates their content
+// on every read. This avoids an open/close pair per reading.
+static bool getFdContentValue(int fd, unsigned int& value)
+{
+	value = 0;
+	if (fd < 0)
+		return false;
+	char buf[32];
+	ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+	if (n <= 0)
+		return false;
+	buf[n] = 0;
+	char* p2;
+	errno = 0;
+	value = strtoul(buf, &p2, 0);
+	if (errno != 0)
+		return false;
+	return (buf != p2);
+}
+
+// pp_dpm_sclk/pp_dpm_mclk list the clock levels one per line, e.g. "1: 1000Mhz *",
+// the active level is marked with a '*'.
+static bool getFdActiveClock(int fd, unsigned int& value)
+{
+	value = 0;
+	if (fd < 0)
+		return false;
+	char buf[512];
+	ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+	if (n <= 0)
+		return false;
+	buf[n] = 0;
+	for (char* line = buf; line && *line; )
+	{
+		char* end = strchr(line, '\n');
+		if (end)
+			*end = 0;
+		const char* colon = strchr(line, ':');
+		if (colon && strchr(colon, '*'))
+		{
+			value = strtoul(colon + 1, nullptr, 10);
+			return value != 0;
+		}
+		line = end ? end + 1 : nullptr;
+	}
+	return false;
+}
+#endif
 
 wrap_amdsysfs_handle * wrap_amdsysfs_create()
 {
@@ -43,9 +101,12 @@ wrap_amdsysfs_handle * wrap_amdsysfs_create()
 #if defined(__linux)
 	sysfsh = (wrap_amdsysfs_handle *)calloc(1, sizeof(wrap_amdsysfs_handle));
 
-	DIR* dirp = opendir("/sys/class/drm");
-	if (dirp == nullptr)
+	std::string drm = s_root + "/class/drm";
+	DIR* dirp = opendir(drm.c_str());
+	if (dirp == nullptr) {
+		free(sysfsh);
 		return NULL;
+	}
 
 	unsigned int gpucount = 0;
 	struct dirent* dire;
@@ -71,14 +132,14 @@ wrap_amdsysfs_handle * wrap_amdsysfs_create()
 	sysfsh->sysfs_hwmon_id = (int*)calloc(gpucount, sizeof(int));
 
 	// filter AMD GPU cards and create mappings
-	char dbuf[120];
+	char dbuf[512];
 	int cardIndex = 0;
 	for (unsigned int i = 0; i < gpucount; i++)
 	{
 		sysfsh->card_sysfs_device_id[cardIndex] = -1;
 		sysfsh->sysfs_hwmon_id[cardIndex] = -1;
 
-		snprintf(dbuf, 120, "/sys/class/drm/card%u/device/vendor", i);
+		snprintf(dbuf, sizeof(dbuf), "%s/card%u/device/vendor", drm.c_str(), i);
 		unsigned int vendorId = 0;
 		if (!getFileContentValue(dbuf, vendorId))
 			continue;
@@ -105,7 +166,7 @@ wrap_amdsysfs_handle * wrap_amdsysfs_create()
 
 		// search hwmon
 		errno = 0;
-		snprintf(dbuf, 120, "/sys/class/drm/card%u/device/hwmon", sysfsIdx);
+		snprintf(dbuf, sizeof(dbuf), "%s/card%u/device/hwmon", drm.c_str(), sysfsIdx);
 		DIR* dirp = opendir(dbuf);
 		if (dirp == nullptr) {
 			free(sysfsh);
@@ -140,12 +201,67 @@ wrap_amdsysfs_handle * wrap_amdsysfs_create()
 
 		sysfsh->sysfs_hwmon_id[i] = hwmonIndex;
 	}
+
+	// Open the sensor files once
+	sysfsh->temp_fd = (int*)calloc(gpucount, sizeof(int));
+	sysfsh->pwm_fd = (int*)calloc(gpucount, sizeof(int));
+	sysfsh->pwm_max = (unsigned int*)calloc(gpucount, sizeof(unsigned int));
+	sysfsh->pwm_min = (unsigned int*)calloc(gpucount, sizeof(unsigned int));
+	sysfsh->power_fd = (int*)calloc(gpucount, sizeof(int));
+	sysfsh->sclk_fd = (int*)calloc(gpucount, sizeof(int));
+	sysfsh->mclk_fd = (int*)calloc(gpucount, sizeof(int));
+	for (int i = 0; i < sysfsh->sysfs_gpucount; i++)
+	{
+		int gpuindex = sysfsh->card_sysfs_device_id[i];
+		int hwmonindex = sysfsh->sysfs_hwmon_id[i];
+
+		snprintf(dbuf, sizeof(dbuf), "%s/card%u/device/hwmon/hwmon%u/temp1_input", drm.c_str(), gpuindex, hwmonindex);
+		sysfsh->temp_fd[i] = open(dbuf, O_RDONLY | O_CLOEXEC);
+		snprintf(dbuf, sizeof(dbuf), "%s/card%u/device/hwmon/hwmon%u/pwm1", drm.c_str(), gpuindex, hwmonindex);
+		sysfsh->pwm_fd[i] = open(dbuf, O_RDONLY | O_CLOEXEC);
+		snprintf(dbuf, sizeof(dbuf), "%s/card%u/device/hwmon/hwmon%u/power1_average", drm.c_str(), gpuindex, hwmonindex);
+		sysfsh->power_fd[i] = open(dbuf, O_RDONLY | O_CLOEXEC);
+		snprintf(dbuf, sizeof(dbuf), "%s/card%u/device/pp_dpm_sclk", drm.c_str(), gpuindex);
+		sysfsh->sclk_fd[i] = open(dbuf, O_RDONLY | O_CLOEXEC);
+		snprintf(dbuf, sizeof(dbuf), "%s/card%u/device/pp_dpm_mclk", drm.c_str(), gpuindex);
+		sysfsh->mclk_fd[i] = open(dbuf, O_RDONLY | O_CLOEXEC);
+
+		sysfsh->pwm_max[i] = 255;
+		snprintf(dbuf, sizeof(dbuf), "%s/card%u/device/hwmon/hwmon%u/pwm1_max", drm.c_str(), gpuindex, hwmonindex);
+		getFileContentValue(dbuf, sysfsh->pwm_max[i]);
+		snprintf(dbuf, sizeof(dbuf), "%s/card%u/device/hwmon/hwmon%u/pwm1_min", drm.c_str(), gpuindex, hwmonindex);
+		getFileContentValue(dbuf, sysfsh->pwm_min[i]);
+	}
 #endif
 
 	return sysfsh;
 }
 int wrap_amdsysfs_destory(wrap_amdsysfs_handle *sysfsh)
 {
+#if defined(__linux)
+	for (int i = 0; i < sysfsh->sysfs_gpucount; i++)
+	{
+		if (sysfsh->temp_fd && sysfsh->temp_fd[i] >= 0)
+			close(sysfsh->temp_fd[i]);
+		if (sysfsh->pwm_fd && sysfsh->pwm_fd[i] >= 0)
+			close(sysfsh->pwm_fd[i]);
+		if (sysfsh->power_fd && sysfsh->power_fd[i] >= 0)
+			close(sysfsh->power_fd[i]);
+		if (sysfsh->sclk_fd && sysfsh->sclk_fd[i] >= 0)
+			close(sysfsh->sclk_fd[i]);
+		if (sysfsh->mclk_fd && sysfsh->mclk_fd[i] >= 0)
+			close(sysfsh->mclk_fd[i]);
+	}
+#endif
+	free(sysfsh->card_sysfs_device_id);
+	free(sysfsh->sysfs_hwmon_id);
+	free(sysfsh->temp_fd);
+	free(sysfsh->pwm_fd);
+	free(sysfsh->pwm_max);
+	free(sysfsh->pwm_min);
+	free(sysfsh->power_fd);
+	free(sysfsh->sclk_fd);
+	free(sysfsh->mclk_fd);
 	free(sysfsh);
 	return 0;
 }
@@ -166,12 +282,10 @@ int wrap_amdsysfs_get_tempC(wrap_amdsysfs_handle *sysfsh, int index, unsigned in
 	if (hwmonindex < 0)
 		return -1;
 
-	char dbuf[120];
-	snprintf(dbuf, 120, "/sys/class/drm/card%u/device/hwmon/hwmon%u/temp1_input",
-		gpuindex, hwmonindex);
-
 	unsigned int temp = 0;
-	getFileContentValue(dbuf, temp);
+#if defined(__linux)
+	getFdContentValue(sysfsh->temp_fd[index], temp);
+#endif
 
 	if (temp > 0)
 		*tempC = temp / 1000;
@@ -189,21 +303,45 @@ int wrap_amdsysfs_get_fanpcnt(wrap_amdsysfs_handle *sysfsh, int index, unsigned
 	if (hwmonindex < 0)
 		return -1;
 
-	unsigned int pwm = 0, pwmMax = 255, pwmMin = 0;
+	unsigned int pwm = 0, pwmMax = sysfsh->pwm_max[index], pwmMin = sysfsh->pwm_min[index];
+#if defined(__linux)
+	getFdContentValue(sysfsh->pwm_fd[index], pwm);
+#endif
+	if (pwmMax <= pwmMin)
+		return -1;
 
-	char dbuf[120];
-	snprintf(dbuf, 120, "/sys/class/drm/card%u/device/hwmon/hwmon%u/pwm1",
-		gpuindex, hwmonindex);
-	getFileContentValue(dbuf, pwm);
+	*fanpcnt = double(pwm - pwmMin) / double(pwmMax - pwmMin) * 100.0;
+	return 0;
+}
+int wrap_amdsysfs_get_power_usage(wrap_amdsysfs_handle *sysfsh, int index, unsigned int *milliwatts)
+{
+	if (index < 0 || index >= sysfsh->sysfs_gpucount || sysfsh->card_sysfs_device_id[index] < 0)
+		return -1;
 
-	snprintf(dbuf, 120, "/sys/class/drm/card%u/device/hwmon/hwmon%u/pwm1_max",
-		gpuindex, hwmonindex);
-	getFileContentValue(dbuf, pwmMax);
+	unsigned int microwatts = 0;
+#if defined(__linux)
+	if (!getFdContentValue(sysfsh->power_fd[index], microwatts))
+		return -1;
+#endif
 
-	snprintf(dbuf, 120, "/sys/class/drm/card%u/device/hwmon/hwmon%u/pwm1_min",
-		gpuindex, hwmonindex);
-	getFileContentValue(dbuf, pwmMin);
+	*milliwatts = microwatts / 1000;
+	return 0;
+}
 
-	*fanpcnt = double(pwm - pwmMin) / double(pwmMax - pwmMin) * 100.0;
+int wrap_amdsysfs_get_clocks(wrap_amdsysfs_handle *sysfsh, int index, unsigned int *coreMHz, unsigned int *memMHz)
+{
+	if (index < 0 || index >= sysfsh->sysfs_gpucount || sysfsh->card_sysfs_device_id[index] < 0)
+		return -1;
+
+	unsigned int core = 0, mem = 0;
+#if defined(__linux)
+	getFdActiveClock(sysfsh->sclk_fd[index], core);
+	getFdActiveClock(sysfsh->mclk_fd[index], mem);
+#endif
+	if (core == 0 && mem == 0)
+		return -1;
+
+	*coreMHz = core;
+	*memMHz = mem;
 	return 0;
-}
\ No newline at end of file
+}
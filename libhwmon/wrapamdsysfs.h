@@ -11,8 +11,21 @@ typedef struct {
 	int sysfs_gpucount;
 	int *card_sysfs_device_id;  /* map cardidx to filesystem card idx */
 	int *sysfs_hwmon_id;        /* filesystem card idx to filesystem hwmon idx */
+	int *temp_fd;               /* persistent descriptor of temp1_input, -1 if unavailable */
+	int *pwm_fd;                /* persistent descriptor of pwm1, -1 if unavailable */
+	unsigned int *pwm_max;      /* pwm1_max, read once */
+	unsigned int *pwm_min;      /* pwm1_min, read once */
+	int *power_fd;              /* persistent descriptor of power1_average, -1 if unavailable */
+	int *sclk_fd;               /* persistent descriptor of pp_dpm_sclk, -1 if unavailable */
+	int *mclk_fd;               /* persistent descriptor of pp_dpm_mclk, -1 if unavailable */
 } wrap_amdsysfs_handle;
 
+/*
+ * Sets the sysfs mount point used by wrap_amdsysfs_create(), "/sys" by default.
+ * Allows pointing the wrapper at a fake tree laid out like /sys/class/drm.
+ */
+void wrap_amdsysfs_set_root(const char *root);
+
 wrap_amdsysfs_handle * wrap_amdsysfs_create();
 int wrap_amdsysfs_destory(wrap_amdsysfs_handle *sysfsh);
 
@@ -22,4 +35,14 @@ int wrap_amdsysfs_get_tempC(wrap_amdsysfs_handle *sysfsh, int index, unsigned in
 
 int wrap_amdsysfs_get_fanpcnt(wrap_amdsysfs_handle *sysfsh, int index, unsigned int *fanpcnt);
 
+/*
+ * Average power draw in milliwatts (power1_average)
+ */
+int wrap_amdsysfs_get_power_usage(wrap_amdsysfs_handle *sysfsh, int index, unsigned int *milliwatts);
+
+/*
+ * Current core and memory clocks in MHz, the active levels of pp_dpm_sclk and pp_dpm_mclk
+ */
+int wrap_amdsysfs_get_clocks(wrap_amdsysfs_handle *sysfsh, int index, unsigned int *coreMHz, unsigned int *memMHz);
+
 #endif
\ No newline at end of file
@@ -87,6 +87,9 @@ return NULL;
     wrap_dlsym(nvmlh->nvml_dll, "nvmlDeviceGetFanSpeed");
   nvmlh->nvmlDeviceGetPowerUsage = (wrap_nvmlReturn_t (*)(wrap_nvmlDevice_t, unsigned int *))
     wrap_dlsym(nvmlh->nvml_dll, "nvmlDeviceGetPowerUsage");
+  /* optional, not checked below */
+  nvmlh->nvmlDeviceGetClockInfo = (wrap_nvmlReturn_t (*)(wrap_nvmlDevice_t, int, unsigned int *))
+    wrap_dlsym(nvmlh->nvml_dll, "nvmlDeviceGetClockInfo");
   nvmlh->nvmlShutdown = (wrap_nvmlReturn_t (*)())
     wrap_dlsym(nvmlh->nvml_dll, "nvmlShutdown");
 
@@ -253,6 +256,22 @@ int wrap_nvml_get_power_usage(wrap_nvml_handle *nvmlh,
 }
 
 
+int wrap_nvml_get_clocks(wrap_nvml_handle *nvmlh,
+                         int gpuindex,
+                         unsigned int *coreMHz,
+                         unsigned int *memMHz) {
+  if (gpuindex < 0 || gpuindex >= nvmlh->nvml_gpucount || nvmlh->nvmlDeviceGetClockInfo == NULL)
+    return -1;
+
+  if (nvmlh->nvmlDeviceGetClockInfo(nvmlh->devs[gpuindex], 0 /* NVML_CLOCK_GRAPHICS */, coreMHz) != WRAPNVML_SUCCESS)
+    return -1;
+  if (nvmlh->nvmlDeviceGetClockInfo(nvmlh->devs[gpuindex], 2 /* NVML_CLOCK_MEM */, memMHz) != WRAPNVML_SUCCESS)
+    return -1;
+
+  return 0;
+}
+
+
 #if defined(__cplusplus)
 }
 #endif
@@ -69,6 +69,7 @@ typedef struct {
   wrap_nvmlReturn_t (*nvmlDeviceGetTemperature)(wrap_nvmlDevice_t, int, unsigned int *);
   wrap_nvmlReturn_t (*nvmlDeviceGetFanSpeed)(wrap_nvmlDevice_t, unsigned int *);
   wrap_nvmlReturn_t (*nvmlDeviceGetPowerUsage)(wrap_nvmlDevice_t, unsigned int *);
+  wrap_nvmlReturn_t (*nvmlDeviceGetClockInfo)(wrap_nvmlDevice_t, int, unsigned int *);
   wrap_nvmlReturn_t (*nvmlShutdown)(void);
 } wrap_nvml_handle;
 
@@ -119,6 +120,16 @@ int wrap_nvml_get_power_usage(wrap_nvml_handle *nvmlh,
                               int gpuindex,
                               unsigned int *milliwatts);
 
+/*
+ * Query the current graphics and memory clocks in MHz from the CUDA device ID
+ *
+ * nvmlDeviceGetClockInfo is optional, if the driver lacks it this routine returns -1.
+ */
+int wrap_nvml_get_clocks(wrap_nvml_handle *nvmlh,
+                         int gpuindex,
+                         unsigned int *coreMHz,
+                         unsigned int *memMHz);
+
 
 #if defined(__cplusplus)
 }
@@ -1,6 +1,7 @@
  
 #include "EthStratumClient.h"
 #include <libdevcore/Log.h>
+#include <libdevcore/Trace.h>
 #include <libethash/endian.h>
 using boost::asio::ip::tcp;
 
@@ -28,9 +29,13 @@ static void diffToTarget(uint32_t *target, double diff)
 
 
 EthStratumClient::EthStratumClient(Farm* f, MinerType m, string const & host, string const & port, string const & user, string const & pass, int const & retries, int const & worktimeout, int const & protocol, string const & email)
-        :   m_socket(m_io_service),
+        :   m_io_service(EventLoop::get().service()),
+	        m_strand(m_io_service),
+	        m_resolver(m_io_service),
+	        m_socket(m_io_service),
 	        m_worktimer(m_io_service),
-		    m_switchtimer(m_io_service)
+		    m_switchtimer(m_io_service),
+		    m_reconnecttimer(m_io_service)
 {
 	m_minerType = m;
 	m_primary.host = host;
@@ -51,13 +56,23 @@ EthStratumClient::EthStratumClient(Farm* f, MinerType m, string const & host, st
 	m_submit_hashrate_id = h256::random().hex();
 	
 	p_farm = f;
-	connect();
+	m_strand.post([this]() { connect(); });
 }
 
 EthStratumClient::~EthStratumClient()
 {
-	m_io_service.stop();
-	m_serviceThread.join();
+	EventLoop::get().run(m_strand, [&]()
+	{
+		m_running = false;
+		m_connected.store(false, std::memory_order_relaxed);
+		m_resolver.cancel();
+		m_worktimer.cancel();
+		m_switchtimer.cancel();
+		m_reconnecttimer.cancel();
+		boost::system::error_code ignored;
+		m_socket.close(ignored);
+	});
+	EventLoop::get().drain(m_strand);
 }
 
 void EthStratumClient::setFailover(string const & host, string const & port)
@@ -83,82 +98,85 @@ void EthStratumClient::setFee(string const & host, string const & port, string c
 
 void EthStratumClient::connect()
 {
-	tcp::resolver r(m_io_service);
+	{
+		// Responses to shares sent over a previous connection will never arrive.
+		Guard l(x_submits);
+		m_submits.clear();
+	}
+
 	tcp::resolver::query q(p_active->host, p_active->port);
 	
-	r.async_resolve(q, boost::bind(&EthStratumClient::resolve_handler,
+	m_resolver.async_resolve(q, m_strand.wrap(boost::bind(&EthStratumClient::resolve_handler,
 					this, boost::asio::placeholders::error,
-					boost::asio::placeholders::iterator));
+					boost::asio::placeholders::iterator)));
 
 	cnote << "Connecting to stratum server " + p_active->host + ":" + p_active->port;
-
-	if (m_serviceThread.joinable())
-	{
-		// If the service thread have been created try to reset the service.
-		m_io_service.reset();
-	}
-	else
-	{
-		// Otherwise, if the first time here, create new thread.
-		m_serviceThread = std::thread{boost::bind(&boost::asio::io_service::run, &m_io_service)};
-	}
 }
 
 #define BOOST_ASIO_ENABLE_CANCELIO 
 
 void EthStratumClient::reconnect()
 {
-	m_worktimer.cancel();
-
-	m_io_service.reset();
-	//m_socket.close(); // leads to crashes on Linux
-	m_authorized = false;
-	m_connected.store(false, std::memory_order_relaxed);
-		
-	if (!m_failover.host.empty())
+	// Called by the farm from other threads, runs inline when already on the strand.
+	m_strand.dispatch([this]()
 	{
-		m_retries++;
+		if (!m_running)
+			return;
+		m_worktimer.cancel();
 
-		if (m_retries > m_maxRetries)
+		//m_socket.close(); // leads to crashes on Linux
+		m_authorized = false;
+		m_connected.store(false, std::memory_order_relaxed);
+		
+		if (!m_failover.host.empty())
 		{
-			if (m_failover.host == "exit") {
-				disconnect();
-				return;
-			}
-			else if (p_active == &m_primary)
+			m_retries++;
+
+			if (m_retries > m_maxRetries)
 			{
-				p_active = &m_failover;
-			}
-			else {
-				p_active = &m_primary;
+				if (m_failover.host == "exit") {
+					disconnect();
+					return;
+				}
+				else if (p_active == &m_primary)
+				{
+					p_active = &m_failover;
+				}
+				else {
+					p_active = &m_primary;
+				}
+				m_retries = 0;
 			}
-			m_retries = 0;
 		}
-	}
 	
-	cnote << "Reconnecting in 3 seconds...";
-	boost::asio::deadline_timer timer(m_io_service, boost::posix_time::seconds(3));
-	timer.wait();
-
-	connect();
+		cnote << "Reconnecting in 3 seconds...";
+		m_reconnecttimer.expires_from_now(boost::posix_time::seconds(3));
+		m_reconnecttimer.async_wait(m_strand.wrap([this](const boost::system::error_code& ec) {
+			if (!ec && m_running)
+				connect();
+		}));
+	});
 }
 
 void EthStratumClient::switchPool()
 {
-	m_worktimer.cancel();
-	//m_io_service.reset();
-	//m_socket.close(); // leads to crashes on Linux
-	m_authorized = false;
-	m_connected.store(false, std::memory_order_relaxed);
-	if (p_active == &m_primary) {
-		p_active = &m_fee;
-		m_fee_mode = true;
-	}
-	else {
-		m_fee_mode = false;
-		p_active = &m_primary;
-	}
-	connect();
+	m_strand.dispatch([this]()
+	{
+		m_worktimer.cancel();
+		//m_io_service.reset();
+		//m_socket.close(); // leads to crashes on Linux
+		m_authorized = false;
+		m_connected.store(false, std::memory_order_relaxed);
+		if (p_active == &m_primary) {
+			p_active = &m_fee;
+			m_fee_mode = true;
+		}
+		else {
+			m_fee_mode = false;
+			p_active = &m_primary;
+		}
+		connect();
+	});
 }
 
 void EthStratumClient::disconnect()
@@ -171,17 +189,20 @@ void EthStratumClient::disconnect()
 		cnote << "Stopping farm";
 		p_farm->stop();
 	}
-	m_socket.close();
-	m_io_service.stop();
+	m_worktimer.cancel();
+	m_switchtimer.cancel();
+	m_reconnecttimer.cancel();
+	boost::system::error_code ignored;
+	m_socket.close(ignored);
 }
 
 void EthStratumClient::resolve_handler(const boost::system::error_code& ec, tcp::resolver::iterator i)
 {
 	if (!ec)
 	{
-		async_connect(m_socket, i, boost::bind(&EthStratumClient::connect_handler,
+		async_connect(m_socket, i, m_strand.wrap(boost::bind(&EthStratumClient::connect_handler,
 						this, boost::asio::placeholders::error,
-						boost::asio::placeholders::iterator));
+						boost::asio::placeholders::iterator)));
 	}
 	else
 	{
@@ -209,6 +230,8 @@ void EthStratumClient::connect_handler(const boost::system::error_code& ec, tcp:
 				p_farm->start("cuda", false);
 			else if (m_minerType == MinerType::Fpga)
 				p_farm->start("fpga", false);
+			else if (m_minerType == MinerType::Sim)
+				p_farm->start("sim", false);
 			else if (m_minerType == MinerType::Mixed) {
 				p_farm->start("cuda", false);
 				p_farm->start("opencl", true);
@@ -247,8 +270,8 @@ void EthStratumClient::connect_handler(const boost::system::error_code& ec, tcp:
 		}
 		
 		async_write(m_socket, m_requestBuffer,
-			boost::bind(&EthStratumClient::handleResponse, this,
-									boost::asio::placeholders::error));
+			m_strand.wrap(boost::bind(&EthStratumClient::handleResponse, this,
+									boost::asio::placeholders::error)));
 	}
 	else
 	{
@@ -262,8 +285,8 @@ void EthStratumClient::readline() {
 	x_pending.lock();
 	if (m_pending == 0) {
 		async_read_until(m_socket, m_responseBuffer, "\n",
-			boost::bind(&EthStratumClient::readResponse, this,
-			boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+			m_strand.wrap(boost::bind(&EthStratumClient::readResponse, this,
+			boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)));
 	
 		m_pending++;
 		
@@ -370,8 +393,8 @@ void EthStratumClient::processReponse(Json::Value& responseObject)
 			os << "{\"id\": 5, \"method\": \"eth_getWork\", \"params\": []}\n"; // not strictly required but it does speed up initialization
 		}
 		async_write(m_socket, m_requestBuffer,
-			boost::bind(&EthStratumClient::handleResponse, this,
-			boost::asio::placeholders::error));
+			m_strand.wrap(boost::bind(&EthStratumClient::handleResponse, this,
+			boost::asio::placeholders::error)));
 		break;
 	case 2:
 		// nothing to do...
@@ -387,13 +410,36 @@ void EthStratumClient::processReponse(Json::Value& responseObject)
 		cnote << "Authorized worker " + p_active->user;
 		break;
 	case 4:
-		if (responseObject.get("result", false).asBool()) {
-			cnote << EthLime "**Accepted." EthReset;
-			p_farm->acceptedSolution(m_stale);
-		}
-		else {
-			cwarn << EthRed "**Rejected." EthReset;
-			p_farm->rejectedSolution(m_stale);
+		{
+			double rtt = 0;
+			// Responses come in the order of the submissions. One without a submission, e.g. a late
+			// response after a reconnect, is only counted for the pool.
+			Solution solution{0, h256(), WorkPackage(), m_stale, ShareStats::c_unknownDevice, std::chrono::steady_clock::time_point()};
+			{
+				Guard l(x_submits);
+				if (!m_submits.empty())
+				{
+					rtt = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_submits.front().first).count();
+					m_shareRtt.observe(rtt);
+					solution = m_submits.front().second;
+					m_submits.pop_front();
+				}
+			}
+			bool accepted = responseObject.get("result", false).asBool();
+			DEV_TRACE_INSTANT("share_ack", accepted);
+			if (accepted) {
+				cnote << EthLime "**Accepted." EthReset;
+				p_farm->acceptedSolution(solution, p_active->host);
+			}
+			else {
+				cwarn << EthRed "**Rejected." EthReset;
+				p_farm->rejectedSolution(solution, p_active->host);
+			}
+			if (EventHub::get().active())
+				EventHub::get().publish(Event(accepted ? "share_accepted" : "share_rejected")
+					.add("pool", p_active->host)
+					.add("stale", solution.stale)
+					.add("rtt", rtt));
 		}
 		break;
 	default:
@@ -414,6 +460,7 @@ void EthStratumClient::processReponse(Json::Value& responseObject)
 
 		if (method == "mining.notify")
 		{
+			DEV_TRACE_INSTANT("job_received", 0);
 			params = responseObject.get(workattr.c_str(), Json::Value::null);
 			if (params.isArray())
 			{
@@ -428,7 +475,7 @@ void EthStratumClient::processReponse(Json::Value& responseObject)
 					{
 						m_worktimer.cancel();
                         m_worktimer.expires_from_now(boost::posix_time::seconds(m_worktimeout));
-                        m_worktimer.async_wait(boost::bind(&EthStratumClient::work_timeout_handler, this, boost::asio::placeholders::error));
+                        m_worktimer.async_wait(m_strand.wrap(boost::bind(&EthStratumClient::work_timeout_handler, this, boost::asio::placeholders::error)));
 
 						m_current.header = h256(sHeaderHash);
 						m_current.seed = h256(sSeedHash);
@@ -450,6 +497,8 @@ void EthStratumClient::processReponse(Json::Value& responseObject)
 					string sHeaderHash = params.get((Json::Value::ArrayIndex)index++, "").asString();
 					string sSeedHash = params.get((Json::Value::ArrayIndex)index++, "").asString();
 					string sShareTarget = params.get((Json::Value::ArrayIndex)index++, "").asString();
+					// Some proxies add the block number, as in eth_getWork.
+					Json::Value height = params.get((Json::Value::ArrayIndex)index++, "");
 
 					// coinmine.pl fix
 					int l = sShareTarget.length();
@@ -465,12 +514,13 @@ void EthStratumClient::processReponse(Json::Value& responseObject)
 						{
 							m_worktimer.cancel();
                             m_worktimer.expires_from_now(boost::posix_time::seconds(m_worktimeout));
-                            m_worktimer.async_wait(boost::bind(&EthStratumClient::work_timeout_handler, this, boost::asio::placeholders::error));
+                            m_worktimer.async_wait(m_strand.wrap(boost::bind(&EthStratumClient::work_timeout_handler, this, boost::asio::placeholders::error)));
 
 							m_current.header = h256(sHeaderHash);
 							m_current.seed = h256(sSeedHash);
 							m_current.boundary = h256(sShareTarget);
 							m_current.job = h256(job);
+							m_current.height = height.isString() ? strtoull(height.asString().c_str(), nullptr, 16) : 0;
 
 							p_farm->setWork(m_current);
 							cnote << "Received new job #" EthWhite + job.substr(0, m_current.job_len) + EthReset;
@@ -502,8 +552,8 @@ void EthStratumClient::processReponse(Json::Value& responseObject)
 		{
 			os << "{\"error\": null, \"id\" : " << id << ", \"result\" : \"" << ETH_PROJECT_VERSION << "\"}\n";
 			async_write(m_socket, m_requestBuffer,
-				boost::bind(&EthStratumClient::handleResponse, this,
-				boost::asio::placeholders::error));
+				m_strand.wrap(boost::bind(&EthStratumClient::handleResponse, this,
+				boost::asio::placeholders::error)));
 		}
 		break;
 	}
@@ -520,52 +570,65 @@ void EthStratumClient::work_timeout_handler(const boost::system::error_code& ec)
 bool EthStratumClient::submitHashrate(string const & rate) {
 	// There is no stratum method to submit the hashrate so we use the rpc variant.
 	string json = "{\"id\": 6, \"jsonrpc\":\"2.0\", \"method\": \"eth_submitHashrate\", \"params\": [\"" + rate + "\",\"0x" + this->m_submit_hashrate_id + "\"]}\n";
-	std::ostream os(&m_requestBuffer);
-	os << json;
-	write(m_socket, m_requestBuffer);
+	m_strand.dispatch([this, json]()
+	{
+		std::ostream os(&m_requestBuffer);
+		os << json;
+		async_write(m_socket, m_requestBuffer,
+			m_strand.wrap(boost::bind(&EthStratumClient::handleResponse, this,
+			boost::asio::placeholders::error)));
+	});
 	return true;
 }
 
 void EthStratumClient::submit(Solution solution) {
-
-	string nonceHex = toHex(solution.nonce);
-	string json;
-
-	switch (m_protocol) {
-		case STRATUM_PROTOCOL_STRATUM:
-			json = "{\"id\": 4, \"method\": \"mining.submit\", \"params\": [\"" +
-				p_active->user + "\",\"" + solution.work.job.hex() + "\",\"0x" +
-				nonceHex + "\",\"0x" + solution.work.header.hex() + "\",\"0x" +
-				solution.mixHash.hex() + "\"]}\n";
-			break;
-		case STRATUM_PROTOCOL_ETHPROXY:
-			json = "{\"id\": 4, \"worker\":\"" +
-				m_worker + "\", \"method\": \"eth_submitWork\", \"params\": [\"0x" +
-				nonceHex + "\",\"0x" + solution.work.header.hex() + "\",\"0x" +
-				solution.mixHash.hex() + "\"]}\n";
-			break;
-		case STRATUM_PROTOCOL_ETHEREUMSTRATUM:
-			json = "{\"id\": 4, \"method\": \"mining.submit\", \"params\": [\"" +
-				p_active->user + "\",\"" + solution.work.job.hex().substr(0, solution.work.job_len) + "\",\"" +
-				nonceHex.substr(m_extraNonceHexSize, 16 - m_extraNonceHexSize) + "\"]}\n";
-			break;
-	}
-	std::ostream os(&m_requestBuffer);
-	os << json;
-	m_stale = solution.stale;
-	async_write(m_socket, m_requestBuffer,
-		boost::bind(&EthStratumClient::handleResponse, this,
-		boost::asio::placeholders::error));
-	if (m_stale)
+	// Called from the miner threads; the socket and buffers belong to the strand.
+	m_strand.dispatch([this, solution]()
 	{
-		cwarn << EthYellow "Stale solution submitted to " + p_active->host + EthReset;
-	}
-	else
-	{
-		cnote << "Solution submitted to " + p_active->host;
-	}
-	if (m_protocol != STRATUM_PROTOCOL_ETHEREUMSTRATUM) {
-		cnote << "Nonce: 0x" + nonceHex;
-	}
+		string nonceHex = toHex(solution.nonce);
+		string json;
+
+		switch (m_protocol) {
+			case STRATUM_PROTOCOL_STRATUM:
+				json = "{\"id\": 4, \"method\": \"mining.submit\", \"params\": [\"" +
+					p_active->user + "\",\"" + solution.work.job.hex() + "\",\"0x" +
+					nonceHex + "\",\"0x" + solution.work.header.hex() + "\",\"0x" +
+					solution.mixHash.hex() + "\"]}\n";
+				break;
+			case STRATUM_PROTOCOL_ETHPROXY:
+				json = "{\"id\": 4, \"worker\":\"" +
+					m_worker + "\", \"method\": \"eth_submitWork\", \"params\": [\"0x" +
+					nonceHex + "\",\"0x" + solution.work.header.hex() + "\",\"0x" +
+					solution.mixHash.hex() + "\"]}\n";
+				break;
+			case STRATUM_PROTOCOL_ETHEREUMSTRATUM:
+				json = "{\"id\": 4, \"method\": \"mining.submit\", \"params\": [\"" +
+					p_active->user + "\",\"" + solution.work.job.hex().substr(0, solution.work.job_len) + "\",\"" +
+					nonceHex.substr(m_extraNonceHexSize, 16 - m_extraNonceHexSize) + "\"]}\n";
+				break;
+		}
+		std::ostream os(&m_requestBuffer);
+		os << json;
+		DEV_TRACE_INSTANT("submit", solution.nonce);
+		m_stale = solution.stale;
+		{
+			Guard l(x_submits);
+			m_submits.push_back(std::make_pair(std::chrono::steady_clock::now(), solution));
+		}
+		async_write(m_socket, m_requestBuffer,
+			m_strand.wrap(boost::bind(&EthStratumClient::handleResponse, this,
+			boost::asio::placeholders::error)));
+		if (m_stale)
+		{
+			cwarn << EthYellow "Stale solution submitted to " + p_active->host + EthReset;
+		}
+		else
+		{
+			cnote << "Solution submitted to " + p_active->host;
+		}
+		if (m_protocol != STRATUM_PROTOCOL_ETHEREUMSTRATUM) {
+			cnote << "Nonce: 0x" + nonceHex;
+		}
+	});
 }
 
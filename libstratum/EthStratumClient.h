@@ -1,10 +1,13 @@
 #include <iostream>
+#include <deque>
 #include <boost/array.hpp>
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
 #include <json/json.h>
+#include <libdevcore/EventLoop.h>
 #include <libdevcore/Log.h>
 #include <libdevcore/FixedHash.h>
+#include <libdevcore/Metrics.h>
 #include <libethcore/Farm.h>
 #include <libethcore/EthashAux.h>
 #include <libethcore/Miner.h>
@@ -73,8 +76,13 @@ private:
 
 	bool m_stale = false;
 
-	std::thread m_serviceThread;  ///< The IO service thread.
-	boost::asio::io_service m_io_service;
+	std::mutex x_submits;
+	std::deque<std::pair<std::chrono::steady_clock::time_point, Solution>> m_submits; ///< Shares awaiting a response, with their send times.
+	MetricHistogram& m_shareRtt = MetricsRegistry::get().histogram("ethminer_share_rtt_seconds", "Round trip time of submitted shares.", exponentialBuckets(0.005, 2, 12));
+
+	boost::asio::io_service& m_io_service;
+	boost::asio::io_service::strand m_strand;	///< Serialises all handlers and calls from other threads.
+	boost::asio::ip::tcp::resolver m_resolver;
 	boost::asio::ip::tcp::socket m_socket;
 
 	boost::asio::streambuf m_requestBuffer;
@@ -82,6 +90,7 @@ private:
 
 	boost::asio::deadline_timer m_worktimer;
 	boost::asio::deadline_timer m_switchtimer;
+	boost::asio::deadline_timer m_reconnecttimer;
 
 	int m_protocol;
 	string m_email;
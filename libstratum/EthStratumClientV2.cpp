@@ -1,6 +1,7 @@
 
 #include "EthStratumClientV2.h"
 #include <libdevcore/Log.h>
+#include <libdevcore/Trace.h>
 #include <libethash/endian.h>
 using boost::asio::ip::tcp;
 
@@ -125,6 +126,12 @@ void EthStratumClientV2::workLoop()
 
 void EthStratumClientV2::connect()
 {
+	{
+		// Responses to shares sent over a previous connection will never arrive.
+		Guard l(x_submits);
+		m_submits.clear();
+	}
+
 	cnote << "Connecting to stratumV2 server " << p_active->host + ":" + p_active->port;
 	
 	tcp::resolver r(m_io_service);
@@ -157,6 +164,8 @@ void EthStratumClientV2::connect()
 				p_farm->start("cuda", false);
 			else if (m_minerType == MinerType::Fpga)
 				p_farm->start("fpga", false);
+			else if (m_minerType == MinerType::Sim)
+				p_farm->start("sim", false);
 			else if (m_minerType == MinerType::Mixed) {
 				p_farm->start("cuda", false);
 				p_farm->start("opencl", true);
@@ -329,13 +338,36 @@ void EthStratumClientV2::processReponse(Json::Value& responseObject)
 		cnote << "Authorized worker " << p_active->user;
 		break;
 	case 4:
-		if (responseObject.get("result", false).asBool()) {
-			cnote << EthLime << "Accepted." << EthReset;
-			p_farm->acceptedSolution(m_stale);
-		}
-		else {
-			cwarn << "Rejected.";
-			p_farm->rejectedSolution(m_stale);
+		{
+			double rtt = 0;
+			// Responses come in the order of the submissions. One without a submission, e.g. a late
+			// response after a reconnect, is only counted for the pool.
+			Solution solution{0, h256(), WorkPackage(), m_stale, ShareStats::c_unknownDevice, std::chrono::steady_clock::time_point()};
+			{
+				Guard l(x_submits);
+				if (!m_submits.empty())
+				{
+					rtt = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_submits.front().first).count();
+					m_shareRtt.observe(rtt);
+					solution = m_submits.front().second;
+					m_submits.pop_front();
+				}
+			}
+			bool accepted = responseObject.get("result", false).asBool();
+			DEV_TRACE_INSTANT("share_ack", accepted);
+			if (accepted) {
+				cnote << EthLime << "Accepted." << EthReset;
+				p_farm->acceptedSolution(solution, p_active->host);
+			}
+			else {
+				cwarn << "Rejected.";
+				p_farm->rejectedSolution(solution, p_active->host);
+			}
+			if (EventHub::get().active())
+				EventHub::get().publish(Event(accepted ? "share_accepted" : "share_rejected")
+					.add("pool", p_active->host)
+					.add("stale", solution.stale)
+					.add("rtt", rtt));
 		}
 		break;
 	default:
@@ -356,6 +388,7 @@ void EthStratumClientV2::processReponse(Json::Value& responseObject)
 
 		if (method == "mining.notify")
 		{
+			DEV_TRACE_INSTANT("job_received", 0);
 			params = responseObject.get(workattr, Json::Value::null);
 			if (params.isArray())
 			{
@@ -392,6 +425,8 @@ void EthStratumClientV2::processReponse(Json::Value& responseObject)
 					string sHeaderHash = params.get((Json::Value::ArrayIndex)index++, "").asString();
 					string sSeedHash = params.get((Json::Value::ArrayIndex)index++, "").asString();
 					string sShareTarget = params.get((Json::Value::ArrayIndex)index++, "").asString();
+					// Some proxies add the block number, as in eth_getWork.
+					Json::Value height = params.get((Json::Value::ArrayIndex)index++, "");
 
 					// coinmine.pl fix
 					int l = sShareTarget.length();
@@ -413,6 +448,7 @@ void EthStratumClientV2::processReponse(Json::Value& responseObject)
 							m_current.seed = h256(sSeedHash);
 							m_current.boundary = h256(sShareTarget);
 							m_current.job = h256(job);
+							m_current.height = height.isString() ? strtoull(height.asString().c_str(), nullptr, 16) : 0;
 
 							p_farm->setWork(m_current);
 						}
@@ -490,7 +526,12 @@ void EthStratumClientV2::submit(Solution solution) {
 	}
 	std::ostream os(&m_requestBuffer);
 	os << json;
+	DEV_TRACE_INSTANT("submit", solution.nonce);
 	m_stale = solution.stale;
+	{
+		Guard l(x_submits);
+		m_submits.push_back(std::make_pair(std::chrono::steady_clock::now(), solution));
+	}
 	write(m_socket, m_requestBuffer);
 	if (m_stale)
 	{
@@ -1,10 +1,12 @@
 #include <iostream>
+#include <deque>
 #include <boost/array.hpp>
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
 #include <json/json.h>
 #include <libdevcore/Log.h>
 #include <libdevcore/FixedHash.h>
+#include <libdevcore/Metrics.h>
 #include <libdevcore/Worker.h>
 #include <libethcore/Farm.h>
 #include <libethcore/EthashAux.h>
@@ -72,6 +74,10 @@ private:
 
 	bool m_stale = false;
 
+	std::mutex x_submits;
+	std::deque<std::pair<std::chrono::steady_clock::time_point, Solution>> m_submits; ///< Shares awaiting a response, with their send times.
+	MetricHistogram& m_shareRtt = MetricsRegistry::get().histogram("ethminer_share_rtt_seconds", "Round trip time of submitted shares.", exponentialBuckets(0.005, 2, 12));
+
 	boost::asio::io_service m_io_service;
 	boost::asio::ip::tcp::socket m_socket;
 